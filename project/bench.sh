@@ -0,0 +1,138 @@
+# Benchmark the interpreter on generated workloads.
+# Usage : ./bench.sh [path to e-lang] [workload size] [nesting depth] [loop size]
+
+BIN=${1:-./../linux/bin/e-lang}
+SIZE=${2:-200000}
+DEPTH=${3:-1000000}
+LOOP=${4:-10000}
+WORKDIR=${TMPDIR:-/tmp}/e-lang-bench
+
+mkdir -p $WORKDIR
+
+# Numeric : a long straight-line program of arithmetic assignments on a few variables.
+awk -v n=$SIZE 'BEGIN {
+    print "(program";
+    for(i = 0 ; i < 16 ; i++) printf "(assign x%d %d.5)\n", i, i;
+    for(i = 16 ; i < n ; i++) printf "(assign x%d (+ (* x%d 0.5) (sin x%d) (/ x%d 3) 1))\n", i % 16, (i - 1) % 16, (i - 2) % 16, (i - 3) % 16;
+    print ")";
+}' > $WORKDIR/numeric.e
+
+# Variables : the same arithmetic spread over thousands of variables.
+awk -v n=$SIZE 'BEGIN {
+    print "(program";
+    for(i = 0 ; i < 4096 ; i++) printf "(assign variable_%d %d.5)\n", i, i;
+    for(i = 4096 ; i < n ; i++) printf "(assign variable_%d (+ (* variable_%d 0.5) (sin variable_%d) (/ variable_%d 3) 1))\n", i % 4096, (i * 7) % 4096, (i * 13) % 4096, (i * 31) % 4096;
+    print ")";
+}' > $WORKDIR/variables.e
+
+# Constants : the same arithmetic written with constant subtrees, powers and divisions by powers of two.
+awk -v n=$SIZE 'BEGIN {
+    print "(program";
+    for(i = 0 ; i < 16 ; i++) printf "(assign x%d %d.5)\n", i, i;
+    for(i = 16 ; i < n ; i++) printf "(assign x%d (sin (+ (* x%d (to_rad 45)) (* 2 3.14159) (^ x%d 2) (/ x%d 4) (to_numeric \"1.5\"))))\n", i % 16, (i - 1) % 16, (i - 2) % 16, (i - 3) % 16;
+    print ")";
+}' > $WORKDIR/constants.e
+
+# Redundant : the same products computed again within and across statements, and a scratch variable overwritten unread.
+awk -v n=$SIZE 'BEGIN {
+    print "(program";
+    for(i = 0 ; i < 16 ; i++) printf "(assign x%d %d.5)\n", i, i;
+    for(i = 16 ; i < n ; i += 2)
+    {
+        a = (i - 1) % 16; b = (i - 2) % 16;
+        printf "(assign scratch (* x%d x%d))\n", a, b;
+        printf "(assign x%d (+ (* x%d x%d) (sin (* x%d x%d)) (/ (* x%d x%d) 3) (sin (* x%d x%d))))\n", i % 16, a, b, a, b, a, b, a, b;
+    }
+    print ")";
+}' > $WORKDIR/redundant.e
+
+# Nested : a single sum nested DEPTH levels deep, (+ 1 (+ 1 ... 0)).
+awk -v n=$DEPTH 'BEGIN {
+    printf "(program\n(assign nested ";
+    for(i = 0 ; i < n ; i++) printf "(+ 1 ";
+    printf "0";
+    for(i = 0 ; i < n ; i++) printf ")";
+    print ")\n(print nested)\n)";
+}' > $WORKDIR/nested.e
+
+# Calls : a million calls of a small function, fanned out by six levels of functions calling ten times the level below.
+awk 'BEGIN {
+    print "(program\n(function f0 x (+ x 1))";
+    for(i = 1 ; i <= 6 ; i++)
+    {
+        printf "(function f%d x (+", i;
+        for(j = 0 ; j < 10 ; j++) printf " (f%d x)", i - 1;
+        print "))";
+    }
+    print "(print (f6 1))\n)";
+}' > $WORKDIR/calls.e
+
+# Loop : LOOP * LOOP iterations of tail-recursive countdowns, in constant memory.
+awk -v n=$LOOP 'BEGIN {
+    print "(program\n(function inner n (if n (inner (- n 1)) 0))";
+    printf "(function outer m (if m (outer (+ (- m 1) (inner %d))) 0))\n", n;
+    printf "(print (outer %d))\n)\n", n;
+}' > $WORKDIR/loop.e
+
+# Fib : the exponential recursion of a pure function, linear once memoized.
+cat > $WORKDIR/fib.e <<EOF
+(program
+(function fib n (if (- n 1) (if (- n 2) (+ (fib (- n 1)) (fib (- n 2))) 1) 1))
+(print (fib 27))
+)
+EOF
+
+# Run.
+for workload in numeric variables calls loop
+do
+    for engine in tree flat vm
+    do
+        echo "== $workload ($engine)"
+        $BIN file=$WORKDIR/$workload.e engine=$engine bench=true
+    done
+done
+
+for engine in tree flat vm
+do
+    for memo in false true
+    do
+        echo "== fib ($engine, memo=$memo)"
+        $BIN file=$WORKDIR/fib.e engine=$engine memo=$memo bench=true
+    done
+done
+
+# Before and after folding the constant subtrees.
+for engine in tree flat vm
+do
+    for optimize in false true
+    do
+        echo "== constants ($engine, optimize=$optimize)"
+        $BIN file=$WORKDIR/constants.e engine=$engine optimize=$optimize bench=true
+    done
+done
+
+# Before and after removing the redundant evaluations and assignments.
+for engine in tree flat vm
+do
+    for ssa in false true
+    do
+        echo "== redundant ($engine, ssa=$ssa)"
+        $BIN file=$WORKDIR/redundant.e engine=$engine ssa=$ssa bench=true
+    done
+done
+
+# A cold run compiling the program in the cache, then a warm one running it from there.
+rm -rf $WORKDIR/cache
+for run in cold warm
+do
+    echo "== numeric (vm, cache, $run)"
+    $BIN file=$WORKDIR/numeric.e engine=vm cache=$WORKDIR/cache bench=true
+done
+
+# Statements evaluated as soon as they are parsed on another thread.
+echo "== numeric (vm, stream)"
+$BIN file=$WORKDIR/numeric.e engine=vm stream=true bench=true
+
+# The parser and the compiler have no recursion, but the tree and flat AST evaluators do.
+echo "== nested (vm)"
+$BIN file=$WORKDIR/nested.e engine=vm bench=true
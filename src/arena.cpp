@@ -0,0 +1,106 @@
+#include "arena.hpp"
+
+#include <cstdlib>
+
+Arena::Arena(std::size_t blockSize)
+    : m_blockSize(blockSize)
+    , m_block(nullptr)
+    , m_cursor(nullptr)
+    , m_end(nullptr)
+    , m_deferred(nullptr)
+{}
+
+Arena::~Arena()
+{
+    releaseDeferred();
+
+    while(m_block)
+    {
+        Block* previous = m_block->previous;
+        std::free(m_block);
+        m_block = previous;
+    }
+}
+
+void Arena::clear()
+{
+    releaseDeferred();
+
+    if(!m_block)
+        return;
+
+    // The last block is the biggest one, keep it for the next allocations.
+    Block* previous = m_block->previous;
+
+    while(previous)
+    {
+        Block* next = previous->previous;
+        std::free(previous);
+        previous = next;
+    }
+
+    m_block->previous = nullptr;
+    m_cursor = reinterpret_cast<char*>(m_block + 1);
+    m_end = m_cursor + m_block->size;
+}
+
+std::size_t Arena::getBlockCount() const
+{
+    std::size_t count(0);
+
+    for(Block* block = m_block ; block ; block = block->previous)
+        ++count;
+
+    return count;
+}
+
+std::size_t Arena::getReservedBytes() const
+{
+    std::size_t bytes(0);
+
+    for(Block* block = m_block ; block ; block = block->previous)
+        bytes += block->size;
+
+    return bytes;
+}
+
+std::size_t Arena::getAllocatedBytes() const
+{
+    return getReservedBytes() - static_cast<std::size_t>(m_end - m_cursor);
+}
+
+void Arena::releaseDeferred()
+{
+    // The records are in the blocks, walk them before the blocks are freed.
+    while(m_deferred)
+    {
+        Deferred* deferred = m_deferred;
+        m_deferred = deferred->previous;
+        deferred->release(deferred->object);
+    }
+}
+
+void* Arena::allocateSlow(std::size_t size, std::size_t alignment)
+{
+    // Blocks grow geometrically so that a parse needs only a handful of them,
+    // up to 16 MB so that the last block does not waste too much memory.
+    const std::size_t maxBlockSize = 16 * 1024 * 1024;
+    std::size_t blockSize = m_block ? std::min(m_block->size * 2, maxBlockSize) : m_blockSize;
+
+    if(blockSize < size + alignment)
+        blockSize = size + alignment;
+
+    Block* block = static_cast<Block*>(std::malloc(sizeof(Block) + blockSize));
+
+    if(!block)
+        throw std::bad_alloc();
+
+    block->previous = m_block;
+    block->size = blockSize;
+
+    m_block = block;
+    m_cursor = reinterpret_cast<char*>(block + 1);
+    m_end = m_cursor + blockSize;
+
+    return allocate(size, alignment);
+}
@@ -0,0 +1,126 @@
+/*
+	arena.hpp
+
+	The MIT License (MIT)
+
+	Copyright (c) 2014 Maxime Alvarez
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+	Defines a bump allocator releasing everything it allocated at once.
+*/
+
+#ifndef ARENA_HPP_INCLUDED
+#define ARENA_HPP_INCLUDED
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+class Arena
+{
+    public:
+        Arena(std::size_t blockSize = 64 * 1024);
+        ~Arena();
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        // Return size bytes aligned on alignment, valid until the next call to clear().
+        void* allocate(std::size_t size, std::size_t alignment)
+        {
+            std::uintptr_t cursor = (reinterpret_cast<std::uintptr_t>(m_cursor) + alignment - 1) & ~(alignment - 1);
+
+            if(cursor + size > reinterpret_cast<std::uintptr_t>(m_end))
+                return allocateSlow(size, alignment);
+
+            m_cursor = reinterpret_cast<char*>(cursor + size);
+            return reinterpret_cast<void*>(cursor);
+        }
+
+        // Construct an object in the arena. Destructors are never run.
+        template<typename T, typename... Args>
+        T* create(Args&&... args)
+        {
+            static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+            return new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        }
+
+        // Copy count elements in the arena.
+        template<typename T>
+        T* copy(const T* elements, std::size_t count)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "arena arrays are copied bytewise");
+
+            if(count == 0)
+                return nullptr;
+
+            T* array = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+            std::copy(elements, elements + count, array);
+
+            return array;
+        }
+
+        // Call release(object) at the next clear() or at the destruction of the arena,
+        // for an arena object holding a resource the arena does not own.
+        void defer(void (*release)(void*), void* object)
+        {
+            m_deferred = create<Deferred>(Deferred{release, object, m_deferred});
+        }
+
+        // Release everything at once. The last block is kept to be reused.
+        void clear();
+
+        std::size_t getBlockCount() const;
+        std::size_t getReservedBytes() const;
+        // Reserved bytes but those left at the end of the current block.
+        std::size_t getAllocatedBytes() const;
+
+    protected:
+        void* allocateSlow(std::size_t size, std::size_t alignment);
+        // Call the deferred releases, the last one first.
+        void releaseDeferred();
+
+    protected:
+        struct Block
+        {
+            Block* previous;
+            std::size_t size;
+        };
+
+        struct Deferred
+        {
+            void (*release)(void*);
+            void* object;
+            Deferred* previous;
+        };
+
+        std::size_t m_blockSize;
+
+        Block* m_block;
+        char* m_cursor;
+        char* m_end;
+
+        Deferred* m_deferred;
+};
+
+#endif // ARENA_HPP_INCLUDED
@@ -0,0 +1,137 @@
+/*
+	bytecode.hpp
+
+	The MIT License (MIT)
+
+	Copyright (c) 2014 Maxime Alvarez
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+	Defines the bytecode executed by the runtime's virtual machine.
+*/
+
+#ifndef BYTECODE_HPP_INCLUDED
+#define BYTECODE_HPP_INCLUDED
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "datatypes.hpp"
+
+/// Keep the order in sync with the dispatch table in vm.cpp.
+enum class OpCode : std::uint8_t
+{
+    /** Stack operations. */
+    OC_PUSH_NULL,
+    OC_PUSH_NUMERIC,
+    OC_PUSH_CONSTANT,
+    // Decodes the escape sequences of its constant and becomes a OC_PUSH_CONSTANT.
+    OC_PUSH_ESCAPED,
+    OC_POP,
+
+    /** Variables. */
+    OC_LOAD,
+    OC_STORE,
+    // Locals of the function being executed, in the slots of its frame.
+    OC_LOAD_LOCAL,
+    OC_STORE_LOCAL,
+
+    /** Specials built-in operations. */
+    OC_TO_NUMERIC,
+    OC_TO_STRING,
+    OC_PRINT,
+    OC_INPUT,
+
+    /** Maths built-in operations. */
+    OC_CHECK,
+    OC_ADD,
+    OC_SUB,
+    OC_MUL,
+    OC_DIV,
+    OC_MOD,
+    OC_POW,
+    OC_SIN,
+    OC_COS,
+    OC_TAN,
+    OC_ASIN,
+    OC_ACOS,
+    OC_ATAN,
+    OC_TO_RAD,
+    OC_TO_DEG,
+    OC_LN,
+    OC_EXP,
+    OC_LOG10,
+    OC_SQUARE,
+
+    /** Functions. */
+    // Bind the name of a function of the bytecode to it.
+    OC_DEFINE,
+    // The symbol of the function in the low 24 bits of the operand, the number of arguments in the high 8 bits.
+    OC_CALL,
+    // A call in tail position : the callee replaces the frame of the caller, the stack does not grow.
+    OC_TAIL_CALL,
+
+    /** Control. */
+    // Forward jumps, the operand is the distance from the jump instruction.
+    OC_JUMP,
+    // Pops the condition and jumps if it is false.
+    OC_JUMP_IF_FALSE,
+    OC_FAIL,
+    // From a function to its caller, or from the program.
+    OC_RETURN
+};
+
+/// One instruction : an opcode and a 32 bits operand whose meaning depends on the opcode
+/// (float bits, constant index, variable or local slot, operator, function or message index, jump distance).
+struct Instruction
+{
+    Instruction(OpCode code = OpCode::OC_RETURN, std::uint32_t argument = 0)
+        : opcode(code), operand(argument)
+    {}
+
+    OpCode opcode;
+    std::uint32_t operand;
+};
+
+struct Function;
+
+/// A compiled program, or the body of a function.
+struct Bytecode
+{
+    Bytecode()
+        : mappedCode(nullptr)
+        , maxStackSize(0)
+    {}
+
+    std::vector<Instruction> code;
+
+    // Instructions of a program loaded from the cache (see program_cache.hpp), executed in place of code.
+    Instruction* mappedCode;
+
+    std::vector<Value> constants;
+    std::vector<std::string> messages;
+
+    // Functions defined by the program, see function.hpp.
+    std::vector<std::shared_ptr<Function>> functions;
+
+    std::size_t maxStackSize;
+};
+
+#endif // BYTECODE_HPP_INCLUDED
@@ -0,0 +1,552 @@
+#include "compiler.hpp"
+
+#include <cstring>
+
+#include "errors.hpp"
+
+namespace
+{
+    // Stack effect of each instruction. Every compiled expression pushes exactly one value,
+    // so OC_FAIL counts as a push even if it never returns.
+    int stack_effect(OpCode opcode, std::uint32_t operand)
+    {
+        switch(opcode)
+        {
+            case OpCode::OC_PUSH_NULL:
+            case OpCode::OC_PUSH_NUMERIC:
+            case OpCode::OC_PUSH_CONSTANT:
+            case OpCode::OC_PUSH_ESCAPED:
+            case OpCode::OC_LOAD:
+            case OpCode::OC_LOAD_LOCAL:
+            case OpCode::OC_INPUT:
+            case OpCode::OC_DEFINE:
+            case OpCode::OC_FAIL:
+                return 1;
+            case OpCode::OC_POP:
+            case OpCode::OC_STORE:
+            case OpCode::OC_STORE_LOCAL:
+            case OpCode::OC_PRINT:
+            case OpCode::OC_JUMP_IF_FALSE:
+            case OpCode::OC_ADD:
+            case OpCode::OC_SUB:
+            case OpCode::OC_MUL:
+            case OpCode::OC_DIV:
+            case OpCode::OC_MOD:
+            case OpCode::OC_POW:
+            case OpCode::OC_RETURN:
+                return -1;
+            case OpCode::OC_CALL:
+            case OpCode::OC_TAIL_CALL:
+                // The arguments are replaced by the result.
+                return 1 - static_cast<int>(operand >> 24);
+            case OpCode::OC_TO_NUMERIC:
+            case OpCode::OC_TO_STRING:
+            case OpCode::OC_CHECK:
+            case OpCode::OC_SIN:
+            case OpCode::OC_COS:
+            case OpCode::OC_TAN:
+            case OpCode::OC_ASIN:
+            case OpCode::OC_ACOS:
+            case OpCode::OC_ATAN:
+            case OpCode::OC_TO_RAD:
+            case OpCode::OC_TO_DEG:
+            case OpCode::OC_LN:
+            case OpCode::OC_EXP:
+            case OpCode::OC_LOG10:
+            case OpCode::OC_SQUARE:
+            case OpCode::OC_JUMP:
+            default:
+                return 0;
+        }
+    }
+
+    // Opcode of a maths operator taking one or more arguments.
+    OpCode binary_opcode(Operator op)
+    {
+        switch(op)
+        {
+            case Operator::OP_ADD: return OpCode::OC_ADD;
+            case Operator::OP_SUB: return OpCode::OC_SUB;
+            case Operator::OP_MUL: return OpCode::OC_MUL;
+            case Operator::OP_DIV: return OpCode::OC_DIV;
+            case Operator::OP_MOD: return OpCode::OC_MOD;
+            case Operator::OP_POW: return OpCode::OC_POW;
+            case Operator::OP_PROGRAM:
+            case Operator::OP_ASSIGN:
+            case Operator::OP_TO_NUMERIC:
+            case Operator::OP_TO_STRING:
+            case Operator::OP_PRINT:
+            case Operator::OP_INPUT:
+            case Operator::OP_IF:
+            case Operator::OP_FUNCTION:
+            case Operator::OP_CALL:
+            case Operator::OP_SIN:
+            case Operator::OP_COS:
+            case Operator::OP_TAN:
+            case Operator::OP_ASIN:
+            case Operator::OP_ACOS:
+            case Operator::OP_ATAN:
+            case Operator::OP_TO_RAD:
+            case Operator::OP_TO_DEG:
+            case Operator::OP_LN:
+            case Operator::OP_EXP:
+            case Operator::OP_LOG10:
+            case Operator::OP_SQUARE:
+            case Operator::OP_NONE:
+            default:
+                break;
+        }
+
+        errors::runtimeError("internal: " + string_utils::from(op) + " is not a binary maths operator");
+        return OpCode::OC_FAIL;
+    }
+
+    // Opcode of a maths operator taking exactly one argument.
+    OpCode unary_opcode(Operator op)
+    {
+        switch(op)
+        {
+            case Operator::OP_SIN: return OpCode::OC_SIN;
+            case Operator::OP_COS: return OpCode::OC_COS;
+            case Operator::OP_TAN: return OpCode::OC_TAN;
+            case Operator::OP_ASIN: return OpCode::OC_ASIN;
+            case Operator::OP_ACOS: return OpCode::OC_ACOS;
+            case Operator::OP_ATAN: return OpCode::OC_ATAN;
+            case Operator::OP_TO_RAD: return OpCode::OC_TO_RAD;
+            case Operator::OP_TO_DEG: return OpCode::OC_TO_DEG;
+            case Operator::OP_LN: return OpCode::OC_LN;
+            case Operator::OP_EXP: return OpCode::OC_EXP;
+            case Operator::OP_LOG10: return OpCode::OC_LOG10;
+            case Operator::OP_SQUARE: return OpCode::OC_SQUARE;
+            case Operator::OP_PROGRAM:
+            case Operator::OP_ASSIGN:
+            case Operator::OP_TO_NUMERIC:
+            case Operator::OP_TO_STRING:
+            case Operator::OP_PRINT:
+            case Operator::OP_INPUT:
+            case Operator::OP_IF:
+            case Operator::OP_FUNCTION:
+            case Operator::OP_CALL:
+            case Operator::OP_ADD:
+            case Operator::OP_SUB:
+            case Operator::OP_MUL:
+            case Operator::OP_DIV:
+            case Operator::OP_MOD:
+            case Operator::OP_POW:
+            case Operator::OP_NONE:
+            default:
+                break;
+        }
+
+        errors::runtimeError("internal: " + string_utils::from(op) + " is not a unary maths operator");
+        return OpCode::OC_FAIL;
+    }
+}
+
+Compiler::Compiler()
+    : m_stackSize(0)
+    , m_function(nullptr)
+    , m_tail(false)
+{}
+
+Bytecode Compiler::compile(Node* root, const Function* function)
+{
+    m_bytecode = Bytecode();
+    m_stackSize = 0;
+    m_function = function;
+    m_pending.clear();
+
+    // The value of a body is the result of its function : a call which computes it is a tail call.
+    m_tail = function != nullptr;
+
+    compileNode(root);
+    emit(OpCode::OC_RETURN);
+
+    return m_bytecode;
+}
+
+void Compiler::compileNode(Node* root)
+{
+    Node* node = root;
+
+    for(;;)
+    {
+        Node* operand = enterNode(node);
+
+        while(!operand && !m_pending.empty())
+            operand = leaveOperand();
+
+        if(!operand)
+            return;
+
+        node = operand;
+    }
+}
+
+Node* Compiler::enterNode(Node* node)
+{
+    bool tail = m_tail;
+    m_tail = false;
+
+    if(node->getOperator() == Operator::OP_NONE)
+    {
+        if(node->getType() == NodeType::NT_IDENTIFIER)
+        {
+            std::uint32_t local = m_function ? m_function->findLocal(node->getSlot()) : Function::noLocal;
+
+            if(local != Function::noLocal)
+                emit(OpCode::OC_LOAD_LOCAL, local);
+            else
+                emit(OpCode::OC_LOAD, node->getSlot());
+
+            return nullptr;
+        }
+        else if(node->getType() == NodeType::NT_CONST_VALUE)
+        {
+            if(node->hasEscapes())
+            {
+                // Pushed as written, decoded by its first execution.
+                emit(OpCode::OC_PUSH_ESCAPED, addConstant(Value(StringObject::create(node->getText(), node->getTextLength()))));
+                return nullptr;
+            }
+
+            Value value = node->getValue();
+
+            if(value.type == ValueType::VT_NUMERIC)
+            {
+                // The float is stored in the operand itself.
+                std::uint32_t bits(0);
+                std::memcpy(&bits, &value.numeric, sizeof(bits));
+
+                emit(OpCode::OC_PUSH_NUMERIC, bits);
+            }
+            else if(value.type == ValueType::VT_STRING)
+                emit(OpCode::OC_PUSH_CONSTANT, addConstant(value));
+            else
+                emit(OpCode::OC_PUSH_NULL);
+
+            return nullptr;
+        }
+    }
+
+    NodeList children = node->getChildren();
+
+    if(children.empty())
+    {
+        fail("expression with operator but no parameters");
+        return nullptr;
+    }
+
+    // All the children are operands, unless told otherwise.
+    Node* const* first = children.begin();
+    std::string error;
+
+    switch(node->getOperator())
+    {
+        /** Specials built-in operations. */
+        case Operator::OP_PROGRAM:
+            break;
+        case Operator::OP_ASSIGN:
+            if(children.size() != 2)
+                error = "assign operator takes exactly two operators";
+            else if(children.front()->getType() != NodeType::NT_IDENTIFIER)
+                error = "first parameter of assign operator must be an identifier";
+            else if(children.back()->getType() != NodeType::NT_CONST_VALUE && children.back()->getType() != NodeType::NT_EXPRESSION)
+                error = "second parameter of assign operator must be a constant value or an expression";
+            else
+                first = children.end() - 1;
+            break;
+        case Operator::OP_TO_NUMERIC:
+            if(children.size() != 1)
+                error = "to_numeric operator takes only one operators";
+            break;
+        case Operator::OP_TO_STRING:
+            if(children.size() != 1)
+                error = "to_string operator takes only one operator";
+            break;
+        case Operator::OP_PRINT:
+        case Operator::OP_INPUT:
+            break;
+        case Operator::OP_IF:
+            if(children.size() != 2 && children.size() != 3)
+                error = "if operator takes a condition, a value and an optional alternative";
+            break;
+        case Operator::OP_FUNCTION:
+            if(children.size() < 2)
+                error = "function definition takes a name, parameters and a body";
+            else if(children.size() - 2 > Function::maxArguments)
+                error = "function definition takes at most 255 parameters";
+            else
+            {
+                for(Node* const* child = children.begin() ; child != children.end() - 1 ; ++child)
+                {
+                    if((*child)->getType() != NodeType::NT_IDENTIFIER)
+                        error = "name and parameters of function definition must be identifiers";
+                }
+            }
+
+            if(error.empty())
+            {
+                define(children);
+                return nullptr;
+            }
+            break;
+        case Operator::OP_CALL:
+        {
+            Symbol name = children.front()->getSlot();
+            std::uint32_t local = m_function ? m_function->findLocal(name) : Function::noLocal;
+
+            if(children.size() - 1 > Function::maxArguments)
+                error = "function call takes at most 255 arguments";
+            else if(name >= (1u << 24))
+                error = "too many identifiers for a function call";
+            else if(children.size() == 1)
+            {
+                // (name) reads a local, or calls a function without arguments : the virtual machine
+                // reads the global variable if there is no such function.
+                if(local != Function::noLocal)
+                    emit(OpCode::OC_LOAD_LOCAL, local);
+                else
+                    emit(tail ? OpCode::OC_TAIL_CALL : OpCode::OC_CALL, name);
+
+                return nullptr;
+            }
+            else
+                first = children.begin() + 1;
+            break;
+        }
+
+        /** Maths built-in operations. */
+        case Operator::OP_ADD:
+        case Operator::OP_SUB:
+        case Operator::OP_MUL:
+        case Operator::OP_DIV:
+        case Operator::OP_MOD:
+        case Operator::OP_POW:
+            break;
+        case Operator::OP_SIN:
+        case Operator::OP_COS:
+        case Operator::OP_TAN:
+        case Operator::OP_ASIN:
+        case Operator::OP_ACOS:
+        case Operator::OP_ATAN:
+        case Operator::OP_TO_RAD:
+        case Operator::OP_TO_DEG:
+        case Operator::OP_LN:
+        case Operator::OP_EXP:
+        case Operator::OP_LOG10:
+        case Operator::OP_SQUARE:
+            if(children.size() != 1)
+                error = string_utils::from(node->getOperator()) + " operator only takes one argument";
+            break;
+        case Operator::OP_NONE:
+        default:
+            emit(OpCode::OC_PUSH_NUMERIC, 0);
+            return nullptr;
+    }
+
+    if(!error.empty())
+    {
+        fail(error);
+        return nullptr;
+    }
+
+    m_pending.push_back(Pending{node, first, children.end(), 0, tail});
+    return *first;
+}
+
+Node* Compiler::leaveOperand()
+{
+    Pending& pending = m_pending.back();
+    Node* node = pending.node;
+    Operator op = node->getOperator();
+
+    switch(op)
+    {
+        /** Specials built-in operations. */
+        case Operator::OP_PROGRAM:
+            emit(OpCode::OC_POP);
+            break;
+        case Operator::OP_ASSIGN:
+        {
+            Symbol symbol = node->getChildren().front()->getSlot();
+            std::uint32_t local = m_function ? m_function->findLocal(symbol) : Function::noLocal;
+
+            if(local != Function::noLocal)
+                emit(OpCode::OC_STORE_LOCAL, local);
+            else
+                emit(OpCode::OC_STORE, symbol);
+            break;
+        }
+        case Operator::OP_TO_NUMERIC:
+            emit(OpCode::OC_TO_NUMERIC);
+            break;
+        case Operator::OP_TO_STRING:
+            emit(OpCode::OC_TO_STRING);
+            break;
+        case Operator::OP_PRINT:
+        case Operator::OP_INPUT:
+            // Each operand is printed as soon as it is evaluated, like the tree-walking runtime does.
+            emit(OpCode::OC_PRINT);
+            break;
+        case Operator::OP_IF:
+            // (if condition then else) => condition, JUMP_IF_FALSE else, then, JUMP end, else.
+            if(pending.operand == node->getChildren().begin())
+            {
+                emit(OpCode::OC_JUMP_IF_FALSE);
+                pending.jump = m_bytecode.code.size() - 1;
+            }
+            else if(pending.operand == node->getChildren().begin() + 1)
+            {
+                emit(OpCode::OC_JUMP);
+
+                // Only one of the branches pushes its value.
+                --m_stackSize;
+
+                patch(pending.jump);
+                pending.jump = m_bytecode.code.size() - 1;
+            }
+            break;
+        case Operator::OP_CALL:
+            // The arguments are left on the stack, they become the first locals of the frame.
+            break;
+
+        /** Maths built-in operations. */
+        case Operator::OP_ADD:
+        case Operator::OP_SUB:
+        case Operator::OP_MUL:
+        case Operator::OP_DIV:
+        case Operator::OP_MOD:
+        case Operator::OP_POW:
+            // Left fold : (- a b c) => (a - b) - c.
+            if(pending.operand == node->getChildren().begin())
+                emit(OpCode::OC_CHECK, static_cast<std::uint32_t>(op));
+            else
+                emit(binary_opcode(op));
+            break;
+        case Operator::OP_SIN:
+        case Operator::OP_COS:
+        case Operator::OP_TAN:
+        case Operator::OP_ACOS:
+        case Operator::OP_ASIN:
+        case Operator::OP_ATAN:
+        case Operator::OP_TO_RAD:
+        case Operator::OP_TO_DEG:
+        case Operator::OP_LN:
+        case Operator::OP_EXP:
+        case Operator::OP_LOG10:
+        case Operator::OP_SQUARE:
+            emit(unary_opcode(op));
+            break;
+        case Operator::OP_FUNCTION:
+        case Operator::OP_NONE:
+        default:
+            // The definitions and the expressions without operator are compiled as a whole by enterNode().
+            errors::runtimeError("internal: " + string_utils::from(op) + " has no operands to compile");
+            break;
+    }
+
+    if(++pending.operand != pending.last)
+    {
+        // The branches of a condition are in tail position if the condition is.
+        m_tail = op == Operator::OP_IF && pending.tail;
+        return *pending.operand;
+    }
+
+    std::size_t jump = pending.jump;
+    bool tail = pending.tail;
+
+    m_pending.pop_back();
+
+    switch(op)
+    {
+        case Operator::OP_PROGRAM:
+        case Operator::OP_ASSIGN:
+        case Operator::OP_PRINT:
+            emit(OpCode::OC_PUSH_NULL);
+            break;
+        case Operator::OP_INPUT:
+            emit(OpCode::OC_INPUT);
+            break;
+        case Operator::OP_IF:
+            // Without an alternative, a false condition gives null.
+            if(node->getChildren().size() == 2)
+                emit(OpCode::OC_PUSH_NULL);
+
+            patch(jump);
+            break;
+        case Operator::OP_CALL:
+            emit(tail ? OpCode::OC_TAIL_CALL : OpCode::OC_CALL, node->getChildren().front()->getSlot() | static_cast<std::uint32_t>(node->getChildren().size() - 1) << 24);
+            break;
+        case Operator::OP_TO_NUMERIC:
+        case Operator::OP_TO_STRING:
+        case Operator::OP_ADD:
+        case Operator::OP_SUB:
+        case Operator::OP_MUL:
+        case Operator::OP_DIV:
+        case Operator::OP_MOD:
+        case Operator::OP_POW:
+        case Operator::OP_SIN:
+        case Operator::OP_COS:
+        case Operator::OP_TAN:
+        case Operator::OP_ACOS:
+        case Operator::OP_ASIN:
+        case Operator::OP_ATAN:
+        case Operator::OP_TO_RAD:
+        case Operator::OP_TO_DEG:
+        case Operator::OP_LN:
+        case Operator::OP_EXP:
+        case Operator::OP_LOG10:
+        case Operator::OP_SQUARE:
+            break;
+        case Operator::OP_FUNCTION:
+        case Operator::OP_NONE:
+        default:
+            errors::runtimeError("internal: " + string_utils::from(op) + " has no operands to compile");
+            break;
+    }
+
+    return nullptr;
+}
+
+void Compiler::define(NodeList definition)
+{
+    std::shared_ptr<Function> function = std::make_shared<Function>();
+    function->declare(definition);
+
+    // By a compiler of its own : only the nesting of the definitions recurses, not the one of the expressions.
+    function->bytecode = Compiler().compile(definition.back(), function.get());
+
+    m_bytecode.functions.push_back(function);
+    emit(OpCode::OC_DEFINE, static_cast<std::uint32_t>(m_bytecode.functions.size() - 1));
+}
+
+void Compiler::emit(OpCode opcode, std::uint32_t operand)
+{
+    m_bytecode.code.push_back(Instruction(opcode, operand));
+
+    m_stackSize = static_cast<std::size_t>(static_cast<int>(m_stackSize) + stack_effect(opcode, operand));
+
+    if(m_stackSize > m_bytecode.maxStackSize)
+        m_bytecode.maxStackSize = m_stackSize;
+}
+
+void Compiler::patch(std::size_t jump)
+{
+    // To the next instruction emitted.
+    m_bytecode.code[jump].operand = static_cast<std::uint32_t>(m_bytecode.code.size() - jump);
+}
+
+void Compiler::fail(const std::string& message)
+{
+    // Errors are reported when the faulty expression is reached, not at compile time,
+    // so that the side effects before it still happen.
+    m_bytecode.messages.push_back(message);
+    emit(OpCode::OC_FAIL, static_cast<std::uint32_t>(m_bytecode.messages.size() - 1));
+}
+
+std::uint32_t Compiler::addConstant(const Value& value)
+{
+    m_bytecode.constants.push_back(value);
+    return static_cast<std::uint32_t>(m_bytecode.constants.size() - 1);
+}
@@ -0,0 +1,92 @@
+/*
+	compiler.hpp
+
+	The MIT License (MIT)
+
+	Copyright (c) 2014 Maxime Alvarez
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+	Defines the compiler lowering the AST into bytecode.
+*/
+
+#ifndef COMPILER_HPP_INCLUDED
+#define COMPILER_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include "bytecode.hpp"
+#include "datatypes.hpp"
+#include "function.hpp"
+
+class Compiler
+{
+    public:
+        Compiler();
+
+        // Compile a program, or the body of a function : its locals are then in the slots of its frame.
+        Bytecode compile(Node* root, const Function* function = nullptr);
+
+    protected:
+        // Depth first without recursion, the nesting depth is only limited by the memory.
+        void compileNode(Node* root);
+
+        // Emit a leaf, or start an expression and return its first operand to compile.
+        Node* enterNode(Node* node);
+        // Emit what follows the operand just compiled, return the next one or nullptr once the expression is complete.
+        Node* leaveOperand();
+
+        // Compile the body of a (function ...) form and bind its name.
+        void define(NodeList definition);
+
+        void emit(OpCode opcode, std::uint32_t operand = 0);
+        // Set the distance of the jump at the given index.
+        void patch(std::size_t jump);
+        void fail(const std::string& message);
+
+        std::uint32_t addConstant(const Value& value);
+
+    protected:
+        Bytecode m_bytecode;
+        std::size_t m_stackSize;
+
+        // The function whose body is compiled, nullptr for a program.
+        const Function* m_function;
+        // Whether the node entered next is in tail position : its value is the result of the function.
+        bool m_tail;
+
+        // An expression whose operands are being compiled, a range of its children.
+        struct Pending
+        {
+            Node* node;
+            Node* const* operand;
+            Node* const* last;
+
+            // The jump to patch once the next branch of a condition is compiled.
+            std::size_t jump;
+            // Whether the expression is in tail position.
+            bool tail;
+        };
+
+        // Innermost last.
+        std::vector<Pending> m_pending;
+};
+
+#endif // COMPILER_HPP_INCLUDED
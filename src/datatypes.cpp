@@ -1,5 +1,31 @@
 #include "datatypes.hpp"
 
+#include <cstring>
+#include <new>
+
+namespace
+{
+    // Return the character of the escape sequence \c.
+    char unescape(char c)
+    {
+        switch(c)
+        {
+            case 'n':
+                return '\n';
+            case 't':
+                return '\t';
+            case 'r':
+                return '\r';
+            case 'f':
+                return '\f';
+            case 'v':
+                return '\v';
+            default:
+                return c;
+        }
+    }
+}
+
 template<>
 std::string string_utils::from(TokenType type)
 {
@@ -20,3 +46,114 @@ std::string string_utils::from(TokenType type)
 
     return "";
 }
+
+
+template<>
+std::string string_utils::from(Operator op)
+{
+    switch(op)
+    {
+        case Operator::OP_PROGRAM: return "program";
+        case Operator::OP_ASSIGN: return "assign";
+        case Operator::OP_TO_NUMERIC: return "to_numeric";
+        case Operator::OP_TO_STRING: return "to_string";
+        case Operator::OP_PRINT: return "print";
+        case Operator::OP_INPUT: return "input";
+        case Operator::OP_IF: return "if";
+        case Operator::OP_FUNCTION: return "function";
+        case Operator::OP_CALL: return "call";
+        case Operator::OP_ADD: return "add";
+        case Operator::OP_SUB: return "sub";
+        case Operator::OP_MUL: return "mul";
+        case Operator::OP_DIV: return "div";
+        case Operator::OP_MOD: return "mod";
+        case Operator::OP_POW: return "pow";
+        case Operator::OP_SIN: return "sin";
+        case Operator::OP_COS: return "cos";
+        case Operator::OP_TAN: return "tan";
+        case Operator::OP_ACOS: return "acos";
+        case Operator::OP_ASIN: return "asin";
+        case Operator::OP_ATAN: return "atan";
+        case Operator::OP_TO_RAD: return "to_rad";
+        case Operator::OP_TO_DEG: return "to_deg";
+        case Operator::OP_LN: return "ln";
+        case Operator::OP_EXP: return "exp";
+        case Operator::OP_LOG10: return "log10";
+        case Operator::OP_SQUARE: return "square";
+        case Operator::OP_NONE:
+        default: return "none";
+    }
+}
+
+StringObject* StringObject::create(const char* data, std::size_t size)
+{
+    StringObject* object = allocate(size);
+
+    if(size > 0)
+        std::memcpy(object + 1, data, size);
+
+    return object;
+}
+
+StringObject* StringObject::unescape(const char* text, std::size_t size)
+{
+    // The decoded string is at most as long as the text, the size is fixed once it is written.
+    StringObject* object = allocate(size);
+    char* data = reinterpret_cast<char*>(object + 1);
+    const char* end = text + size;
+
+    // Copy the runs between the backslashes, a trailing backslash is dropped.
+    for(const char* cursor(text) ; cursor < end ; )
+    {
+        const char* backslash = static_cast<const char*>(std::memchr(cursor, '\\', end - cursor));
+        const char* run = backslash ? backslash : end;
+
+        std::memcpy(data, cursor, run - cursor);
+        data += run - cursor;
+
+        if(!backslash || backslash + 1 == end)
+            break;
+
+        *data++ = ::unescape(backslash[1]);
+        cursor = backslash + 2;
+    }
+
+    object->m_size = static_cast<std::uint32_t>(data - reinterpret_cast<char*>(object + 1));
+    return object;
+}
+
+StringObject* StringObject::concatenate(const StringObject* lhs, const StringObject* rhs)
+{
+    StringObject* object = allocate(lhs->getSize() + rhs->getSize());
+    char* data = reinterpret_cast<char*>(object + 1);
+
+    if(lhs->getSize() > 0)
+        std::memcpy(data, lhs->getData(), lhs->getSize());
+
+    if(rhs->getSize() > 0)
+        std::memcpy(data + lhs->getSize(), rhs->getData(), rhs->getSize());
+
+    return object;
+}
+
+void StringLiteral::release(void* literal)
+{
+    StringLiteral* decoded = static_cast<StringLiteral*>(literal);
+
+    if(decoded->string)
+        decoded->string->release();
+}
+
+StringObject* StringObject::allocate(std::size_t size)
+{
+    void* memory = std::malloc(sizeof(StringObject) + size);
+
+    if(!memory)
+        throw std::bad_alloc();
+
+    StringObject* object = new(memory) StringObject();
+    object->m_references = 1;
+    object->m_size = static_cast<std::uint32_t>(size);
+
+    return object;
+}
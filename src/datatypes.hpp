@@ -32,16 +32,20 @@
     #define M_PI 3.1415926535
 #endif
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <map>
 #include <cmath>
 #include <cassert>
+#include <cstdlib>
+#include <utility>
 
+#include "arena.hpp"
 #include "string_utils.hpp"
 #include "errors.hpp"
 
-enum class TokenType
+enum class TokenType : std::uint8_t
 {
 	TT_NUMERIC,
 	TT_IDENTIFIER,
@@ -55,26 +59,10 @@ enum class TokenType
 	TT_NONE
 };
 
-const std::map<std::string, TokenType> keywordsTable =
-{
-    {"null", TokenType::TT_NULL},
-    {"function", TokenType::TT_FUNCTION}
-};
-
 template<>
 std::string string_utils::from(TokenType type);
 
-struct Token
-{
-	Token(TokenType type = TokenType::TT_NONE, std::string value = "")
-        : type(type), value(value)
-	{};
-
-	TokenType type;
-	std::string value;
-};
-
-enum class Operator
+enum class Operator : std::uint8_t
 {
     /** Special built-in operators. */
     OP_PROGRAM,
@@ -83,6 +71,9 @@ enum class Operator
     OP_TO_STRING,
     OP_PRINT,
     OP_INPUT,
+    OP_IF,
+    OP_FUNCTION,
+    OP_CALL,
 
     /** Maths built-in operators. */
     OP_ADD,
@@ -102,131 +93,359 @@ enum class Operator
     OP_LN,
     OP_EXP,
     OP_LOG10,
+    // (^ e 2) as rewritten by the optimizer, it cannot be written in the source.
+    OP_SQUARE,
 
     OP_NONE
 };
 
-const std::map<std::string, Operator> operatorsTable =
+template<>
+std::string string_utils::from(Operator op);
+
+/// Interned identifier, see symbol_table.hpp.
+typedef std::uint32_t Symbol;
+
+/// A token does not own its text : it is a view on the source given to the lexer.
+/// The identifiers are interned, their text is the name of their symbol. The strings
+/// are left as they are written : escaped tells they have escape sequences to decode.
+struct Token
 {
-    /** Special built-in operators. */
-    {"program", Operator::OP_PROGRAM},
-    {"assign", Operator::OP_ASSIGN},
-    {"to_numeric", Operator::OP_TO_NUMERIC},
-    {"to_string", Operator::OP_TO_STRING},
-    {"print", Operator::OP_PRINT},
-    {"input", Operator::OP_INPUT},
+	Token(TokenType tokenType = TokenType::TT_NONE, std::uint32_t start = 0, std::uint32_t size = 0, bool hasEscapes = false, Operator oper = Operator::OP_NONE)
+        : type(tokenType), escaped(hasEscapes), op(oper), offset(start), length(size)
+	{};
 
-    /** Maths built-in operators. */
-    {"+", Operator::OP_ADD},
-    {"-", Operator::OP_SUB},
-    {"*", Operator::OP_MUL},
-    {"/", Operator::OP_DIV},
-    {"%", Operator::OP_MOD},
-    {"^", Operator::OP_POW},
-    {"sin", Operator::OP_SIN},
-    {"cos", Operator::OP_COS},
-    {"tan", Operator::OP_TAN},
-    {"acos", Operator::OP_ACOS},
-    {"asin", Operator::OP_ASIN},
-    {"atan", Operator::OP_ATAN},
-    {"to_rad", Operator::OP_TO_RAD},
-    {"to_deg", Operator::OP_TO_DEG},
-    {"ln", Operator::OP_LN},
-    {"exp", Operator::OP_EXP},
-    {"log10", Operator::OP_LOG10}
+	TokenType type;
+	bool escaped;
+
+	// Recognized once by the lexer for the operators.
+	Operator op;
+
+	union
+	{
+	    std::uint32_t offset;
+	    Symbol symbol;
+	};
+
+	std::uint32_t length;
 };
 
-enum class ValueType
+static_assert(sizeof(Token) == 12, "tokens are stored by millions, keep them small");
+
+enum class ValueType : std::uint8_t
 {
     VT_NUMERIC,
     VT_STRING,
 
-    VT_NONE
+    VT_NONE,
+
+    // Only used by the runtime for the variables which have not been assigned yet.
+    VT_UNASSIGNED
 };
 
+/// Immutable reference counted string, the storage of the string values.
+/// The characters are allocated right after the object. The counter is not atomic :
+/// values must not be shared between threads.
+class StringObject
+{
+    public:
+        // Return a new string with one reference.
+        static StringObject* create(const char* data, std::size_t size);
+        // Same with the escape sequences of the text decoded, \n for a line feed...
+        static StringObject* unescape(const char* text, std::size_t size);
+        static StringObject* concatenate(const StringObject* lhs, const StringObject* rhs);
+
+        void acquire()
+        {
+            ++m_references;
+        }
+
+        void release()
+        {
+            if(--m_references == 0)
+                std::free(this);
+        }
+
+        const char* getData() const
+        {
+            return reinterpret_cast<const char*>(this + 1);
+        }
+
+        std::size_t getSize() const
+        {
+            return m_size;
+        }
+
+        std::string toStdString() const
+        {
+            return std::string(getData(), getData() + m_size);
+        }
+
+    protected:
+        StringObject() = default;
+
+        static StringObject* allocate(std::size_t size);
+
+        std::uint32_t m_references;
+        std::uint32_t m_size;
+};
+
+/// 16 bytes tagged union : a number, a handle to a string or nothing.
 struct Value
 {
     Value()
         : type(ValueType::VT_NONE)
         , numeric(0.f)
-        , string("")
     {}
 
     Value(float numeric)
         : type(ValueType::VT_NUMERIC)
         , numeric(numeric)
-        , string("")
     {}
 
-    Value(std::string string)
+    Value(const std::string& string)
+        : type(ValueType::VT_STRING)
+        , string(StringObject::create(string.data(), string.size()))
+    {}
+
+    // Takes ownership of one reference.
+    explicit Value(StringObject* string)
         : type(ValueType::VT_STRING)
-        , numeric(0.0)
         , string(string)
     {}
 
+    Value(const Value& other)
+        : type(other.type)
+        , string(other.string)
+    {
+        if(type == ValueType::VT_STRING)
+            string->acquire();
+    }
+
+    Value(Value&& other)
+        : type(other.type)
+        , string(other.string)
+    {
+        other.type = ValueType::VT_NONE;
+    }
+
+    ~Value()
+    {
+        if(type == ValueType::VT_STRING)
+            string->release();
+    }
+
+    Value& operator=(const Value& other)
+    {
+        if(other.type == ValueType::VT_STRING)
+            other.string->acquire();
+
+        if(type == ValueType::VT_STRING)
+            string->release();
+
+        type = other.type;
+        string = other.string;
+
+        return *this;
+    }
+
+    Value& operator=(Value&& other)
+    {
+        std::swap(type, other.type);
+        std::swap(string, other.string);
+
+        return *this;
+    }
+
     ValueType type;
 
-    float numeric;
-    std::string string;
+    union
+    {
+        float numeric;
+        StringObject* string;
+    };
 };
 
-enum class NodeType
+enum class NodeType : std::uint8_t
 {
     NT_IDENTIFIER,
+    // Identifier of a local variable of a function, resolved to its slot in the frame of the call.
+    NT_LOCAL,
     NT_CONST_VALUE,
     NT_EXPRESSION,
 
     NT_NONE
 };
 
+class Node;
+
+/// Read-only view on the children of a node. It does not own them : they live in the
+/// same arena as the node, so it can be passed around by value without allocating.
+class NodeList
+{
+    public:
+        NodeList(Node* const* nodes = nullptr, std::size_t size = 0)
+            : m_nodes(nodes)
+            , m_size(size)
+        {}
+
+        Node* const* begin() const
+        {
+            return m_nodes;
+        }
+
+        Node* const* end() const
+        {
+            return m_nodes + m_size;
+        }
+
+        std::size_t size() const
+        {
+            return m_size;
+        }
+
+        bool empty() const
+        {
+            return m_size == 0;
+        }
+
+        Node* front() const
+        {
+            return m_nodes[0];
+        }
+
+        Node* back() const
+        {
+            return m_nodes[m_size - 1];
+        }
+
+        Node* operator[](std::size_t index) const
+        {
+            return m_nodes[index];
+        }
+
+    protected:
+        Node* const* m_nodes;
+        std::size_t m_size;
+};
+
+/// Text of a string constant, and the string decoded from it at its first evaluation.
+/// It lives in the arena of the text, which releases the string with it.
+struct StringLiteral
+{
+    const char* text;
+    StringObject* string;
+
+    static void release(void* literal);
+};
+
+/// Nodes are allocated in an Arena (see arena.hpp) and released all at once with it,
+/// so they only hold trivially destructible members pointing to the same arena.
 class Node
 {
     public:
-        Node(NodeType type, Operator op, Value value)
-            : m_type(type)
-            , m_identifier("")
-            , m_value(value)
-            , m_op(op)
+        // Null constant value.
+        Node()
+            : m_type(NodeType::NT_CONST_VALUE)
+            , m_op(Operator::OP_NONE)
+            , m_valueType(ValueType::VT_NONE)
+            , m_escaped(false)
+            , m_numeric(0.f)
+            , m_literal(nullptr)
+            , m_children(nullptr)
+            , m_textLength(0)
+            , m_childCount(0)
+            , m_slot(0)
         {}
 
-        Node(const std::string& identifier_or_string, NodeType type)
-            : m_type(type)
+        // String constant value, as written in the source : escaped tells it has escape sequences.
+        // The text is copied in the arena.
+        Node(Arena& arena, const char* text, std::size_t length, bool escaped = false)
+            : m_type(NodeType::NT_CONST_VALUE)
             , m_op(Operator::OP_NONE)
+            , m_valueType(ValueType::VT_STRING)
+            , m_escaped(escaped)
+            , m_numeric(0.f)
+            , m_literal(arena.create<StringLiteral>(StringLiteral{length != 0 ? arena.copy(text, length) : "", nullptr}))
+            , m_children(nullptr)
+            , m_textLength(static_cast<std::uint32_t>(length))
+            , m_childCount(0)
+            , m_slot(0)
         {
-            if(type == NodeType::NT_CONST_VALUE)
-                m_value = Value(identifier_or_string);
-            else
-                m_identifier = identifier_or_string;
+            arena.defer(&StringLiteral::release, m_literal);
         }
 
+        // Identifier, its variable slot is its symbol.
+        explicit Node(Symbol symbol)
+            : m_type(NodeType::NT_IDENTIFIER)
+            , m_op(Operator::OP_NONE)
+            , m_valueType(ValueType::VT_NONE)
+            , m_escaped(false)
+            , m_numeric(0.f)
+            , m_literal(nullptr)
+            , m_children(nullptr)
+            , m_textLength(0)
+            , m_childCount(0)
+            , m_slot(symbol)
+        {}
+
         Node(float value)
             : m_type(NodeType::NT_CONST_VALUE)
-            , m_identifier("")
-            , m_value(value)
             , m_op(Operator::OP_NONE)
+            , m_valueType(ValueType::VT_NUMERIC)
+            , m_escaped(false)
+            , m_numeric(value)
+            , m_literal(nullptr)
+            , m_children(nullptr)
+            , m_textLength(0)
+            , m_childCount(0)
+            , m_slot(0)
         {}
 
         Node(Operator op)
             : m_type(NodeType::NT_EXPRESSION)
-            , m_identifier("")
-            , m_value(0.f)
             , m_op(op)
+            , m_valueType(ValueType::VT_NONE)
+            , m_escaped(false)
+            , m_numeric(0.f)
+            , m_literal(nullptr)
+            , m_children(nullptr)
+            , m_textLength(0)
+            , m_childCount(0)
+            , m_slot(0)
         {}
 
-        ~Node()
+        void setChildren(Node** children, std::size_t count)
         {
-            for(Node* child : m_children)
-                delete child;
+            m_children = children;
+            m_childCount = static_cast<std::uint32_t>(count);
         }
 
-        void addChild(Node* child)
+        void setChild(std::size_t index, Node* child)
         {
-            m_children.push_back(child);
+            m_children[index] = child;
         }
 
-        std::vector<Node*> getChildren() const
+        // Forget the first count children of an expression, for the optimizer.
+        void removeFirstChildren(std::size_t count)
         {
-            return m_children;
+            m_children += count;
+            m_childCount -= static_cast<std::uint32_t>(count);
+        }
+
+        // Forget the last count children of an expression, for the optimizer.
+        void removeLastChildren(std::size_t count)
+        {
+            m_childCount -= static_cast<std::uint32_t>(count);
+        }
+
+        void setOperator(Operator op)
+        {
+            m_op = op;
+        }
+
+        NodeList getChildren() const
+        {
+            return NodeList(m_children, m_childCount);
         }
 
         NodeType getType() const
@@ -234,14 +453,45 @@ class Node
             return m_type;
         }
 
-        std::string getIdentifier() const
+        // A string is decoded at the first call, the next ones share it.
+        Value getValue() const
         {
-            return m_identifier;
+            if(m_valueType == ValueType::VT_NUMERIC)
+                return Value(m_numeric);
+            else if(m_valueType == ValueType::VT_STRING)
+            {
+                if(!m_literal->string)
+                    m_literal->string = m_escaped ? StringObject::unescape(m_literal->text, m_textLength) : StringObject::create(m_literal->text, m_textLength);
+
+                m_literal->string->acquire();
+                return Value(m_literal->string);
+            }
+            else if(m_type == NodeType::NT_EXPRESSION)
+                return Value(0.f);
+
+            return Value();
         }
 
-        Value getValue() const
+        // Type of a constant value.
+        ValueType getValueType() const
+        {
+            return m_valueType;
+        }
+
+        // Text of a string constant, escape sequences included.
+        const char* getText() const
+        {
+            return m_literal->text;
+        }
+
+        std::size_t getTextLength() const
         {
-            return m_value;
+            return m_textLength;
+        }
+
+        bool hasEscapes() const
+        {
+            return m_escaped;
         }
 
         Operator getOperator() const
@@ -249,13 +499,40 @@ class Node
             return m_op;
         }
 
+        // Variable slot of an identifier.
+        std::uint32_t getSlot() const
+        {
+            return m_slot;
+        }
+
+        // Unused by the parser for the expressions : the runtime keeps the copy of a function definition there.
+        void setSlot(std::uint32_t slot)
+        {
+            m_slot = slot;
+        }
+
+        // Turn an identifier into a local variable of a function.
+        void setLocal(std::uint32_t slot)
+        {
+            m_type = NodeType::NT_LOCAL;
+            m_slot = slot;
+        }
+
     protected:
         NodeType m_type;
-        std::string m_identifier;
-        Value m_value;
         Operator m_op;
+        ValueType m_valueType;
+        bool m_escaped;
+
+        float m_numeric;
+
+        StringLiteral* m_literal;
+        Node** m_children;
+
+        std::uint32_t m_textLength;
+        std::uint32_t m_childCount;
 
-        std::vector<Node*> m_children;
+        std::uint32_t m_slot;
 };
 
 #endif // DATATYPES_HPP_INCLUDED
@@ -0,0 +1,280 @@
+/*
+	flat_ast.hpp
+
+	The MIT License (MIT)
+
+	Copyright (c) 2014 Maxime Alvarez
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+	Defines a flat AST : one contiguous array per node field, nodes are addressed by index.
+*/
+
+#ifndef FLAT_AST_HPP_INCLUDED
+#define FLAT_AST_HPP_INCLUDED
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "datatypes.hpp"
+
+typedef std::uint32_t NodeIndex;
+
+/// The children of a node are the range [firstChild, firstChild + childCount) of the children array.
+/// Leaves use the literal field : an index in the literal pool for constants, the symbol for identifiers,
+/// the slot in the frame for the locals of a function.
+class FlatAst
+{
+    public:
+        FlatAst()
+            : m_nullLiteral(noLiteral)
+            , m_root(0)
+        {}
+
+        NodeIndex addNumeric(float numeric)
+        {
+            return addNode(NodeType::NT_CONST_VALUE, Operator::OP_NONE, numericLiteral(numeric));
+        }
+
+        // The escape sequences are decoded by the first getLiteral() of the string.
+        NodeIndex addString(const char* text, std::size_t length, bool escaped = false)
+        {
+            std::uint32_t literal = addLiteral(Value(StringObject::create(text, length)));
+            m_escapedLiterals[literal] = escaped;
+
+            return addNode(NodeType::NT_CONST_VALUE, Operator::OP_NONE, literal);
+        }
+
+        NodeIndex addNull()
+        {
+            return addNode(NodeType::NT_CONST_VALUE, Operator::OP_NONE, nullLiteral());
+        }
+
+        NodeIndex addIdentifier(Symbol symbol)
+        {
+            return addNode(NodeType::NT_IDENTIFIER, Operator::OP_NONE, symbol);
+        }
+
+        // Local variable of a function, its slot is in the frame of the call.
+        NodeIndex addLocal(std::uint32_t slot)
+        {
+            return addNode(NodeType::NT_LOCAL, Operator::OP_NONE, slot);
+        }
+
+        // A constant already evaluated, when copying nodes from another AST.
+        NodeIndex addConstant(const Value& value)
+        {
+            return addNode(NodeType::NT_CONST_VALUE, Operator::OP_NONE, addLiteral(value));
+        }
+
+        NodeIndex addExpression(Operator op, const NodeIndex* children, std::size_t count)
+        {
+            NodeIndex index = addNode(NodeType::NT_EXPRESSION, op, 0);
+
+            m_firstChild[index] = static_cast<std::uint32_t>(m_children.size());
+            m_childCount[index] = static_cast<std::uint32_t>(count);
+            m_children.insert(m_children.end(), children, children + count);
+
+            return index;
+        }
+
+        void setRoot(NodeIndex root)
+        {
+            m_root = root;
+        }
+
+        NodeIndex getRoot() const
+        {
+            return m_root;
+        }
+
+        std::size_t size() const
+        {
+            return m_types.size();
+        }
+
+        NodeType getType(NodeIndex index) const
+        {
+            return m_types[index];
+        }
+
+        Operator getOperator(NodeIndex index) const
+        {
+            return m_operators[index];
+        }
+
+        std::uint32_t getChildCount(NodeIndex index) const
+        {
+            return m_childCount[index];
+        }
+
+        const NodeIndex* getChildren(NodeIndex index) const
+        {
+            return m_children.data() + m_firstChild[index];
+        }
+
+        const Value& getLiteral(NodeIndex index) const
+        {
+            std::uint32_t literal = m_literal[index];
+
+            if(m_escapedLiterals[literal])
+            {
+                const StringObject* text = m_literalPool[literal].string;
+                m_literalPool[literal] = Value(StringObject::unescape(text->getData(), text->getSize()));
+                m_escapedLiterals[literal] = false;
+            }
+
+            return m_literalPool[literal];
+        }
+
+        // Variable slot of an identifier, its symbol.
+        std::uint32_t getSlot(NodeIndex index) const
+        {
+            return m_literal[index];
+        }
+
+        // Unused by the parser for the expressions : the runtime keeps the copy of a function definition there.
+        void setSlot(NodeIndex index, std::uint32_t slot)
+        {
+            m_literal[index] = slot;
+        }
+
+        /** Rewriting in place, by the optimizer (see optimizer.hpp). The nodes replaced are left unreachable. */
+        // Turn the node into a constant, an expression forgets its children.
+        void setConstant(NodeIndex index, const Value& value)
+        {
+            std::uint32_t literal(0);
+
+            if(value.type == ValueType::VT_NUMERIC)
+                literal = numericLiteral(value.numeric);
+            else if(value.type == ValueType::VT_NONE)
+                literal = nullLiteral();
+            else
+                literal = addLiteral(value);
+
+            m_types[index] = NodeType::NT_CONST_VALUE;
+            m_operators[index] = Operator::OP_NONE;
+            m_childCount[index] = 0;
+            m_literal[index] = literal;
+        }
+
+        void setOperator(NodeIndex index, Operator op)
+        {
+            m_operators[index] = op;
+        }
+
+        void setChild(NodeIndex index, std::uint32_t child, NodeIndex node)
+        {
+            m_children[m_firstChild[index] + child] = node;
+        }
+
+        // Forget the first count children of an expression.
+        void removeFirstChildren(NodeIndex index, std::uint32_t count)
+        {
+            m_firstChild[index] += count;
+            m_childCount[index] -= count;
+        }
+
+        void removeLastChildren(NodeIndex index, std::uint32_t count)
+        {
+            m_childCount[index] -= count;
+        }
+
+        // Turn the node into a copy of another one, sharing its children.
+        void replace(NodeIndex index, NodeIndex other)
+        {
+            m_types[index] = m_types[other];
+            m_operators[index] = m_operators[other];
+            m_firstChild[index] = m_firstChild[other];
+            m_childCount[index] = m_childCount[other];
+            m_literal[index] = m_literal[other];
+        }
+
+        // Bytes used by one node in the per-node arrays and the children array.
+        static std::size_t getBytesPerNode()
+        {
+            return sizeof(NodeType) + sizeof(Operator) + 3 * sizeof(std::uint32_t) + sizeof(NodeIndex);
+        }
+
+    protected:
+        static const std::uint32_t noLiteral = 0xFFFFFFFF;
+
+        NodeIndex addNode(NodeType type, Operator op, std::uint32_t literal)
+        {
+            m_types.push_back(type);
+            m_operators.push_back(op);
+            m_firstChild.push_back(0);
+            m_childCount.push_back(0);
+            m_literal.push_back(literal);
+
+            return static_cast<NodeIndex>(m_types.size() - 1);
+        }
+
+        std::uint32_t numericLiteral(float numeric)
+        {
+            std::uint32_t bits(0);
+            std::memcpy(&bits, &numeric, sizeof(bits));
+
+            // Generated scripts reuse the same few constants.
+            std::map<std::uint32_t, std::uint32_t>::iterator it = m_numericIndices.find(bits);
+
+            if(it == m_numericIndices.end())
+                it = m_numericIndices.insert(std::make_pair(bits, addLiteral(Value(numeric)))).first;
+
+            return it->second;
+        }
+
+        std::uint32_t nullLiteral()
+        {
+            if(m_nullLiteral == noLiteral)
+                m_nullLiteral = addLiteral(Value());
+
+            return m_nullLiteral;
+        }
+
+        std::uint32_t addLiteral(const Value& value)
+        {
+            m_literalPool.push_back(value);
+            m_escapedLiterals.push_back(false);
+            return static_cast<std::uint32_t>(m_literalPool.size() - 1);
+        }
+
+    protected:
+        std::vector<NodeType> m_types;
+        std::vector<Operator> m_operators;
+        std::vector<std::uint32_t> m_firstChild;
+        std::vector<std::uint32_t> m_childCount;
+        std::vector<std::uint32_t> m_literal;
+
+        std::vector<NodeIndex> m_children;
+
+        // Decoded in place on first use, hence mutable.
+        mutable std::vector<Value> m_literalPool;
+        mutable std::vector<bool> m_escapedLiterals;
+
+        std::map<std::uint32_t, std::uint32_t> m_numericIndices;
+        std::uint32_t m_nullLiteral;
+
+        NodeIndex m_root;
+};
+
+#endif // FLAT_AST_HPP_INCLUDED
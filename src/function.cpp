@@ -0,0 +1,344 @@
+#include "function.hpp"
+
+#include <algorithm>
+
+const std::uint32_t Function::noLocal;
+const std::uint32_t Function::maxArguments;
+
+namespace
+{
+    void add_local(Function& function, Symbol symbol, bool parameter)
+    {
+        // A parameter always has its slot, for the arguments to be stored in order : the last one of a name wins.
+        if(!parameter && function.slots.count(symbol) != 0)
+            return;
+
+        function.slots[symbol] = static_cast<std::uint32_t>(function.locals.size());
+        function.locals.push_back(symbol);
+    }
+
+    // The identifiers of a nested definition are not resolved, nor is the name of a called function.
+    bool resolves_child(Operator op, std::size_t index)
+    {
+        return op != Operator::OP_FUNCTION && !(op == Operator::OP_CALL && index == 0);
+    }
+
+    // The identifiers read by the body and the names of its calls without arguments, once the locals are known.
+    void resolve_effects(Function& function, const std::vector<Symbol>& reads, const std::vector<Symbol>& calls)
+    {
+        for(Symbol symbol : reads)
+            function.sideEffects |= function.findLocal(symbol) == Function::noLocal;
+
+        // (name) reads a local, or calls a function.
+        for(Symbol symbol : calls)
+        {
+            if(function.findLocal(symbol) == Function::noLocal)
+                function.callees.push_back(symbol);
+        }
+
+        std::sort(function.callees.begin(), function.callees.end());
+        function.callees.erase(std::unique(function.callees.begin(), function.callees.end()), function.callees.end());
+    }
+}
+
+Function::Function()
+    : name(0)
+    , parameterCount(0)
+    , node(nullptr)
+    , sideEffects(false)
+    , bindings(0)
+    , pure(false)
+{}
+
+void Function::declare(NodeList definition)
+{
+    name = definition.front()->getSlot();
+    parameterCount = static_cast<std::uint32_t>(definition.size() - 2);
+
+    for(std::size_t i(1) ; i + 1 < definition.size() ; ++i)
+        add_local(*this, definition[i]->getSlot(), true);
+
+    // The variables assigned by the body, out of its nested definitions, and its effects.
+    std::vector<const Node*> nodes(1, definition.back());
+    std::vector<Symbol> reads, calls;
+
+    while(!nodes.empty())
+    {
+        const Node* expression = nodes.back();
+        nodes.pop_back();
+
+        if(expression->getType() == NodeType::NT_IDENTIFIER)
+            reads.push_back(expression->getSlot());
+
+        if(expression->getType() != NodeType::NT_EXPRESSION)
+            continue;
+
+        NodeList children = expression->getChildren();
+        Node* const* first = children.begin();
+
+        switch(expression->getOperator())
+        {
+            case Operator::OP_ASSIGN:
+                if(!children.empty() && children.front()->getType() == NodeType::NT_IDENTIFIER)
+                    add_local(*this, children.front()->getSlot(), false);
+                break;
+            case Operator::OP_PRINT:
+            case Operator::OP_INPUT:
+            case Operator::OP_FUNCTION:
+                sideEffects = true;
+                break;
+            case Operator::OP_CALL:
+                (children.size() == 1 ? calls : callees).push_back(children.front()->getSlot());
+                ++first;
+                break;
+            case Operator::OP_PROGRAM:
+            case Operator::OP_TO_NUMERIC:
+            case Operator::OP_TO_STRING:
+            case Operator::OP_IF:
+            case Operator::OP_ADD:
+            case Operator::OP_SUB:
+            case Operator::OP_MUL:
+            case Operator::OP_DIV:
+            case Operator::OP_MOD:
+            case Operator::OP_POW:
+            case Operator::OP_SIN:
+            case Operator::OP_COS:
+            case Operator::OP_TAN:
+            case Operator::OP_ACOS:
+            case Operator::OP_ASIN:
+            case Operator::OP_ATAN:
+            case Operator::OP_TO_RAD:
+            case Operator::OP_TO_DEG:
+            case Operator::OP_LN:
+            case Operator::OP_EXP:
+            case Operator::OP_LOG10:
+            case Operator::OP_SQUARE:
+            case Operator::OP_NONE:
+            default:
+                break;
+        }
+
+        if(expression->getOperator() != Operator::OP_FUNCTION)
+            nodes.insert(nodes.end(), first, children.end());
+    }
+
+    resolve_effects(*this, reads, calls);
+}
+
+void Function::declare(const FlatAst& source, NodeIndex definition)
+{
+    const NodeIndex* children = source.getChildren(definition);
+    std::uint32_t count = source.getChildCount(definition);
+
+    name = source.getSlot(children[0]);
+    parameterCount = count - 2;
+
+    for(std::uint32_t i(1) ; i + 1 < count ; ++i)
+        add_local(*this, source.getSlot(children[i]), true);
+
+    std::vector<NodeIndex> nodes(1, children[count - 1]);
+    std::vector<Symbol> reads, calls;
+
+    while(!nodes.empty())
+    {
+        NodeIndex index = nodes.back();
+        nodes.pop_back();
+
+        if(source.getType(index) == NodeType::NT_IDENTIFIER)
+            reads.push_back(source.getSlot(index));
+
+        if(source.getType(index) != NodeType::NT_EXPRESSION)
+            continue;
+
+        const NodeIndex* operands = source.getChildren(index);
+        std::uint32_t operandCount = source.getChildCount(index);
+        std::uint32_t first = 0;
+
+        switch(source.getOperator(index))
+        {
+            case Operator::OP_ASSIGN:
+                if(operandCount != 0 && source.getType(operands[0]) == NodeType::NT_IDENTIFIER)
+                    add_local(*this, source.getSlot(operands[0]), false);
+                break;
+            case Operator::OP_PRINT:
+            case Operator::OP_INPUT:
+            case Operator::OP_FUNCTION:
+                sideEffects = true;
+                break;
+            case Operator::OP_CALL:
+                (operandCount == 1 ? calls : callees).push_back(source.getSlot(operands[0]));
+                first = 1;
+                break;
+            case Operator::OP_PROGRAM:
+            case Operator::OP_TO_NUMERIC:
+            case Operator::OP_TO_STRING:
+            case Operator::OP_IF:
+            case Operator::OP_ADD:
+            case Operator::OP_SUB:
+            case Operator::OP_MUL:
+            case Operator::OP_DIV:
+            case Operator::OP_MOD:
+            case Operator::OP_POW:
+            case Operator::OP_SIN:
+            case Operator::OP_COS:
+            case Operator::OP_TAN:
+            case Operator::OP_ACOS:
+            case Operator::OP_ASIN:
+            case Operator::OP_ATAN:
+            case Operator::OP_TO_RAD:
+            case Operator::OP_TO_DEG:
+            case Operator::OP_LN:
+            case Operator::OP_EXP:
+            case Operator::OP_LOG10:
+            case Operator::OP_SQUARE:
+            case Operator::OP_NONE:
+            default:
+                break;
+        }
+
+        if(source.getOperator(index) != Operator::OP_FUNCTION)
+            nodes.insert(nodes.end(), operands + first, operands + operandCount);
+    }
+
+    resolve_effects(*this, reads, calls);
+}
+
+std::uint32_t Function::findLocal(Symbol symbol) const
+{
+    std::map<Symbol, std::uint32_t>::const_iterator it = slots.find(symbol);
+    return it == slots.end() ? noLocal : it->second;
+}
+
+void Function::copyBody(const Node* body, Arena& arena)
+{
+    // The expressions whose children are being copied, innermost last.
+    struct Copy
+    {
+        const Node* source;
+        Node* copy;
+        std::size_t next;
+        bool resolve;
+    };
+
+    std::vector<Copy> copies;
+
+    Node* copy = nullptr;
+    const Node* source = body;
+    bool resolve = true;
+
+    for(;;)
+    {
+        // (name) reads a local rather than calling a function of the same name.
+        if(resolve && source->getOperator() == Operator::OP_CALL && source->getChildren().size() == 1
+           && findLocal(source->getChildren().front()->getSlot()) != noLocal)
+        {
+            copy = arena.create<Node>(source->getChildren().front()->getSlot());
+            copy->setLocal(findLocal(copy->getSlot()));
+        }
+        else if(source->getType() == NodeType::NT_EXPRESSION)
+        {
+            NodeList children = source->getChildren();
+
+            copy = arena.create<Node>(source->getOperator());
+            copy->setChildren(children.empty() ? nullptr : static_cast<Node**>(arena.allocate(sizeof(Node*) * children.size(), alignof(Node*))), children.size());
+        }
+        else if(source->getType() == NodeType::NT_IDENTIFIER)
+        {
+            copy = arena.create<Node>(source->getSlot());
+
+            if(resolve && findLocal(source->getSlot()) != noLocal)
+                copy->setLocal(findLocal(source->getSlot()));
+        }
+        else if(source->getValueType() == ValueType::VT_STRING)
+            copy = arena.create<Node>(arena, source->getText(), source->getTextLength(), source->hasEscapes());
+        else if(source->getValueType() == ValueType::VT_NUMERIC)
+            copy = arena.create<Node>(source->getValue().numeric);
+        else
+            copy = arena.create<Node>(*source);
+
+        if(copies.empty())
+            node = copy;
+        else
+            copies.back().copy->setChild(copies.back().next - 1, copy);
+
+        if(copy->getType() == NodeType::NT_EXPRESSION && !copy->getChildren().empty())
+            copies.push_back(Copy{source, copy, 0, resolve});
+
+        while(!copies.empty() && copies.back().next == copies.back().source->getChildren().size())
+            copies.pop_back();
+
+        if(copies.empty())
+            return;
+
+        Copy& parent = copies.back();
+
+        source = parent.source->getChildren()[parent.next];
+        resolve = parent.resolve && resolves_child(parent.source->getOperator(), parent.next);
+        ++parent.next;
+    }
+}
+
+void Function::copyBody(const FlatAst& source, NodeIndex body)
+{
+    // The expressions whose children are being copied, innermost last, and the copies of their children.
+    struct Copy
+    {
+        NodeIndex source;
+        std::uint32_t next;
+        std::size_t first;
+        bool resolve;
+    };
+
+    std::vector<Copy> copies;
+    std::vector<NodeIndex> copied;
+
+    NodeIndex index = body;
+    bool resolve = true;
+
+    for(;;)
+    {
+        const NodeIndex* children = source.getChildren(index);
+        std::uint32_t count = source.getChildCount(index);
+
+        if(resolve && source.getOperator(index) == Operator::OP_CALL && count == 1
+           && findLocal(source.getSlot(children[0])) != noLocal)
+            copied.push_back(ast.addLocal(findLocal(source.getSlot(children[0]))));
+        else if(source.getType(index) == NodeType::NT_EXPRESSION && count != 0)
+            copies.push_back(Copy{index, 0, copied.size(), resolve});
+        else if(source.getType(index) == NodeType::NT_EXPRESSION)
+            copied.push_back(ast.addExpression(source.getOperator(index), nullptr, 0));
+        else if(source.getType(index) == NodeType::NT_IDENTIFIER)
+        {
+            std::uint32_t slot = resolve ? findLocal(source.getSlot(index)) : noLocal;
+            copied.push_back(slot != noLocal ? ast.addLocal(slot) : ast.addIdentifier(source.getSlot(index)));
+        }
+        else if(source.getType(index) == NodeType::NT_LOCAL)
+            copied.push_back(ast.addLocal(source.getSlot(index)));
+        else
+            copied.push_back(ast.addConstant(source.getLiteral(index)));
+
+        // The children come first in a flat AST : an expression is added once they are all copied.
+        while(!copies.empty() && copies.back().next == source.getChildCount(copies.back().source))
+        {
+            Copy complete = copies.back();
+            copies.pop_back();
+
+            NodeIndex expression = ast.addExpression(source.getOperator(complete.source), copied.data() + complete.first, copied.size() - complete.first);
+
+            copied.resize(complete.first);
+            copied.push_back(expression);
+        }
+
+        if(copies.empty())
+        {
+            ast.setRoot(copied.back());
+            return;
+        }
+
+        Copy& parent = copies.back();
+
+        index = source.getChildren(parent.source)[parent.next];
+        resolve = parent.resolve && resolves_child(source.getOperator(parent.source), parent.next);
+        ++parent.next;
+    }
+}
@@ -0,0 +1,93 @@
+/*
+	function.hpp
+
+	The MIT License (MIT)
+
+	Copyright (c) 2014 Maxime Alvarez
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+	Defines the user-defined functions.
+*/
+
+#ifndef FUNCTION_HPP_INCLUDED
+#define FUNCTION_HPP_INCLUDED
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "arena.hpp"
+#include "bytecode.hpp"
+#include "datatypes.hpp"
+#include "flat_ast.hpp"
+#include "memo_table.hpp"
+
+/// A function defined by (function name parameters... body), called by (name arguments...). Its locals are
+/// its parameters, then the variables assigned by its body : they live in the slots of a frame on the value
+/// stack of the runtime, so that a call allocates nothing. The other identifiers of the body are global
+/// variables. The functions defined by the body are global too, they do not see its locals.
+struct Function
+{
+    Function();
+
+    // Name, parameters, locals and effects of a definition, whose name and parameters have been checked to be identifiers.
+    void declare(NodeList definition);
+    void declare(const FlatAst& source, NodeIndex definition);
+
+    // Slot of a local in the frame, noLocal for a global variable.
+    std::uint32_t findLocal(Symbol symbol) const;
+
+    // Copy the body for the evaluators, its locals resolved to their slots. The copy lives as long as the
+    // function, the AST of its definition may not.
+    void copyBody(const Node* body, Arena& arena);
+    void copyBody(const FlatAst& source, NodeIndex body);
+
+    static const std::uint32_t noLocal = 0xFFFFFFFF;
+
+    // The virtual machine packs the number of arguments of a call with the symbol of the function.
+    static const std::uint32_t maxArguments = 255;
+
+    Symbol name;
+    std::uint32_t parameterCount;
+
+    // Symbols of the locals, the parameters first, for the error messages.
+    std::vector<Symbol> locals;
+    std::map<Symbol, std::uint32_t> slots;
+
+    // The body, for the virtual machine...
+    Bytecode bytecode;
+    // ... for the tree-walking evaluator, in the arena of the runtime...
+    Node* node;
+    // ... or for the flat evaluator, from its root.
+    FlatAst ast;
+
+    // Whether the body prints, reads the input, reads a global variable or defines a function, and the functions
+    // it calls. It is pure if it does none of these, nor do the functions it calls (see Runtime::memoTable).
+    bool sideEffects;
+    std::vector<Symbol> callees;
+
+    // Whether it is pure with the functions bound in the generation of bindings of the runtime it was checked in,
+    // and its results when memoized.
+    std::size_t bindings;
+    bool pure;
+    std::unique_ptr<MemoTable> memo;
+};
+
+#endif // FUNCTION_HPP_INCLUDED
@@ -0,0 +1,66 @@
+/*
+	hashing.hpp
+
+	The MIT License (MIT)
+
+	Copyright (c) 2014 Maxime Alvarez
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+	Defines the hash functions of the tables : FNV-1a, and the finalizer of MurmurHash3.
+*/
+
+#ifndef HASHING_HPP_INCLUDED
+#define HASHING_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+
+namespace hashing
+{
+    // FNV-1a starts from this basis and mixes the words in one at a time.
+    const std::uint32_t basis = 2166136261u;
+
+    inline std::uint32_t mix(std::uint32_t hash, std::uint32_t word)
+    {
+        return (hash ^ word) * 16777619u;
+    }
+
+    inline std::uint32_t mix(std::uint32_t hash, const char* data, std::size_t size)
+    {
+        for(std::size_t i(0) ; i < size ; ++i)
+            hash = mix(hash, static_cast<unsigned char>(data[i]));
+
+        return hash;
+    }
+
+    // The low bits of a FNV-1a hash only depend on the low bits of its words, zeros for the small integers :
+    // the high bits are mixed in for a table indexed by the low ones.
+    inline std::uint32_t finalize(std::uint32_t hash)
+    {
+        hash ^= hash >> 16;
+        hash *= 0x85EBCA6Bu;
+        hash ^= hash >> 13;
+        hash *= 0xC2B2AE35u;
+        hash ^= hash >> 16;
+
+        return hash;
+    }
+}
+
+#endif // HASHING_HPP_INCLUDED
@@ -0,0 +1,305 @@
+#include "incremental_parser.hpp"
+#include "errors.hpp"
+
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace
+{
+    // The replaced nodes are copied away once they outweigh the live ones by this many bytes.
+    const std::size_t minGarbageBytes = 1024 * 1024;
+}
+
+class IncrementalParser::FormRecorder : public FormSink
+{
+    public:
+        FormRecorder(std::vector<ParsedForm>& forms, std::size_t last)
+            : m_forms(forms)
+            , m_last(last)
+        {}
+
+        void open(std::size_t token, std::size_t child)
+        {
+            // Past the form parsed again, its tokens are not a single form anymore.
+            if(token > m_last)
+                errors::parserError("the form runs past its edited parentheses");
+
+            m_forms.push_back(ParsedForm{token, 0, m_opened.empty() ? NO_FORM : m_opened.back(), child, nullptr});
+            m_opened.push_back(m_forms.size() - 1);
+        }
+
+        void close(Node* node, std::size_t token)
+        {
+            if(token > m_last)
+                errors::parserError("the form runs past its edited parentheses");
+
+            ParsedForm& form = m_forms[m_opened.back()];
+            form.close = token;
+            form.node = node;
+
+            m_opened.pop_back();
+        }
+
+        static const std::size_t NO_FORM = ~std::size_t(0);
+
+    protected:
+        std::vector<ParsedForm>& m_forms;
+        std::size_t m_last;
+
+        std::vector<std::size_t> m_opened;
+};
+
+const std::size_t IncrementalParser::FormRecorder::NO_FORM;
+
+IncrementalParser::IncrementalParser(SymbolTable& symbols)
+    : m_lexer(nullptr, 0, symbols, Lexer::Mode::INCREMENTAL)
+    , m_size(0)
+    , m_arena(0)
+    , m_liveBytes(0)
+    , m_root(nullptr)
+    , m_relexedTokens(0)
+    , m_reparsedTokens(0)
+    , m_compactions(0)
+{}
+
+Node* IncrementalParser::parse(const std::string& source)
+{
+    m_root = nullptr;
+
+    return edit(0, m_size, source);
+}
+
+Node* IncrementalParser::edit(std::size_t offset, std::size_t removed, const std::string& text)
+{
+    if(offset > m_size || removed > m_size - offset)
+        throw std::out_of_range("the edit is out of the source");
+
+    Lexer::Splice splice = m_lexer.relex(offset, removed, text.data(), text.size());
+    m_size = m_size - removed + text.size();
+
+    m_relexedTokens = splice.inserted;
+    m_reparsedTokens = 0;
+
+    // Blanks and comments only.
+    if(splice.removed == 0 && splice.inserted == 0 && m_root)
+        return m_root;
+
+    if(!m_root)
+        return parseAll();
+
+    // Up to the outermost form when the edit broke the parentheses of the smaller ones.
+    for(std::uint32_t form = findEnclosingForm(splice.first) ; form != Lexer::NO_PAIR ; form = m_forms[form].parent)
+    {
+        if(m_lexer.getClose(form) == Lexer::NO_TOKEN || !reparse(form))
+            continue;
+
+        if(m_arenas[m_arena].getAllocatedBytes() > 2 * m_liveBytes + minGarbageBytes)
+            compact();
+
+        return m_root;
+    }
+
+    return parseAll();
+}
+
+Node* IncrementalParser::getRoot() const
+{
+    return m_root;
+}
+
+std::size_t IncrementalParser::getRelexedTokens() const
+{
+    return m_relexedTokens;
+}
+
+std::size_t IncrementalParser::getReparsedTokens() const
+{
+    return m_reparsedTokens;
+}
+
+std::size_t IncrementalParser::getCompactions() const
+{
+    return m_compactions;
+}
+
+std::uint32_t IncrementalParser::findEnclosingForm(std::size_t first) const
+{
+    // The closest parenthesis before the tokens : its form if it opens one, the enclosing one if it closes one.
+    // The forms around it enclose the tokens too, but those whose ')' was cut again.
+    std::uint32_t form = Lexer::NO_PAIR;
+
+    for(std::size_t token(first) ; token > 0 ; --token)
+    {
+        TokenType type = m_lexer.getType(token - 1);
+
+        if(type != TokenType::TT_LEFT_PAR && type != TokenType::TT_RIGHT_PAR)
+            continue;
+
+        // Past the end of the root, nothing is paired.
+        form = m_lexer.getPair(token - 1);
+
+        if(form != Lexer::NO_PAIR && type == TokenType::TT_RIGHT_PAR)
+            form = m_forms[form].parent;
+
+        break;
+    }
+
+    return form;
+}
+
+bool IncrementalParser::reparse(std::uint32_t pair)
+{
+    Form form = m_forms[pair];
+    std::size_t close = m_lexer.getClose(pair);
+
+    std::vector<ParsedForm> forms;
+    Node* node(nullptr);
+
+    try
+    {
+        m_lexer.seek(m_lexer.getOpen(pair));
+        node = parseForms(forms, close);
+    }
+    catch(errors::parser_exception&)
+    {
+        return false;
+    }
+
+    if(m_lexer.getPosition() != close + 1)
+        return false;
+
+    m_reparsedTokens = close + 1 - m_lexer.getOpen(pair);
+
+    pairForms(forms, form.parent, form.child);
+
+    if(form.parent == Lexer::NO_PAIR)
+        m_root = node;
+    else
+        m_forms[form.parent].node->setChild(form.child, node);
+
+    return true;
+}
+
+Node* IncrementalParser::parseAll()
+{
+    // Nothing is kept : the tree and its pairs go away before the parse, whether it fails or not.
+    m_root = nullptr;
+    m_forms.clear();
+    m_lexer.clearPairs();
+    m_arenas[m_arena].clear();
+
+    std::vector<ParsedForm> forms;
+
+    m_lexer.seek(0);
+    Node* root = parseForms(forms, std::numeric_limits<std::size_t>::max());
+
+    pairForms(forms, Lexer::NO_PAIR, 0);
+
+    m_root = root;
+    m_reparsedTokens = m_lexer.getPosition();
+    m_liveBytes = m_arenas[m_arena].getAllocatedBytes();
+
+    return m_root;
+}
+
+Node* IncrementalParser::parseForms(std::vector<ParsedForm>& forms, std::size_t last)
+{
+    FormRecorder recorder(forms, last);
+    Parser parser(m_lexer, m_arenas[m_arena]);
+
+    return parser.parse(recorder);
+}
+
+void IncrementalParser::pairForms(const std::vector<ParsedForm>& forms, std::uint32_t parent, std::uint32_t child)
+{
+    // The old forms in place of the new ones are those still paired by their parentheses, now inside the new ones.
+    for(const ParsedForm& form : forms)
+    {
+        std::uint32_t old = m_lexer.getPair(form.open);
+
+        if(old != Lexer::NO_PAIR)
+            m_lexer.unpair(old);
+
+        old = m_lexer.getPair(form.close);
+
+        if(old != Lexer::NO_PAIR)
+            m_lexer.unpair(old);
+    }
+
+    // In order of their opening, the enclosing form of each one is paired before it.
+    std::vector<std::uint32_t> pairs;
+    pairs.reserve(forms.size());
+
+    for(const ParsedForm& form : forms)
+    {
+        std::uint32_t pair = m_lexer.pair(form.open, form.close);
+
+        if(pair >= m_forms.size())
+            m_forms.resize(pair + 1);
+
+        if(form.parent == FormRecorder::NO_FORM)
+            m_forms[pair] = Form{parent, child, form.node};
+        else
+            m_forms[pair] = Form{pairs[form.parent], static_cast<std::uint32_t>(form.child), form.node};
+
+        pairs.push_back(pair);
+    }
+}
+
+void IncrementalParser::compact()
+{
+    Arena& arena = m_arenas[1 - m_arena];
+
+    // The forms follow their node in the copy.
+    std::unordered_map<const Node*, std::uint32_t> forms;
+
+    for(std::uint32_t pair(0) ; pair < m_forms.size() ; ++pair)
+    {
+        if(m_lexer.getOpen(pair) != Lexer::NO_TOKEN)
+            forms[m_forms[pair].node] = pair;
+    }
+
+    // Each node copied in the slot of the old one, from the root down.
+    Node* root = m_root;
+    std::vector<Node**> slots(1, &root);
+
+    while(!slots.empty())
+    {
+        Node** slot = slots.back();
+        slots.pop_back();
+
+        const Node* node = *slot;
+        Node* copy(nullptr);
+
+        if(node->getType() == NodeType::NT_CONST_VALUE && node->getValueType() == ValueType::VT_STRING)
+            copy = arena.create<Node>(arena, node->getText(), node->getTextLength(), node->hasEscapes());
+        else
+            copy = arena.create<Node>(*node);
+
+        NodeList children = node->getChildren();
+
+        if(!children.empty())
+        {
+            Node** copies = arena.copy(children.begin(), children.size());
+            copy->setChildren(copies, children.size());
+
+            for(std::size_t i(0) ; i < children.size() ; ++i)
+                slots.push_back(copies + i);
+        }
+
+        std::unordered_map<const Node*, std::uint32_t>::const_iterator form = forms.find(node);
+
+        if(form != forms.end())
+            m_forms[form->second].node = copy;
+
+        *slot = copy;
+    }
+
+    m_root = root;
+    m_arenas[m_arena].clear();
+    m_arena = 1 - m_arena;
+
+    m_liveBytes = arena.getAllocatedBytes();
+    ++m_compactions;
+}
@@ -0,0 +1,131 @@
+/*
+	incremental_parser.hpp
+
+	The MIT License (MIT)
+
+	Copyright (c) 2014 Maxime Alvarez
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+	Defines the front end re-lexing and re-parsing only around the edits of a source.
+*/
+
+#ifndef INCREMENTAL_PARSER_HPP_INCLUDED
+#define INCREMENTAL_PARSER_HPP_INCLUDED
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "arena.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "symbol_table.hpp"
+
+/// Keeps the tokens and the tree of a source between its edits. After an edit, only the tokens
+/// around it are cut again and only the smallest parenthesized form around them is parsed again :
+/// the other nodes are kept, the parents of the form see the new one in place of the old one.
+/// The forms are found from the pairs of parentheses of the lexer, which follow the edits without
+/// being moved : an edit costs what it changes and the form parsed again, not the whole source.
+class IncrementalParser
+{
+    public:
+        // The identifiers are interned in the symbols table.
+        IncrementalParser(SymbolTable& symbols);
+
+        // Lex and parse a whole new source, return the root.
+        Node* parse(const std::string& source);
+
+        // Replace the removed bytes at offset by the text, return the root. The nodes are valid until the
+        // next edit. On a parser error the exception goes through and the next edit parses the whole source again.
+        Node* edit(std::size_t offset, std::size_t removed, const std::string& text);
+
+        Node* getRoot() const;
+
+        // Tokens cut and parsed again by the last edit.
+        std::size_t getRelexedTokens() const;
+        std::size_t getReparsedTokens() const;
+
+        // Number of times the live nodes were copied away from the replaced ones.
+        std::size_t getCompactions() const;
+
+    protected:
+        // A form as parsed, before its parentheses are paired.
+        struct ParsedForm
+        {
+            std::size_t open;
+            std::size_t close;
+
+            // Index of the enclosing form in the parsed ones, of the node in its children.
+            std::size_t parent;
+            std::size_t child;
+
+            Node* node;
+        };
+
+        // Records the parsed forms, see parseForms().
+        class FormRecorder;
+
+        // A form of the tree, by the pair of its parentheses.
+        struct Form
+        {
+            // Pair of the enclosing form, Lexer::NO_PAIR for the outermost one, and index of the
+            // node of this one in the children of the enclosing one.
+            std::uint32_t parent;
+            std::uint32_t child;
+
+            Node* node;
+        };
+
+        // The smallest form opened before the token first and closed after the tokens cut again from it,
+        // NO_PAIR for none.
+        std::uint32_t findEnclosingForm(std::size_t first) const;
+
+        // Parse the form again and put it in place of the old one, return false if its tokens
+        // are not a single form anymore.
+        bool reparse(std::uint32_t pair);
+        Node* parseAll();
+
+        // Parse an expression from the current token, its forms closed at the token last at most.
+        Node* parseForms(std::vector<ParsedForm>& forms, std::size_t last);
+        // Pair the parsed forms in place of the old ones, the outermost one hanging from parent.
+        void pairForms(const std::vector<ParsedForm>& forms, std::uint32_t parent, std::uint32_t child);
+
+        // Copy the tree in the other arena, leaving the replaced nodes behind.
+        void compact();
+
+    protected:
+        Lexer m_lexer;
+        std::size_t m_size;
+
+        // The nodes are allocated in the current arena, the other one is empty.
+        Arena m_arenas[2];
+        std::size_t m_arena;
+        // Bytes of the current arena once the tree was last copied or parsed whole.
+        std::size_t m_liveBytes;
+
+        // By pair, see Lexer::pair().
+        std::vector<Form> m_forms;
+        Node* m_root;
+
+        std::size_t m_relexedTokens;
+        std::size_t m_reparsedTokens;
+        std::size_t m_compactions;
+};
+
+#endif // INCREMENTAL_PARSER_HPP_INCLUDED
@@ -1,246 +1,963 @@
 #include "lexer.hpp"
 #include "errors.hpp"
+#include "scan.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <thread>
 
 namespace
 {
-	// Return true if the given char is in the given std::string.
-	bool is_in_string(std::string str, char c)
-	{
-		return str.find(c) != std::string::npos;
-	}
-
-	// Return true if the given word is an operator.
-	bool is_operator(const std::string& word)
-	{
-		return operatorsTable.find(word) != operatorsTable.end();
-	}
-
-    // Return true if the given word is a keyword.
-	bool is_keyword(const std::string& word)
-	{
-		return keywordsTable.find(word) != keywordsTable.end();
-	}
-
-	// Return true if the given char is a bracket.
-	bool is_bracket(char c)
-	{
-		return is_in_string("()", c);
-	}
-
-	// Return true if the given char is a whitespace.
-	bool is_whitespace(char c)
-	{
-		return is_in_string("\t\r\f\n ", c);
-	}
-
-	// Return true if the given char is a delimiter.
-	bool is_delimiter(char c)
-	{
-	    return is_whitespace(c) || is_bracket(c);
-	}
-
-	// Return true if the given char is a digit.
-	bool is_digit(char c)
-	{
-		return is_in_string("0123456789", c);
-	}
-
-	// Return true if the given char is alpha.
-	bool is_alpha(char c)
-	{
-	    c = std::toupper(c);
-	    return is_in_string("ABCDEFGHIJKLMNOPQRSTUVWXYZ", c);
-	}
-
-	// Return true if the given char is alpha or digit.
-	bool is_alphanum(char c)
-	{
-        return is_digit(c) || is_alpha(c);
-	}
-}
-
-Lexer::Lexer(std::string input)
-    : m_input(input)
+    /** Tables generated at compile time, indexed by 0 to N - 1. */
+    template<std::size_t... Indices>
+    struct IndexList
+    {};
+
+    template<std::size_t N, std::size_t... Indices>
+    struct MakeIndexList : MakeIndexList<N - 1, N - 1, Indices...>
+    {};
+
+    template<std::size_t... Indices>
+    struct MakeIndexList<0, Indices...>
+    {
+        typedef IndexList<Indices...> Type;
+    };
+
+    template<typename T, std::size_t N>
+    struct Table
+    {
+        T entries[N];
+    };
+
+    // Class of a character, the lexer only looks at this.
+    enum CharClass : std::uint8_t
+    {
+        CC_OTHER,
+        CC_WHITESPACE,
+        CC_LEFT_PAR,
+        CC_RIGHT_PAR,
+        CC_QUOTE,
+        CC_COMMENT,
+        CC_DIGIT
+    };
+
+    constexpr CharClass char_class(std::size_t c)
+    {
+        return (c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r' || c == ' ') ? CC_WHITESPACE
+             : (c >= '0' && c <= '9') ? CC_DIGIT
+             : c == '(' ? CC_LEFT_PAR
+             : c == ')' ? CC_RIGHT_PAR
+             : c == '"' ? CC_QUOTE
+             : c == '#' ? CC_COMMENT
+             : CC_OTHER;
+    }
+
+    template<std::size_t... Indices>
+    constexpr Table<CharClass, 256> make_char_classes(IndexList<Indices...>)
+    {
+        return Table<CharClass, 256>{{char_class(Indices)...}};
+    }
+
+    // 256 entries table indexed by the unsigned value of a character.
+    constexpr Table<CharClass, 256> charClasses = make_char_classes(MakeIndexList<256>::Type());
+
+    inline CharClass class_of(char c)
+    {
+        return charClasses.entries[static_cast<unsigned char>(c)];
+    }
+
+    // Return true if the given char ends an identifier, an operator or a keyword.
+    bool is_delimiter(char c)
+    {
+        CharClass charClass = class_of(c);
+        return charClass == CC_WHITESPACE || charClass == CC_LEFT_PAR || charClass == CC_RIGHT_PAR || charClass == CC_COMMENT;
+    }
+
+    constexpr std::size_t length_of(const char* word)
+    {
+        return *word ? 1 + length_of(word + 1) : 0;
+    }
+
+    // The words which are not identifiers : the operators and the keywords.
+    struct Keyword
+    {
+        constexpr Keyword(const char* text, TokenType tokenType, Operator oper = Operator::OP_NONE)
+            : word(text), length(length_of(text)), type(tokenType), op(oper)
+        {}
+
+        const char* word;
+        std::size_t length;
+
+        TokenType type;
+        Operator op;
+    };
+
+    constexpr Keyword keywords[] =
+    {
+        /** Special built-in operators. */
+        {"program", TokenType::TT_OPERATOR, Operator::OP_PROGRAM},
+        {"assign", TokenType::TT_OPERATOR, Operator::OP_ASSIGN},
+        {"to_numeric", TokenType::TT_OPERATOR, Operator::OP_TO_NUMERIC},
+        {"to_string", TokenType::TT_OPERATOR, Operator::OP_TO_STRING},
+        {"print", TokenType::TT_OPERATOR, Operator::OP_PRINT},
+        {"input", TokenType::TT_OPERATOR, Operator::OP_INPUT},
+        {"if", TokenType::TT_OPERATOR, Operator::OP_IF},
+
+        /** Maths built-in operators. */
+        {"+", TokenType::TT_OPERATOR, Operator::OP_ADD},
+        {"-", TokenType::TT_OPERATOR, Operator::OP_SUB},
+        {"*", TokenType::TT_OPERATOR, Operator::OP_MUL},
+        {"/", TokenType::TT_OPERATOR, Operator::OP_DIV},
+        {"%", TokenType::TT_OPERATOR, Operator::OP_MOD},
+        {"^", TokenType::TT_OPERATOR, Operator::OP_POW},
+        {"sin", TokenType::TT_OPERATOR, Operator::OP_SIN},
+        {"cos", TokenType::TT_OPERATOR, Operator::OP_COS},
+        {"tan", TokenType::TT_OPERATOR, Operator::OP_TAN},
+        {"acos", TokenType::TT_OPERATOR, Operator::OP_ACOS},
+        {"asin", TokenType::TT_OPERATOR, Operator::OP_ASIN},
+        {"atan", TokenType::TT_OPERATOR, Operator::OP_ATAN},
+        {"to_rad", TokenType::TT_OPERATOR, Operator::OP_TO_RAD},
+        {"to_deg", TokenType::TT_OPERATOR, Operator::OP_TO_DEG},
+        {"ln", TokenType::TT_OPERATOR, Operator::OP_LN},
+        {"exp", TokenType::TT_OPERATOR, Operator::OP_EXP},
+        {"log10", TokenType::TT_OPERATOR, Operator::OP_LOG10},
+
+        /** Keywords. */
+        {"null", TokenType::TT_NULL},
+        {"function", TokenType::TT_FUNCTION}
+    };
+
+    constexpr std::size_t keywordCount = sizeof(keywords) / sizeof(keywords[0]);
+
+    // Perfect hash of the keywords : the constants were searched so that no two keywords
+    // share a slot. Adding a keyword may need a new search, the static_assert below tells.
+    constexpr std::size_t keywordSlotCount = 64;
+
+    constexpr std::size_t keyword_hash(const char* word, std::size_t length)
+    {
+        return (static_cast<unsigned char>(word[0])
+              + static_cast<unsigned char>(word[length > 1 ? 1 : 0]) * 14
+              + static_cast<unsigned char>(word[length - 1]) * 5
+              + length) % keywordSlotCount;
+    }
+
+    constexpr std::size_t keyword_slot(std::size_t index)
+    {
+        return keyword_hash(keywords[index].word, keywords[index].length);
+    }
+
+    // Number of keywords before index sharing the slot of the keyword at index.
+    constexpr std::size_t collisions(std::size_t index, std::size_t other = 0)
+    {
+        return other >= index ? 0 : (keyword_slot(other) == keyword_slot(index)) + collisions(index, other + 1);
+    }
+
+    constexpr std::size_t all_collisions(std::size_t index = 0)
+    {
+        return index >= keywordCount ? 0 : collisions(index) + all_collisions(index + 1);
+    }
+
+    static_assert(all_collisions() == 0, "the keywords hash is not perfect anymore, search new constants");
+
+    // Index + 1 of the keyword in the slot, 0 for an empty slot.
+    constexpr std::uint8_t keyword_in_slot(std::size_t slot, std::size_t index = 0)
+    {
+        return index >= keywordCount ? 0
+             : keyword_slot(index) == slot ? static_cast<std::uint8_t>(index + 1)
+             : keyword_in_slot(slot, index + 1);
+    }
+
+    template<std::size_t... Indices>
+    constexpr Table<std::uint8_t, keywordSlotCount> make_keyword_slots(IndexList<Indices...>)
+    {
+        return Table<std::uint8_t, keywordSlotCount>{{keyword_in_slot(Indices)...}};
+    }
+
+    constexpr Table<std::uint8_t, keywordSlotCount> keywordSlots = make_keyword_slots(MakeIndexList<keywordSlotCount>::Type());
+
+    // Return the keyword spelled by the word, nullptr for an identifier.
+    const Keyword* find_keyword(const char* word, std::size_t length)
+    {
+        std::uint8_t slot = keywordSlots.entries[keyword_hash(word, length)];
+
+        if(slot == 0)
+            return nullptr;
+
+        const Keyword& keyword = keywords[slot - 1];
+
+        if(keyword.length != length || std::memcmp(keyword.word, word, length) != 0)
+            return nullptr;
+
+        return &keyword;
+    }
+
+    // Whether the quote opens a string. Identifiers run until a delimiter, quotes included,
+    // but a number stops at the first character which is neither a digit nor a dot.
+    // The token containing the quote starts after floor, a position between two tokens.
+    bool opens_string(const char* quote, const char* floor)
+    {
+        const char* begin = quote;
+
+        while(begin != floor && !is_delimiter(begin[-1]))
+            --begin;
+
+        if(begin == quote)
+            return true;
+
+        if(class_of(*begin) != CC_DIGIT)
+            return false;
+
+        for( ; begin != quote ; ++begin)
+        {
+            if(class_of(*begin) != CC_DIGIT && *begin != '.')
+                return false;
+        }
+
+        return true;
+    }
+
+    // Position after the closing quote of the string starting at cursor, escape sequences skipped.
+    const char* skip_string(const char* cursor, const char* end)
+    {
+        cursor = scan::findStringEnd(cursor, end);
+
+        while(cursor != end && *cursor == '\\')
+        {
+            if(end - cursor <= 2)
+                return end;
+
+            cursor = scan::findStringEnd(cursor + 2, end);
+        }
+
+        return cursor == end ? end : cursor + 1;
+    }
+
+    // Call task(i) for each i in [0, count[ on its own thread, the calling thread taking the first.
+    template<typename Task>
+    void run_in_parallel(std::size_t count, const Task& task)
+    {
+        std::vector<std::thread> workers;
+        workers.reserve(count);
+
+        for(std::size_t i(1) ; i < count ; ++i)
+            workers.emplace_back(task, i);
+
+        task(0);
+
+        for(std::thread& worker : workers)
+            worker.join();
+    }
+
+    // Token index of a pair end counted from the end of the tokens, see Lexer::encode().
+    const std::uint32_t fromEnd = 0x80000000u;
+    // Pair end whose token was removed.
+    const std::uint32_t noEnd = 0xFFFFFFFFu;
+
+    bool is_parenthesis(TokenType type)
+    {
+        return type == TokenType::TT_LEFT_PAR || type == TokenType::TT_RIGHT_PAR;
+    }
+}
+
+const std::uint32_t Lexer::NO_PAIR;
+const std::size_t Lexer::NO_TOKEN;
+
+Lexer::Lexer(const char* source, std::size_t size, SymbolTable& symbols, Mode mode)
+    : m_source(source)
+    , m_size(size)
+    , m_cursor(source)
+    , m_symbols(symbols)
+    , m_mode(mode)
+    , m_threads(1)
     , m_currentTokenIndex(0)
+    , m_start(0)
+    , m_textGap(0)
+    , m_textGapSize(0)
+    , m_tokenGap(0)
+    , m_tokenGapSize(0)
 {}
 
 void Lexer::lex()
 {
-    Token current_token(TokenType::TT_NONE, "");
-    bool is_token_complete(false), is_numeric(false), is_identifier(false), is_string(false), is_string_escaped(false);
+    if(m_mode == Mode::PULL)
+    {
+        // Only the first token, the next ones are cut on demand.
+        if(!scan(m_look))
+            m_look = Token();
 
-    for(std::size_t i(0) ; i < m_input.size() ; ++i)
+        return;
+    }
+
+    if(m_mode == Mode::INCREMENTAL)
     {
-        char current_char(m_input.at(i));
+        // The source is copied in the gap buffer, it can go away afterwards.
+        const char* source = m_source;
+        std::size_t size = m_size;
 
-        // First of all : check for comments and skip them.
-        if(current_char == '#' && !is_string)
-        {
-            while(current_char != '\n' && i < m_input.size())
-            {
-                ++i;
-                current_char = m_input.at(i);
-            }
-        }
+        m_size = 0;
+        relex(0, 0, source, size);
+        return;
+    }
+
+    // Chunks below a megabyte do not pay for their thread.
+    std::size_t chunks = std::min(m_threads, m_size >> 20);
+
+    if(chunks >= 2)
+        lexChunks(chunks);
+    else
+    {
+        // Generated and hand written sources average more than two bytes per token,
+        // reserving avoids moving the tokens over and over while the list grows.
+        m_tokens.reserve(m_size / 2);
+
+        Token token;
+        while(scan(token))
+            m_tokens.push_back(token);
+    }
+
+    #ifdef DEBUG_LEXER
+    for(Token t : m_tokens)
+        std::cout << "\ttype: " << string_utils::from(t.type) << std::endl;
+    #endif // DEBUG_LEXER
+}
+
+void Lexer::setThreads(std::size_t threads)
+{
+    m_threads = std::max<std::size_t>(threads, 1);
+}
+
+std::vector<std::size_t> Lexer::findChunkBounds(std::size_t count) const
+{
+    std::vector<std::size_t> bounds(1, 0);
+
+    const char* end = m_source + m_size;
+    const char* cursor = m_source;
+    const char* floor = m_source;
+
+    // A single pass following the strings and comments, jumping to the next quote or '#' until
+    // the ideal cut, then to the first whitespace after it.
+    for(std::size_t i(1) ; i < count ; ++i)
+    {
+        const char* target = m_source + m_size / count * i;
 
-        // No current token, let's see what type it is.
-        if(current_token.value.empty() && !is_numeric && !is_identifier && !is_string)
+        for(;;)
         {
-            if(std::isdigit(current_char))
-            {
-                is_numeric = true;
-                current_token.value += current_char;
-                current_token.type = TokenType::TT_NUMERIC;
-            }
-            else if(is_whitespace(current_char))
+            if(cursor < target)
+                cursor = scan::findStringOrComment(cursor, target);
+
+            if(cursor >= target)
             {
-                // Do nothing.
+                while(cursor != end && class_of(*cursor) != CC_WHITESPACE && class_of(*cursor) != CC_QUOTE && class_of(*cursor) != CC_COMMENT)
+                    ++cursor;
             }
+
+            if(cursor == end || class_of(*cursor) == CC_WHITESPACE)
+                break;
+
+            if(class_of(*cursor) == CC_COMMENT)
+                floor = cursor = scan::findLineEnd(cursor, end);
+            else if(opens_string(cursor, floor))
+                floor = cursor = skip_string(cursor + 1, end);
             else
-            {
-                switch(current_char)
-                {
-                    case '(':
-                        current_token.value = "(";
-                        current_token.type = TokenType::TT_LEFT_PAR;
+                ++cursor;
+        }
 
-                        is_token_complete = true;
-                        break;
-                    case ')':
-                        current_token.value = ")";
-                        current_token.type = TokenType::TT_RIGHT_PAR;
+        if(cursor == end)
+            break;
 
-                        is_token_complete = true;
-                        break;
-                    case '"':
-                        current_token.value = "";
-                        current_token.type = TokenType::TT_STRING;
+        bounds.push_back(static_cast<std::size_t>(cursor - m_source));
+    }
 
-                        is_string = true;
-                        break;
-                    default:
-                        is_identifier = true;
-                        current_token.value += current_char;
-                        current_token.type = TokenType::TT_IDENTIFIER;
-                        break;
-                }
-            }
-        }
-        // We are in string so we catch everything.
-        else if(is_string)
+    bounds.push_back(m_size);
+    return bounds;
+}
+
+void Lexer::lexChunks(std::size_t count)
+{
+    std::vector<std::size_t> bounds = findChunkBounds(count);
+    count = bounds.size() - 1;
+
+    // The symbols table is not shared between threads : the first chunk interns in it
+    // and the other ones in their own table.
+    std::vector<SymbolTable> symbols(count);
+    std::vector<Lexer> chunks;
+    chunks.reserve(count);
+
+    for(std::size_t i(0) ; i < count ; ++i)
+        chunks.emplace_back(m_source + bounds[i], bounds[i + 1] - bounds[i], i == 0 ? m_symbols : symbols[i]);
+
+    // The first chunk lexes in place : its tokens are the beginning of the list, with room for the others.
+    chunks[0].m_tokens.reserve(m_size / 2);
+
+    run_in_parallel(count, [&chunks](std::size_t i)
+    {
+        chunks[i].lex();
+    });
+
+    m_tokens.swap(chunks[0].m_tokens);
+
+    // Interning the symbols of the next chunks in order numbers them in order of appearance,
+    // as a single thread would have.
+    std::vector<std::vector<Symbol>> renumbering(count);
+    std::vector<std::size_t> firstTokens(count + 1, m_tokens.size());
+
+    for(std::size_t i(1) ; i < count ; ++i)
+    {
+        for(Symbol symbol(0) ; symbol < symbols[i].size() ; ++symbol)
         {
-            if(current_char == '"' && !is_string_escaped)
-                is_token_complete = true;
-            else if(current_char == '\\' && !is_string_escaped)
-                is_string_escaped = true;
-            else
-            {
-                if(is_string_escaped)
-                {
-                    switch(current_char)
-                    {
-                        case '"':
-                            current_token.value += '"';
-                            break;
-                        case 'n':
-                            current_token.value += '\n';
-                            break;
-                        case 't':
-                            current_token.value += '\t';
-                            break;
-                        case 'r':
-                            current_token.value += '\r';
-                            break;
-                        case 'f':
-                            current_token.value += '\f';
-                            break;
-                        case 'v':
-                            current_token.value += '\v';
-                            break;
-                        default:
-                            current_token.value += current_char;
-                            break;
-                    }
-
-                    is_string_escaped = false;
-                }
-                else
-                    current_token.value += current_char;
-            }
+            const std::string& name = symbols[i].getName(symbol);
+            renumbering[i].push_back(m_symbols.intern(name.data(), name.size()));
         }
-        // Random character except whitespaces and brackets.
-        else if(!is_whitespace(current_char) && !is_bracket(current_char))
+
+        firstTokens[i + 1] = firstTokens[i] + chunks[i].m_tokens.size();
+    }
+
+    m_tokens.resize(firstTokens[count]);
+
+    // Stitch the next chunks in order, the offsets and symbols rebased on the whole source.
+    run_in_parallel(count - 1, [this, &chunks, &bounds, &renumbering, &firstTokens](std::size_t next)
+    {
+        std::size_t i = next + 1;
+        const Lexer& chunk = chunks[i];
+        Token* output = &m_tokens[firstTokens[i]];
+
+        for(Token token : chunk.m_tokens)
         {
-            // If parsing a numeric and get something else than digit or dot.
-            if(is_numeric && !is_digit(current_char) && current_char != '.')
-            {
-                is_token_complete = true;
-                --i;
-            }
+            if(token.type == TokenType::TT_IDENTIFIER)
+                token.symbol = renumbering[i][token.symbol];
             else
-            {
-                current_token.value += current_char;
-            }
+                token.offset += static_cast<std::uint32_t>(bounds[i]);
+
+            *output++ = token;
         }
-        // Brackets while we are parsing a numeric/identifier.
-        else if(is_bracket(current_char))
+    });
+}
+
+Lexer::Splice Lexer::relex(std::size_t offset, std::size_t removed, const char* text, std::size_t inserted)
+{
+    // The last token starting before the edit may run into it, the ones before end earlier.
+    std::size_t first(0), last(getTokenCount());
+
+    while(first < last)
+    {
+        std::size_t middle = first + (last - first) / 2;
+
+        if(getStart(middle) < offset)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+
+    std::size_t restart(0);
+
+    if(first > 0)
+        restart = getStart(--first);
+
+    // The tokens from the first one are the old ones after the gap, ahead of the new ones.
+    moveTokenGap(first);
+
+    moveTextGap(offset);
+    m_textGapSize += removed;
+    reserveTextGap(inserted);
+
+    std::copy(text, text + inserted, m_text.begin() + static_cast<std::ptrdiff_t>(m_textGap));
+    m_textGap += inserted;
+    m_textGapSize -= inserted;
+
+    // scan() stops at the gap : the text after it is brought before as the tokens run into it.
+    std::size_t size = m_size - removed + inserted;
+
+    m_source = m_text.data();
+    m_size = m_textGap;
+    m_cursor = m_source + restart;
+
+    std::vector<Token> tokens;
+    std::vector<std::uint32_t> positions;
+
+    // A whole new source, see lex().
+    if(m_tokens.empty())
+    {
+        tokens.reserve(size / 2);
+        positions.reserve(size / 2);
+    }
+
+    std::size_t old = m_tokenGap + m_tokenGapSize;
+    bool converged = false;
+
+    Token token;
+    for(;;)
+    {
+        const char* resume = m_cursor;
+        bool found = scan(token);
+
+        // Cut short by the gap : twice as much text before it, then the same token or blank again.
+        if(m_size < size && m_cursor == m_source + m_size)
         {
-            is_token_complete = true;
-            --i;
+            moveTextGap(std::min(size, m_size + std::max<std::size_t>(m_size - restart, 256)));
+
+            m_size = m_textGap;
+            m_cursor = resume;
+            continue;
         }
-        // Whitespace.
-        else
+
+        if(!found)
+            break;
+
+        // Past the edit, the lexing is the same as before from a place where a token started before.
+        // Counted from the end, the old and new positions of the text after the edit are the same.
+        if(m_start >= offset + inserted)
         {
-            is_token_complete = true;
+            std::uint32_t position = static_cast<std::uint32_t>(size - m_start);
+
+            while(old < m_tokens.size() && m_positions[old] > position)
+                ++old;
+
+            if(old < m_tokens.size() && m_positions[old] == position)
+            {
+                converged = true;
+                break;
+            }
         }
 
-        // Push token and reset flags if complete.
-        if(is_token_complete)
+        if(is_parenthesis(token.type))
+            token.offset = NO_PAIR;
+
+        tokens.push_back(token);
+        positions.push_back(m_start);
+    }
+
+    // The old tokens up to the meeting point are cut again, the gap grows over them.
+    std::size_t gapEnd = m_tokenGap + m_tokenGapSize;
+
+    if(!converged)
+        old = m_tokens.size();
+
+    for(std::size_t slot(gapEnd) ; slot < old ; ++slot)
+        unlink(slot);
+
+    m_tokenGapSize += old - gapEnd;
+    m_size = size;
+
+    Splice splice;
+    splice.first = first;
+    splice.removed = old - gapEnd;
+    splice.inserted = tokens.size();
+
+    if(m_tokens.empty())
+    {
+        m_tokens.swap(tokens);
+        m_positions.swap(positions);
+
+        m_tokenGap = m_tokens.size();
+    }
+    else
+    {
+        reserveTokenGap(tokens.size());
+
+        std::copy(tokens.begin(), tokens.end(), m_tokens.begin() + static_cast<std::ptrdiff_t>(m_tokenGap));
+        std::copy(positions.begin(), positions.end(), m_positions.begin() + static_cast<std::ptrdiff_t>(m_tokenGap));
+
+        m_tokenGap += tokens.size();
+        m_tokenGapSize -= tokens.size();
+    }
+
+    // The text gap goes back to where the first token after the tokens gap starts.
+    if(m_tokenGap < getTokenCount())
+        moveTextGap(getStart(m_tokenGap));
+    else
+        moveTextGap(m_size);
+
+    m_source = m_text.data();
+    return splice;
+}
+
+std::uint32_t Lexer::pair(std::size_t open, std::size_t close)
+{
+    std::uint32_t pair;
+
+    if(m_freePairs.empty())
+    {
+        pair = static_cast<std::uint32_t>(m_pairs.size() / 2);
+        m_pairs.resize(m_pairs.size() + 2);
+    }
+    else
+    {
+        pair = m_freePairs.back();
+        m_freePairs.pop_back();
+    }
+
+    m_tokens[getSlot(open)].offset = pair;
+    m_tokens[getSlot(close)].offset = pair;
+
+    m_pairs[2 * pair] = encode(open);
+    m_pairs[2 * pair + 1] = encode(close);
+
+    return pair;
+}
+
+void Lexer::unpair(std::uint32_t pair)
+{
+    for(std::size_t end(2 * pair) ; end < 2 * pair + 2 ; ++end)
+    {
+        if(m_pairs[end] != noEnd)
+            m_tokens[getSlot(decode(m_pairs[end]))].offset = NO_PAIR;
+
+        m_pairs[end] = noEnd;
+    }
+
+    m_freePairs.push_back(pair);
+}
+
+void Lexer::clearPairs()
+{
+    for(std::size_t end(0) ; end < m_pairs.size() ; ++end)
+    {
+        if(m_pairs[end] != noEnd)
+            m_tokens[getSlot(decode(m_pairs[end]))].offset = NO_PAIR;
+    }
+
+    m_pairs.clear();
+    m_freePairs.clear();
+}
+
+std::uint32_t Lexer::getPair(std::size_t token) const
+{
+    const Token& stored = m_tokens[getSlot(token)];
+    return is_parenthesis(stored.type) ? stored.offset : NO_PAIR;
+}
+
+std::size_t Lexer::getOpen(std::uint32_t pair) const
+{
+    return decode(m_pairs[2 * pair]);
+}
+
+std::size_t Lexer::getClose(std::uint32_t pair) const
+{
+    return decode(m_pairs[2 * pair + 1]);
+}
+
+TokenType Lexer::getType(std::size_t token) const
+{
+    return m_tokens[getSlot(token)].type;
+}
+
+std::size_t Lexer::getTokenCount() const
+{
+    return m_tokens.size() - m_tokenGapSize;
+}
+
+std::size_t Lexer::getSlot(std::size_t token) const
+{
+    return token < m_tokenGap ? token : token + m_tokenGapSize;
+}
+
+std::size_t Lexer::getStart(std::size_t token) const
+{
+    return token < m_tokenGap ? m_positions[token] : m_size - m_positions[token + m_tokenGapSize];
+}
+
+void Lexer::moveTextGap(std::size_t position)
+{
+    std::vector<char>::iterator text = m_text.begin();
+    std::ptrdiff_t gap = static_cast<std::ptrdiff_t>(m_textGap);
+    std::ptrdiff_t gapSize = static_cast<std::ptrdiff_t>(m_textGapSize);
+    std::ptrdiff_t target = static_cast<std::ptrdiff_t>(position);
+
+    if(target < gap)
+        std::copy_backward(text + target, text + gap, text + gap + gapSize);
+    else
+        std::copy(text + gap + gapSize, text + target + gapSize, text + gap);
+
+    m_textGap = position;
+}
+
+void Lexer::reserveTextGap(std::size_t size)
+{
+    if(m_textGapSize >= size)
+        return;
+
+    // Growing by half of the text at least, so that the copies are paid by the bytes inserted.
+    std::size_t length = m_text.size() - m_textGapSize;
+    std::vector<char> text(length + size + (length + size) / 2 + 4096);
+
+    std::vector<char>::iterator after = m_text.begin() + static_cast<std::ptrdiff_t>(m_textGap + m_textGapSize);
+
+    std::copy(m_text.begin(), m_text.begin() + static_cast<std::ptrdiff_t>(m_textGap), text.begin());
+    std::copy_backward(after, m_text.end(), text.end());
+
+    m_textGapSize = text.size() - length;
+    m_text.swap(text);
+}
+
+void Lexer::moveTokenGap(std::size_t token)
+{
+    // The positions and the pair ends are counted from the end after the gap, they change on each side.
+    std::size_t count = getTokenCount();
+
+    while(m_tokenGap > token)
+    {
+        std::size_t moved = --m_tokenGap;
+        std::size_t slot = moved + m_tokenGapSize;
+
+        m_tokens[slot] = m_tokens[moved];
+        m_positions[slot] = static_cast<std::uint32_t>(m_size - m_positions[moved]);
+        relink(slot, fromEnd | static_cast<std::uint32_t>(count - moved));
+    }
+
+    while(m_tokenGap < token)
+    {
+        std::size_t moved = m_tokenGap++;
+        std::size_t slot = moved + m_tokenGapSize;
+
+        m_tokens[moved] = m_tokens[slot];
+        m_positions[moved] = static_cast<std::uint32_t>(m_size - m_positions[slot]);
+        relink(moved, static_cast<std::uint32_t>(moved));
+    }
+}
+
+void Lexer::reserveTokenGap(std::size_t count)
+{
+    if(m_tokenGapSize >= count)
+        return;
+
+    std::size_t length = getTokenCount();
+    std::size_t size = length + count + (length + count) / 2 + 256;
+    std::ptrdiff_t gap = static_cast<std::ptrdiff_t>(m_tokenGap);
+    std::ptrdiff_t gapEnd = static_cast<std::ptrdiff_t>(m_tokenGap + m_tokenGapSize);
+
+    std::vector<Token> tokens(size);
+    std::copy(m_tokens.begin(), m_tokens.begin() + gap, tokens.begin());
+    std::copy_backward(m_tokens.begin() + gapEnd, m_tokens.end(), tokens.end());
+
+    std::vector<std::uint32_t> positions(size);
+    std::copy(m_positions.begin(), m_positions.begin() + gap, positions.begin());
+    std::copy_backward(m_positions.begin() + gapEnd, m_positions.end(), positions.end());
+
+    m_tokenGapSize = size - length;
+    m_tokens.swap(tokens);
+    m_positions.swap(positions);
+}
+
+void Lexer::relink(std::size_t slot, std::uint32_t index)
+{
+    const Token& token = m_tokens[slot];
+
+    if(is_parenthesis(token.type) && token.offset != NO_PAIR)
+        m_pairs[2 * token.offset + (token.type == TokenType::TT_RIGHT_PAR ? 1 : 0)] = index;
+}
+
+void Lexer::unlink(std::size_t slot)
+{
+    const Token& token = m_tokens[slot];
+
+    if(!is_parenthesis(token.type) || token.offset == NO_PAIR)
+        return;
+
+    // Without any of its tokens, the pair is free again.
+    std::size_t end = 2 * token.offset + (token.type == TokenType::TT_RIGHT_PAR ? 1 : 0);
+    m_pairs[end] = noEnd;
+
+    if(m_pairs[end ^ 1] == noEnd)
+        m_freePairs.push_back(token.offset);
+}
+
+std::uint32_t Lexer::encode(std::size_t token) const
+{
+    return token < m_tokenGap ? static_cast<std::uint32_t>(token) : fromEnd | static_cast<std::uint32_t>(getTokenCount() - token);
+}
+
+std::size_t Lexer::decode(std::uint32_t index) const
+{
+    if(index == noEnd)
+        return NO_TOKEN;
+
+    return (index & fromEnd) ? getTokenCount() - (index & ~fromEnd) : index;
+}
+
+void Lexer::load()
+{
+    if(m_currentTokenIndex >= getTokenCount())
+    {
+        m_look = Token();
+        return;
+    }
+
+    m_look = m_tokens[getSlot(m_currentTokenIndex)];
+
+    if(m_look.type == TokenType::TT_IDENTIFIER)
+        return;
+
+    // The text of the token is before or after the text gap, whole.
+    std::size_t start = getStart(m_currentTokenIndex);
+
+    if(start >= m_textGap)
+        start += m_textGapSize;
+
+    m_look.offset = static_cast<std::uint32_t>(m_look.type == TokenType::TT_STRING ? start + 1 : start);
+}
+
+std::size_t Lexer::getPosition() const
+{
+    return m_currentTokenIndex;
+}
+
+void Lexer::seek(std::size_t position)
+{
+    m_currentTokenIndex = position;
+
+    if(m_mode == Mode::INCREMENTAL)
+        load();
+}
+
+bool Lexer::scan(Token& token)
+{
+    const char* source = m_source;
+    const char* cursor = m_cursor;
+    const char* end = source + m_size;
+
+    // Each iteration starts between two tokens, skips a blank or consumes one token entirely.
+    while(cursor != end)
+    {
+        std::uint32_t offset = static_cast<std::uint32_t>(cursor - source);
+        m_start = offset;
+
+        switch(class_of(*cursor))
         {
-            // Do not trim strings.
-            if(current_token.type != TokenType::TT_STRING)
-                current_token.value = string_utils::trim(current_token.value);
+            case CC_WHITESPACE:
+                // Most runs are a single space, the vector scan pays off on indentation.
+                if(++cursor != end && class_of(*cursor) == CC_WHITESPACE)
+                    cursor = scan::skipWhitespace(cursor, end);
+                break;
+            case CC_COMMENT:
+                // Skip until the end of the line, whether it ends with LF, CR or CRLF.
+                cursor = scan::findLineEnd(cursor, end);
+                break;
+            case CC_LEFT_PAR:
+                token = Token(TokenType::TT_LEFT_PAR, offset, 1);
+                m_cursor = cursor + 1;
+                return true;
+            case CC_RIGHT_PAR:
+                token = Token(TokenType::TT_RIGHT_PAR, offset, 1);
+                m_cursor = cursor + 1;
+                return true;
+            case CC_QUOTE:
+            {
+                // Everything is caught until the closing quote, escape sequences included. They are
+                // left as they are, the runtime decodes the strings which are used.
+                const char* begin = ++cursor;
+                cursor = scan::findStringEnd(cursor, end);
+                bool escaped = false;
 
-            // To tell difference between operators and identifiers.
-            if(current_token.type == TokenType::TT_IDENTIFIER && is_operator(current_token.value))
-                current_token.type = TokenType::TT_OPERATOR;
+                // The cursor is on a backslash at each iteration, the character after it is skipped.
+                while(cursor != end && *cursor != '"')
+                {
+                    escaped = true;
 
-            // To tell difference between keywords (non-operators) and identifiers.
-            if(current_token.type == TokenType::TT_IDENTIFIER && is_keyword(current_token.value))
-                current_token.type = keywordsTable.at(current_token.value);
+                    if(++cursor == end)
+                        break;
 
-            if(!current_token.value.empty())
-                m_tokens.push_back(current_token);
+                    cursor = scan::findStringEnd(cursor + 1, end);
+                }
 
-            current_token.value = "";
-            current_token.type = TokenType::TT_NONE;
-            is_token_complete = is_numeric = is_identifier = is_string = is_string_escaped = false;
+                token = Token(TokenType::TT_STRING, offset + 1, static_cast<std::uint32_t>(cursor - begin), escaped);
+
+                if(cursor != end)
+                    ++cursor;
+
+                m_cursor = cursor;
+                return true;
+            }
+            case CC_DIGIT:
+                // Digits and dots, anything else starts a new token.
+                while(cursor != end && (class_of(*cursor) == CC_DIGIT || *cursor == '.'))
+                    ++cursor;
+
+                token = Token(TokenType::TT_NUMERIC, offset, static_cast<std::uint32_t>(cursor - source) - offset);
+                m_cursor = cursor;
+                return true;
+            case CC_OTHER:
+            default:
+            {
+                // Identifiers, operators and keywords run until a delimiter.
+                const char* begin = cursor;
+
+                while(cursor != end && !is_delimiter(*cursor))
+                    ++cursor;
+
+                // To tell difference between operators, keywords and identifiers.
+                std::size_t length = static_cast<std::size_t>(cursor - begin);
+                const Keyword* keyword = find_keyword(begin, length);
+
+                if(keyword)
+                    token = Token(keyword->type, offset, static_cast<std::uint32_t>(length), false, keyword->op);
+                else
+                {
+                    token = Token(TokenType::TT_IDENTIFIER, 0, static_cast<std::uint32_t>(length));
+                    token.symbol = m_symbols.intern(begin, length);
+                }
+                m_cursor = cursor;
+                return true;
+            }
         }
     }
 
-    if(!current_token.value.empty())
-        m_tokens.push_back(current_token);
-
-    #ifdef DEBUG_LEXER
-    for(Token t : m_tokens)
-        std::cout << "\ttype: " << string_utils::from(t.type) << std::endl;
-    #endif // DEBUG_LEXER
+    m_cursor = cursor;
+    return false;
 }
 
-Token Lexer::getLook()
+const Token& Lexer::getLook() const
 {
+    static const Token none;
+
+    if(m_mode != Mode::BATCH)
+        return m_look;
+
+    if(isEmpty())
+        return none;
+
     return m_tokens[m_currentTokenIndex];
 }
 
 void Lexer::getNext()
 {
-    if(m_tokens.size() > m_currentTokenIndex)
+    if(m_mode == Mode::PULL)
+    {
+        if(m_look.type == TokenType::TT_NONE)
+            errors::lexerError("token list is empty");
+
+        if(!scan(m_look))
+            m_look = Token();
+    }
+    else if(getTokenCount() > m_currentTokenIndex)
+    {
         ++m_currentTokenIndex;
+
+        if(m_mode == Mode::INCREMENTAL)
+            load();
+    }
     else
         errors::lexerError("token list is empty");
 }
 
-bool Lexer::isEmpty()
+bool Lexer::isEmpty() const
+{
+    if(m_mode == Mode::PULL)
+        return m_look.type == TokenType::TT_NONE;
+
+    return m_currentTokenIndex >= getTokenCount();
+}
+
+const char* Lexer::getText(const Token& token) const
+{
+    if(token.type == TokenType::TT_IDENTIFIER)
+        return m_symbols.getName(token.symbol).data();
+
+    return m_source + token.offset;
+}
+
+std::string Lexer::getString(const Token& token) const
 {
-    return m_currentTokenIndex >= m_tokens.size();
+    const char* text = getText(token);
+    return std::string(text, text + token.length);
 }
@@ -34,6 +34,7 @@
 #include <functional>
 
 #include "datatypes.hpp"
+#include "symbol_table.hpp"
 
 /// Uncomment for debug.
 //#define DEBUG_LEXER
@@ -41,20 +42,131 @@
 class Lexer
 {
 	public:
-		Lexer(std::string input);
+		enum class Mode
+		{
+			// lex() cuts the whole source in a tokens list.
+			BATCH,
+			// The tokens are cut one at a time by getNext(), only the current one is kept.
+			PULL,
+			// As batch, with a copy of the source and the position of each token kept for relex().
+			INCREMENTAL
+		};
+
+		// The tokens [first, first + removed[ were replaced by inserted new ones.
+		struct Splice
+		{
+			std::size_t first;
+			std::size_t removed;
+			std::size_t inserted;
+		};
+
+		// The source is lexed in place : it must outlive the lexer, but in incremental mode.
+		// The identifiers are interned in the symbols table.
+		Lexer(const char* source, std::size_t size, SymbolTable& symbols, Mode mode = Mode::BATCH);
 
 		void lex();
 
-		Token getLook();
+		// In batch mode, lex the sources of at least two megabytes on up to this many threads,
+		// one chunk each. The tokens and symbols are the same as with a single thread.
+		void setThreads(std::size_t threads);
+
+		// Incremental mode : replace the bytes [offset, offset + removed[ of the source by the inserted
+		// ones of the text. Only the tokens from the last one before the edit are cut again, until they
+		// meet the previous tokens after it. The source and the tokens are kept in gap buffers left open
+		// where the edit ends : only those between this edit and the previous one move.
+		Splice relex(std::size_t offset, std::size_t removed, const char* text, std::size_t inserted);
+
+		static const std::uint32_t NO_PAIR = 0xFFFFFFFFu;
+		static const std::size_t NO_TOKEN = ~std::size_t(0);
+
+		// Incremental mode : the parser pairs the '(' and ')' tokens of each form, the pairs follow their
+		// tokens through the next edits. A pair whose token was cut again has NO_TOKEN in its place.
+		std::uint32_t pair(std::size_t open, std::size_t close);
+		void unpair(std::uint32_t pair);
+		void clearPairs();
+
+		// Pair of a parenthesis token, NO_PAIR for the other tokens and the parentheses not paired.
+		std::uint32_t getPair(std::size_t token) const;
+		std::size_t getOpen(std::uint32_t pair) const;
+		std::size_t getClose(std::uint32_t pair) const;
+
+		TokenType getType(std::size_t token) const;
+
+		// Index of the current token in batch and incremental modes, seek() goes back to one.
+		std::size_t getPosition() const;
+		void seek(std::size_t position);
+
+		// Return a TT_NONE token once all the tokens have been consumed.
+		const Token& getLook() const;
 		void getNext();
 
-		bool isEmpty();
+		bool isEmpty() const;
+
+		// Text of the token as written, escape sequences included, valid as long as the source.
+		const char* getText(const Token& token) const;
+		std::string getString(const Token& token) const;
+
+	protected:
+		// Cut the next token, return false at the end of the source.
+		bool scan(Token& token);
+
+		// Offsets cutting the source in up to count chunks, from 0 to the size. The cuts are
+		// on whitespaces outside of the strings and comments, where a token always ends.
+		std::vector<std::size_t> findChunkBounds(std::size_t count) const;
+		void lexChunks(std::size_t count);
+
+		// Incremental mode, see relex().
+		std::size_t getTokenCount() const;
+		std::size_t getSlot(std::size_t token) const;
+		std::size_t getStart(std::size_t token) const;
+
+		void moveTextGap(std::size_t position);
+		void reserveTextGap(std::size_t size);
+		void moveTokenGap(std::size_t token);
+		void reserveTokenGap(std::size_t count);
+
+		// Store the index of the parenthesis in m_tokens[slot] in its pair, if it has one.
+		void relink(std::size_t slot, std::uint32_t index);
+		void unlink(std::size_t slot);
+		// Token index as stored in the pairs, counted from the end after the tokens gap.
+		std::uint32_t encode(std::size_t token) const;
+		std::size_t decode(std::uint32_t index) const;
+
+		// The current token in m_look.
+		void load();
 
 	protected:
-	    std::string m_input;
+	    const char* m_source;
+	    std::size_t m_size;
+	    const char* m_cursor;
+
+	    SymbolTable& m_symbols;
+	    Mode m_mode;
+	    std::size_t m_threads;
 
 		std::vector<Token> m_tokens;
 		std::size_t m_currentTokenIndex;
+
+		// Offset of the last token cut by scan(), and of each token in incremental mode.
+		std::uint32_t m_start;
+		std::vector<std::uint32_t> m_positions;
+
+		// Current token in pull and incremental modes.
+		Token m_look;
+
+		// Incremental mode : the source with a gap of m_textGapSize bytes at m_textGap, and the tokens with
+		// a gap of m_tokenGapSize at m_tokenGap. The text gap is where the first token after the tokens gap
+		// starts. The tokens after the gap have their position counted from the end of the source, so that
+		// an edit before them does not move them. The offset of the parentheses holds their pair instead.
+		std::vector<char> m_text;
+		std::size_t m_textGap;
+		std::size_t m_textGapSize;
+		std::size_t m_tokenGap;
+		std::size_t m_tokenGapSize;
+
+		// The '(' and ')' token of each pair, see encode().
+		std::vector<std::uint32_t> m_pairs;
+		std::vector<std::uint32_t> m_freePairs;
 };
 
 #endif // LEXER_HPP_INCLUDED
@@ -25,23 +25,429 @@
 	Main function of the program.
 */
 
-#include <fstream>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <iomanip>
 #include <map>
+#include <thread>
+#include <vector>
 
 #include "datatypes.hpp"
 #include "string_utils.hpp"
 
 #include "args.hpp"
+#include "source_file.hpp"
+#include "scan.hpp"
 #include "lexer.hpp"
 #include "parser.hpp"
+#include "incremental_parser.hpp"
+#include "compiler.hpp"
+#include "optimizer.hpp"
+#include "pipeline.hpp"
+#include "program_cache.hpp"
 #include "runtime.hpp"
 
+#if defined(__unix__) || defined(__APPLE__)
+    #include <sys/resource.h>
+#endif
+
 /// Uncomment the next line for global debug.
 //#define GLOBAL_DEBUG
 
-int interactive_loop()
+/// Command line options.
+struct Options
+{
+    enum class Engine
+    {
+        VM,
+        TREE,
+        FLAT
+    };
+
+    Options()
+        : engine(Engine::VM)
+        , lexer(Lexer::Mode::BATCH)
+        , threads(std::max(std::thread::hardware_concurrency(), 1u))
+        , stream(false)
+        , bench(false)
+        , memo(false)
+        , optimize(true)
+        , ssa(false)
+        , dump(false)
+        , watch(false)
+    {}
+
+    // engine=vm (default) : compile the AST to bytecode and execute it.
+    // engine=tree : evaluate the pointer AST directly.
+    // engine=flat : evaluate the flat AST directly.
+    Engine engine;
+
+    // lexer=batch (default) : cut the whole source in tokens before parsing.
+    // lexer=pull : cut the tokens on demand while parsing, memory does not grow with the source.
+    Lexer::Mode lexer;
+
+    // threads=n : lex the large sources on up to n threads, one per core by default.
+    std::size_t threads;
+
+    // stream=true : evaluate each statement of the top-level program as soon as it is parsed, then release it.
+    // The source is lexed and parsed on another thread, the statements before a syntax error run.
+    // The vm and tree engines only.
+    bool stream;
+
+    // cache=directory : keep the programs compiled for the vm engine in the directory, and run them
+    // from there while their source, optimize and ssa do not change. Takes precedence over stream, compiles
+    // again with dump=true.
+    std::string cache;
+
+    // bench=true : report the time spent in each phase on the error output.
+    bool bench;
+
+    // memo=true : memoize the results of the pure functions by their arguments. A function is pure if it
+    // does not print, read the input or a global variable, nor define a function, and nor do the functions
+    // it calls. Reported with bench=true, or by :memo in the interactive loop.
+    bool memo;
+
+    // optimize=false : evaluate the tree as parsed, without folding its constant expressions first (see optimizer.hpp).
+    bool optimize;
+
+    // ssa=true : also remove the redundant evaluations and assignments of the program when optimizing (see ssa.hpp).
+    // Worth it for the programs computing the same values again, slower to optimize for the others.
+    bool ssa;
+
+    // dump=true : write the tree to be evaluated, once optimized, on the error output.
+    bool dump;
+
+    // watch=true : evaluate the file again each time it changes, checked every 100 ms, only lexing and parsing
+    // again around the change (see incremental_parser.hpp). On the vm engine without optimizing : the tree
+    // is kept from one run to the next.
+    bool watch;
+};
+
+namespace
+{
+    // Measures the wall-clock time of the phases for bench=true.
+    class Stopwatch
+    {
+        public:
+            Stopwatch()
+                : m_start(std::chrono::steady_clock::now())
+            {}
+
+            // Return the elapsed milliseconds and restart.
+            double lap()
+            {
+                std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                double elapsed = std::chrono::duration<double, std::milli>(now - m_start).count();
+
+                m_start = now;
+                return elapsed;
+            }
+
+        protected:
+            std::chrono::steady_clock::time_point m_start;
+    };
+
+    // Nodes reachable from the root, the ones the engines evaluate.
+    std::size_t count_nodes(Node* root)
+    {
+        std::size_t count(0);
+        std::vector<Node*> nodes(1, root);
+
+        while(!nodes.empty())
+        {
+            Node* node = nodes.back();
+            nodes.pop_back();
+
+            NodeList children = node->getChildren();
+            nodes.insert(nodes.end(), children.begin(), children.end());
+            ++count;
+        }
+
+        return count;
+    }
+
+    // Same in a flat tree, where the nodes folded away stay in the arrays.
+    std::size_t count_nodes(const FlatAst& ast)
+    {
+        std::size_t count(0);
+        std::vector<NodeIndex> nodes(1, ast.getRoot());
+
+        while(!nodes.empty())
+        {
+            NodeIndex node = nodes.back();
+            nodes.pop_back();
+
+            const NodeIndex* children = ast.getChildren(node);
+            nodes.insert(nodes.end(), children, children + ast.getChildCount(node));
+            ++count;
+        }
+
+        return count;
+    }
+
+    // Peak resident memory of the process in kilobytes, 0 where it is not known.
+    std::size_t peak_memory()
+    {
+        #if defined(__unix__) || defined(__APPLE__)
+            rusage usage;
+
+            if(getrusage(RUSAGE_SELF, &usage) != 0)
+                return 0;
+
+            #ifdef __APPLE__
+                return static_cast<std::size_t>(usage.ru_maxrss) / 1024;
+            #else
+                return static_cast<std::size_t>(usage.ru_maxrss);
+            #endif
+        #else
+            return 0;
+        #endif
+    }
+
+    // The tree simplified for optimize=true, written for dump=true.
+    Node* optimize(Optimizer& optimizer, Node* root, Runtime& runtime, const Options& options)
+    {
+        if(options.optimize)
+        {
+            optimizer.setSsa(options.ssa);
+            root = optimizer.optimize(root);
+        }
+
+        if(options.dump)
+            Optimizer::dump(root, runtime.getSymbols(), std::cerr);
+
+        return root;
+    }
+
+    void print_optimizer(const Optimizer& optimizer, double time)
+    {
+        std::cerr << "bench: optimize " << time << " ms, " << optimizer.getFoldedCount() << " expressions folded, "
+                  << optimizer.getReducedCount() << " strength reduced, " << optimizer.getSavedCount() << " evaluations saved, "
+                  << optimizer.getEliminatedCount() << " statements eliminated" << std::endl;
+    }
+
+    // Hits and misses of the memoized functions bound.
+    void print_memo(Runtime& runtime, std::ostream& stream, const char* prefix)
+    {
+        for(const std::shared_ptr<Function>& function : runtime.getFunctions())
+        {
+            if(!function || !function->memo)
+                continue;
+
+            const MemoTable& memo = *function->memo;
+
+            stream << prefix << "memo " << runtime.getSymbols().getName(function->name) << " : " << memo.getHits() << " hits, "
+                   << memo.getMisses() << " misses, " << memo.getEvictions() << " evictions, " << memo.size() << " results" << std::endl;
+        }
+    }
+
+    // Parse and evaluate with the engine selected in the options.
+    Value run(Runtime& runtime, Parser& parser, const Options& options)
+    {
+        Stopwatch stopwatch;
+        double parse_time(0.0), optimize_time(0.0), compile_time(0.0), eval_time(0.0);
+        Optimizer optimizer(&runtime.getSymbols());
+
+        std::size_t nodes(0), node_bytes(0);
+        Value result;
+
+        /** Parse (build the AST from the tokens list). */
+        #ifdef GLOBAL_DEBUG
+            std::cout << "Parsing..." << std::endl;
+        #endif // GLOBAL_DEBUG
+        if(options.engine == Options::Engine::FLAT)
+        {
+            FlatAst ast = parser.parseFlat();
+            parse_time = stopwatch.lap();
+
+            /** Optimize (fold the constant expressions). */
+            if(options.optimize)
+            {
+                optimizer.setSsa(options.ssa);
+                optimizer.optimize(ast);
+            }
+
+            if(options.dump)
+                Optimizer::dump(ast, runtime.getSymbols(), std::cerr);
+
+            optimize_time = stopwatch.lap();
+
+            /** Declare the variables (each symbol has its slot). */
+            runtime.declareSymbols();
+
+            compile_time = stopwatch.lap();
+
+            /** Evaluation of the flat AST. */
+            #ifdef GLOBAL_DEBUG
+                std::cout << "Flat AST evaluation..." << std::endl;
+            #endif // GLOBAL_DEBUG
+            result = runtime.eval(ast);
+            eval_time = stopwatch.lap();
+
+            nodes = count_nodes(ast);
+            node_bytes = FlatAst::getBytesPerNode();
+        }
+        else
+        {
+            Node* ast_root = parser.parse();
+            parse_time = stopwatch.lap();
+
+            /** Optimize (fold the constant expressions). */
+            ast_root = optimize(optimizer, ast_root, runtime, options);
+            optimize_time = stopwatch.lap();
+
+            /** Declare the variables (each symbol has its slot). */
+            runtime.declareSymbols();
+
+            if(options.engine == Options::Engine::TREE)
+            {
+                compile_time = stopwatch.lap();
+
+                /** Evaluation of the AST tree. */
+                #ifdef GLOBAL_DEBUG
+                    std::cout << "AST evaluation..." << std::endl;
+                #endif // GLOBAL_DEBUG
+                result = runtime.eval(ast_root);
+            }
+            else
+            {
+                /** Compile (lower the AST to bytecode). */
+                #ifdef GLOBAL_DEBUG
+                    std::cout << "Compiling..." << std::endl;
+                #endif // GLOBAL_DEBUG
+                Compiler compiler;
+                Bytecode bytecode = compiler.compile(ast_root);
+
+                compile_time = stopwatch.lap();
+
+                /** Execution of the bytecode. */
+                #ifdef GLOBAL_DEBUG
+                    std::cout << "Bytecode execution..." << std::endl;
+                #endif // GLOBAL_DEBUG
+                result = runtime.execute(bytecode);
+            }
+
+            eval_time = stopwatch.lap();
+
+            if(options.bench)
+                nodes = count_nodes(ast_root);
+
+            node_bytes = sizeof(Node) + sizeof(Node*);
+        }
+
+        if(options.bench)
+        {
+            static const char* engines[] = {"vm", "tree", "flat"};
+
+            std::cerr << "bench: parse " << parse_time << " ms, compile " << compile_time << " ms, eval " << eval_time << " ms ("
+                      << engines[static_cast<int>(options.engine)] << ", " << nodes << " nodes of " << node_bytes << " bytes, "
+                      << eval_time * 1e6 / static_cast<double>(nodes) << " ns/node, values of " << sizeof(Value) << " bytes)" << std::endl;
+
+            if(options.optimize)
+                print_optimizer(optimizer, optimize_time);
+
+            std::cerr << "bench: peak memory " << peak_memory() << " kB" << std::endl;
+        }
+
+        return result;
+    }
+
+    // Execute the program compiled by a previous run if the source has not changed since, compile it
+    // and store it in the cache otherwise.
+    void run_cached(Runtime& runtime, const SourceFile& source, const Options& options, Stopwatch& startup)
+    {
+        std::uint32_t settings = options.optimize ? ProgramCache::optimized | (options.ssa ? ProgramCache::ssa : 0) : 0;
+        ProgramCache cache(options.cache, source.getData(), source.getSize(), settings);
+        Bytecode bytecode;
+
+        // The tree to dump is only built by a compilation.
+        bool hit = !options.dump && cache.load(bytecode, runtime.getSymbols());
+
+        if(!hit)
+        {
+            Arena arena;
+
+            Lexer lexer(source.getData(), source.getSize(), runtime.getSymbols(), options.lexer);
+            lexer.setThreads(options.threads);
+            lexer.lex();
+
+            Parser parser(lexer, arena);
+            Optimizer optimizer(&runtime.getSymbols());
+            Compiler compiler;
+            bytecode = compiler.compile(optimize(optimizer, parser.parse(), runtime, options));
+
+            if(!cache.store(bytecode, runtime.getSymbols()) && options.bench)
+                std::cerr << "bench: cannot write " << cache.getPath() << std::endl;
+        }
+
+        runtime.declareSymbols();
+        double startup_time = startup.lap();
+
+        runtime.execute(bytecode);
+
+        if(options.bench)
+            std::cerr << "bench: cache " << (hit ? "hit" : "miss") << ", " << startup_time << " ms from the start to the evaluation, eval "
+                      << startup.lap() << " ms" << std::endl;
+    }
+
+    // The edit turning the previous text in the next one : the bytes between their common beginning and end.
+    void find_edit(const std::string& previous, const std::string& next, std::size_t& offset, std::size_t& removed, std::size_t& inserted)
+    {
+        std::size_t common = std::min(previous.size(), next.size());
+        std::size_t suffix(0);
+
+        offset = 0;
+
+        while(offset < common && previous[offset] == next[offset])
+            ++offset;
+
+        while(suffix < common - offset && previous[previous.size() - 1 - suffix] == next[next.size() - 1 - suffix])
+            ++suffix;
+
+        removed = previous.size() - offset - suffix;
+        inserted = next.size() - offset - suffix;
+    }
+
+    // Evaluate the statements of the program as they come out of the pipeline.
+    void run_stream(Runtime& runtime, const SourceFile& source, const Options& options)
+    {
+        Stopwatch stopwatch;
+        double first_time(0.0);
+        std::size_t batches(0);
+
+        Pipeline pipeline(source.getData(), source.getSize());
+        // Without temporaries : the symbols are interned in the order of the producer.
+        Optimizer optimizer;
+        Compiler compiler;
+
+        while(Node* root = pipeline.next(runtime.getSymbols()))
+        {
+            if(batches++ == 0)
+                first_time = stopwatch.lap();
+
+            runtime.declareSymbols();
+
+            // The nodes of the statement are released once it is evaluated, and so are the folded strings.
+            optimizer.clear();
+            root = optimize(optimizer, root, runtime, options);
+
+            if(options.engine == Options::Engine::TREE)
+                runtime.eval(root);
+            else
+            {
+                Bytecode bytecode = compiler.compile(root);
+                runtime.execute(bytecode);
+            }
+        }
+
+        if(options.bench)
+            std::cerr << "bench: stream " << first_time << " ms to the first statements, " << first_time + stopwatch.lap() << " ms in total ("
+                      << (options.engine == Options::Engine::TREE ? "tree" : "vm") << ", " << batches << " batches)" << std::endl;
+    }
+}
+
+int interactive_loop(const Options& options)
 {
     /** Welcome. */
     std::cout << "\t-*- e-lang -*-" << std::endl;
@@ -49,6 +455,10 @@ int interactive_loop()
 
     // The runtime has to be outside the loop if we want it to be consistent.
     Runtime runtime;
+    runtime.setMemoization(options.memo);
+
+    // The AST of each line is released at once and its memory reused by the next one.
+    Arena arena;
 
     do
     {
@@ -75,45 +485,42 @@ int interactive_loop()
                 std::cout << "Runtime has been cleared." << std::endl;
                 continue;
             }
+            else if(line == ":memo")
+            {
+                print_memo(runtime, std::cout, "");
+                continue;
+            }
             else if(line == ":help")
             {
                 std::cout << "Interactive loop help." << std::endl;
                 std::cout << "\t" << ":quit -> quit the interactive loop" << std::endl;
-                std::cout << "\t" << ":clear_runtime -> clear all variables assigned" << std::endl;
+                std::cout << "\t" << ":clear_runtime -> clear all variables assigned and functions defined" << std::endl;
+                std::cout << "\t" << ":memo -> hits and misses of the memoized functions (memo=true)" << std::endl;
                 std::cout << "\t" << ":help -> display this help" << std::endl;
 
                 continue;
             }
         }
 
-        Node* ast_root = nullptr;
-
         try
         {
             /** Lex (cut the input source in a tokens list). */
             #ifdef GLOBAL_DEBUG
                 std::cout << "Lexing..." << std::endl;
             #endif // GLOBAL_DEBUG
-            Lexer lexer(line);
+            Lexer lexer(line.data(), line.size(), runtime.getSymbols(), options.lexer);
             lexer.lex();
 
-            /** Parse (build the AST from the tokens list). */
-            #ifdef GLOBAL_DEBUG
-                std::cout << "Parsing..." << std::endl;
-            #endif // GLOBAL_DEBUG
-            Parser parser(lexer);
-            ast_root = parser.parse();
-
-            /** Evaluation of the AST tree. */
-            #ifdef GLOBAL_DEBUG
-                std::cout << "AST evaluation..." << std::endl;
-            #endif // GLOBAL_DEBUG
-            Value result = runtime.eval(ast_root);
+            Parser parser(lexer, arena);
+            Value result = run(runtime, parser, options);
 
             if(result.type == ValueType::VT_NUMERIC)
-                std::cout << result.numeric << std::endl;
+            {
+                char buffer[string_utils::maxFloatLength];
+                std::cout.write(buffer, static_cast<std::streamsize>(string_utils::formatFloat(result.numeric, buffer))) << std::endl;
+            }
             else if(result.type == ValueType::VT_STRING)
-                std::cout << result.string << std::endl;
+                std::cout << result.string->toStdString() << std::endl;
         }
         catch(std::exception& e)
         {
@@ -125,77 +532,201 @@ int interactive_loop()
             std::cerr << "Runtime has been cleared." << std::endl;
         }
 
-        if(ast_root)
-            delete ast_root;
+        arena.clear();
     }while(true);
 
 	return 0;
 }
 
-int execute_from_file(const std::string& filepath)
+int execute_from_file(const std::string& filepath, const Options& options)
 {
-    Node* ast_root = nullptr;
+    Arena arena;
 
     try
     {
         /** Get file content. */
-        std::string filecontent("");
-        std::ifstream inputfile(filepath.c_str());
+        Stopwatch stopwatch;
+        Stopwatch startup;
 
-        if(!inputfile)
-            errors::runtimeError("cannot open file : \"" + filepath + "\"");
+        SourceFile source(filepath);
 
-        std::string line("");
-        while(std::getline(inputfile, line))
+        if(options.bench)
+            std::cerr << "bench: load " << stopwatch.lap() << " ms (" << (source.isMapped() ? "mapped" : "read") << ")" << std::endl;
+
+        Runtime runtime;
+        runtime.setMemoization(options.memo);
+
+        /** Or run the program compiled by a previous run. */
+        if(!options.cache.empty() && options.engine == Options::Engine::VM)
         {
-            // We add '\n' to skip comments.
-            // The lexer won't have to deal with differents : LF, CR or CRLF.
-            filecontent += line + '\n';
+            run_cached(runtime, source, options, startup);
+
+            if(options.bench)
+                print_memo(runtime, std::cerr, "bench: ");
+            return 0;
+        }
+
+        /** Or lex and parse on another thread, evaluating the statements as they come. */
+        if(options.stream && options.engine != Options::Engine::FLAT)
+        {
+            run_stream(runtime, source, options);
+
+            if(options.bench)
+                print_memo(runtime, std::cerr, "bench: ");
+            return 0;
         }
 
         /** Lex (cut the input source in a tokens list). */
         #ifdef GLOBAL_DEBUG
             std::cout << "Lexing..." << std::endl;
         #endif // GLOBAL_DEBUG
-        Lexer lexer(filecontent);
+        Lexer lexer(source.getData(), source.getSize(), runtime.getSymbols(), options.lexer);
+        lexer.setThreads(options.threads);
         lexer.lex();
 
-        /** Parse (build the AST from the tokens list). */
-        #ifdef GLOBAL_DEBUG
-            std::cout << "Parsing..." << std::endl;
-        #endif // GLOBAL_DEBUG
-        Parser parser(lexer);
-        ast_root = parser.parse();
+        if(options.bench && options.lexer == Lexer::Mode::PULL)
+            std::cerr << "bench: lex while parsing (pull mode)" << std::endl;
+        else if(options.bench)
+        {
+            double lex_time = stopwatch.lap();
 
-        /** Evaluation of the AST tree. */
-        #ifdef GLOBAL_DEBUG
-            std::cout << "AST evaluation..." << std::endl;
-        #endif // GLOBAL_DEBUG
-        Runtime runtime;
-        runtime.eval(ast_root);
+            std::cerr << "bench: lex " << lex_time << " ms (" << source.getSize() / 1024 << " KB, "
+                      << static_cast<double>(source.getSize()) / (1024.0 * 1024.0) / (lex_time / 1000.0) << " MB/s, "
+                      << string_utils::from(scan::getSelected()) << " scans, up to " << options.threads << " threads)" << std::endl;
+        }
+
+        Parser parser(lexer, arena);
+
+        run(runtime, parser, options);
+
+        if(options.bench)
+        {
+            print_memo(runtime, std::cerr, "bench: ");
+
+            std::size_t blocks = arena.getBlockCount();
+            std::size_t bytes = arena.getReservedBytes();
+
+            stopwatch.lap();
+            arena.clear();
+
+            std::cerr << "bench: AST arena " << bytes / 1024 << " KB in " << blocks << " blocks, released in "
+                      << stopwatch.lap() << " ms" << std::endl;
+        }
     }
     catch(std::exception& e)
     {
         std::cerr << e.what() << "." << std::endl;
-
-        if(ast_root)
-            delete ast_root;
-
         return 1;
     }
 
-    if(ast_root)
-        delete ast_root;
-
     return 0;
 }
 
+int watch_file(const std::string& filepath, const Options& options)
+{
+    Runtime runtime;
+    runtime.setMemoization(options.memo);
+
+    IncrementalParser parser(runtime.getSymbols());
+    std::string source;
+
+    for(bool first(true) ; ; first = false)
+    {
+        std::string next;
+
+        try
+        {
+            SourceFile file(filepath);
+            next.assign(file.getData(), file.getSize());
+        }
+        catch(std::exception& e)
+        {
+            // Once watched, the file may be missing for a moment while it is saved.
+            if(first)
+            {
+                std::cerr << e.what() << "." << std::endl;
+                return 1;
+            }
+
+            next = source;
+        }
+
+        if(!first && next == source)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+
+        Stopwatch stopwatch;
+        std::size_t offset(0), removed(0), inserted(0);
+
+        find_edit(source, next, offset, removed, inserted);
+
+        std::string text = next.substr(offset, inserted);
+        source.swap(next);
+
+        try
+        {
+            /** Lex and parse again around the edit. */
+            Node* root = parser.edit(offset, removed, text);
+            double parse_time = stopwatch.lap();
+
+            /** Compile and execute from a clean runtime. */
+            runtime.clear();
+            runtime.declareSymbols();
+
+            Compiler compiler;
+            Bytecode bytecode = compiler.compile(root);
+            double compile_time = stopwatch.lap();
+
+            runtime.execute(bytecode);
+
+            if(options.bench)
+                std::cerr << "bench: edit of " << removed << " bytes by " << inserted << " bytes, " << parser.getRelexedTokens() << " tokens cut and "
+                          << parser.getReparsedTokens() << " parsed again in " << parse_time << " ms, compile " << compile_time << " ms, eval "
+                          << stopwatch.lap() << " ms" << std::endl;
+        }
+        catch(std::exception& e)
+        {
+            std::cerr << e.what() << "." << std::endl;
+        }
+    }
+}
+
 int main(int argc, char* argv[])
 {
 	std::map<std::string, std::string> args = map_args(parse_args(argc, argv));
 
-	if(!args["file"].empty())
-        return execute_from_file(args["file"]);
+    Options options;
+    if(args["engine"] == "tree")
+        options.engine = Options::Engine::TREE;
+    else if(args["engine"] == "flat")
+        options.engine = Options::Engine::FLAT;
+    if(args["lexer"] == "pull")
+        options.lexer = Lexer::Mode::PULL;
+    if(!args["threads"].empty())
+        options.threads = std::max(string_utils::to<std::size_t>(args["threads"]), std::size_t(1));
+
+    // simd=scalar|sse2|avx2 : force the instruction set of the lexer scans, the best one by default.
+    if(args["simd"] == "scalar" && !scan::select(scan::InstructionSet::SCALAR))
+        std::cerr << "simd=scalar is not supported." << std::endl;
+    else if(args["simd"] == "sse2" && !scan::select(scan::InstructionSet::SSE2))
+        std::cerr << "simd=sse2 is not supported on this CPU." << std::endl;
+    else if(args["simd"] == "avx2" && !scan::select(scan::InstructionSet::AVX2))
+        std::cerr << "simd=avx2 is not supported on this CPU." << std::endl;
+    options.stream = (args["stream"] == "true");
+    options.cache = args["cache"];
+    options.bench = (args["bench"] == "true");
+    options.memo = (args["memo"] == "true");
+    options.optimize = (args["optimize"] != "false");
+    options.ssa = (args["ssa"] == "true");
+    options.dump = (args["dump"] == "true");
+    options.watch = (args["watch"] == "true");
+
+	if(!args["file"].empty() && options.watch)
+        return watch_file(args["file"], options);
+	else if(!args["file"].empty())
+        return execute_from_file(args["file"], options);
     else
-        return interactive_loop();
+        return interactive_loop(options);
 }
@@ -0,0 +1,205 @@
+#include "memo_table.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "hashing.hpp"
+
+const std::size_t MemoTable::initialBuckets;
+const std::size_t MemoTable::maxBuckets;
+const std::size_t MemoTable::probeLength;
+
+namespace
+{
+    bool same_value(const Value& lhs, const Value& rhs)
+    {
+        if(lhs.type != rhs.type)
+            return false;
+
+        if(lhs.type == ValueType::VT_NUMERIC)
+            return std::memcmp(&lhs.numeric, &rhs.numeric, sizeof(float)) == 0;
+
+        if(lhs.type == ValueType::VT_STRING)
+            return lhs.string == rhs.string || (lhs.string->getSize() == rhs.string->getSize()
+                                                && std::memcmp(lhs.string->getData(), rhs.string->getData(), lhs.string->getSize()) == 0);
+
+        return true;
+    }
+}
+
+MemoTable::MemoTable(std::size_t arity)
+    : m_arity(arity)
+    , m_buckets(initialBuckets, Bucket{0, false, false})
+    , m_values(initialBuckets * (arity + 1))
+    , m_size(0)
+    , m_hits(0)
+    , m_misses(0)
+    , m_evictions(0)
+{}
+
+const Value* MemoTable::find(const Value* arguments)
+{
+    std::uint32_t keyHash = hash(arguments);
+    std::size_t mask = m_buckets.size() - 1;
+
+    // The entries are never removed one by one : a key is before the first free bucket of its window.
+    for(std::size_t i(0), bucket(keyHash & mask) ; i < probeLength && m_buckets[bucket].used ; ++i, bucket = (bucket + 1) & mask)
+    {
+        if(matches(bucket, keyHash, arguments))
+        {
+            m_buckets[bucket].referenced = true;
+            ++m_hits;
+
+            return &m_values[bucket * (m_arity + 1) + m_arity];
+        }
+    }
+
+    ++m_misses;
+    return nullptr;
+}
+
+void MemoTable::insert(const Value* arguments, const Value& result)
+{
+    // Keep the buckets at most half full until the bound.
+    if((m_size + 1) * 2 > m_buckets.size() && m_buckets.size() < maxBuckets)
+        grow();
+
+    std::uint32_t keyHash = hash(arguments);
+    std::size_t mask(0);
+    std::size_t home(0);
+
+    // A full window grows the table as well, an entry is only evicted at the bound.
+    for(;;)
+    {
+        mask = m_buckets.size() - 1;
+        home = keyHash & mask;
+
+        for(std::size_t i(0), bucket(home) ; i < probeLength ; ++i, bucket = (bucket + 1) & mask)
+        {
+            if(!m_buckets[bucket].used || matches(bucket, keyHash, arguments))
+            {
+                m_size += !m_buckets[bucket].used;
+                store(bucket, keyHash, arguments, result);
+                return;
+            }
+        }
+
+        if(m_buckets.size() >= maxBuckets)
+            break;
+
+        grow();
+    }
+
+    // The window is full : the first entry not found since the last pass of the hand, or the first one
+    // if they all were.
+    std::size_t victim = home;
+
+    for(std::size_t i(0), bucket(home) ; i < probeLength ; ++i, bucket = (bucket + 1) & mask)
+    {
+        if(!m_buckets[bucket].referenced)
+        {
+            victim = bucket;
+            break;
+        }
+
+        m_buckets[bucket].referenced = false;
+    }
+
+    ++m_evictions;
+    store(victim, keyHash, arguments, result);
+}
+
+void MemoTable::clear()
+{
+    std::fill(m_buckets.begin(), m_buckets.end(), Bucket{0, false, false});
+    std::fill(m_values.begin(), m_values.end(), Value());
+
+    m_size = 0;
+}
+
+std::uint32_t MemoTable::hash(const Value* arguments) const
+{
+    // FNV-1a on the types and the contents.
+    std::uint32_t hash(hashing::basis);
+
+    for(std::size_t i(0) ; i < m_arity ; ++i)
+    {
+        const Value& argument = arguments[i];
+        hash = hashing::mix(hash, static_cast<std::uint32_t>(argument.type));
+
+        if(argument.type == ValueType::VT_NUMERIC)
+        {
+            std::uint32_t bits(0);
+            std::memcpy(&bits, &argument.numeric, sizeof(bits));
+
+            hash = hashing::mix(hash, bits);
+        }
+        else if(argument.type == ValueType::VT_STRING)
+            hash = hashing::mix(hash, argument.string->getData(), argument.string->getSize());
+    }
+
+    // The buckets are indexed by the low bits.
+    return hashing::finalize(hash);
+}
+
+bool MemoTable::matches(std::size_t bucket, std::uint32_t keyHash, const Value* arguments) const
+{
+    if(m_buckets[bucket].hash != keyHash)
+        return false;
+
+    const Value* key = &m_values[bucket * (m_arity + 1)];
+
+    for(std::size_t i(0) ; i < m_arity ; ++i)
+    {
+        if(!same_value(key[i], arguments[i]))
+            return false;
+    }
+
+    return true;
+}
+
+void MemoTable::store(std::size_t bucket, std::uint32_t keyHash, const Value* arguments, const Value& result)
+{
+    Value* entry = &m_values[bucket * (m_arity + 1)];
+
+    std::copy(arguments, arguments + m_arity, entry);
+    entry[m_arity] = result;
+
+    m_buckets[bucket] = Bucket{keyHash, true, false};
+}
+
+void MemoTable::grow()
+{
+    std::vector<Bucket> buckets(m_buckets.size() * 2, Bucket{0, false, false});
+    std::vector<Value> values(buckets.size() * (m_arity + 1));
+    std::size_t mask = buckets.size() - 1;
+    std::size_t entries = m_size;
+
+    m_size = 0;
+
+    for(std::size_t old(0) ; old < m_buckets.size() ; ++old)
+    {
+        if(!m_buckets[old].used)
+            continue;
+
+        // An entry whose window is full in the larger table is dropped.
+        for(std::size_t i(0), bucket(m_buckets[old].hash & mask) ; i < probeLength ; ++i, bucket = (bucket + 1) & mask)
+        {
+            if(buckets[bucket].used)
+                continue;
+
+            std::move(m_values.begin() + static_cast<std::ptrdiff_t>(old * (m_arity + 1)), m_values.begin() + static_cast<std::ptrdiff_t>((old + 1) * (m_arity + 1)),
+                      values.begin() + static_cast<std::ptrdiff_t>(bucket * (m_arity + 1)));
+
+            buckets[bucket] = m_buckets[old];
+            ++m_size;
+            break;
+        }
+    }
+
+    // The dropped entries count as evicted.
+    m_evictions += entries - m_size;
+
+    m_buckets.swap(buckets);
+    m_values.swap(values);
+}
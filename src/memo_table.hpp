@@ -0,0 +1,112 @@
+/*
+	memo_table.hpp
+
+	The MIT License (MIT)
+
+	Copyright (c) 2014 Maxime Alvarez
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+	Defines the table of the results memoized for a pure function.
+*/
+
+#ifndef MEMO_TABLE_HPP_INCLUDED
+#define MEMO_TABLE_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "datatypes.hpp"
+
+/// Results of a pure function by the values of its arguments, numerics compared by their bits and strings
+/// by their characters. Open addressing on a power of two buckets, a key being looked for in a window of
+/// probeLength buckets from its hash. The table grows when it is half full or a window is, up to maxBuckets,
+/// then inserting in a full window evicts an entry with the CLOCK policy : the hand runs over the window and
+/// spares once the entries found since it last passed. The entries a growth cannot place count as evicted.
+class MemoTable
+{
+    public:
+        explicit MemoTable(std::size_t arity);
+
+        // The result recorded for the arguments, nullptr if there is none. Counts a hit or a miss.
+        const Value* find(const Value* arguments);
+        void insert(const Value* arguments, const Value& result);
+
+        // Forget the results, not the counters.
+        void clear();
+
+        std::size_t getArity() const
+        {
+            return m_arity;
+        }
+
+        std::size_t size() const
+        {
+            return m_size;
+        }
+
+        std::size_t getHits() const
+        {
+            return m_hits;
+        }
+
+        std::size_t getMisses() const
+        {
+            return m_misses;
+        }
+
+        std::size_t getEvictions() const
+        {
+            return m_evictions;
+        }
+
+        static const std::size_t initialBuckets = 64;
+        static const std::size_t maxBuckets = 1 << 14;
+        static const std::size_t probeLength = 8;
+
+    protected:
+        std::uint32_t hash(const Value* arguments) const;
+        bool matches(std::size_t bucket, std::uint32_t keyHash, const Value* arguments) const;
+
+        // Store the key and the result in the bucket, which may hold an entry already.
+        void store(std::size_t bucket, std::uint32_t keyHash, const Value* arguments, const Value& result);
+
+        void grow();
+
+        std::size_t m_arity;
+
+        struct Bucket
+        {
+            std::uint32_t hash;
+            bool used;
+            // Found since the hand of the clock last passed.
+            bool referenced;
+        };
+
+        std::vector<Bucket> m_buckets;
+        // The arguments then the result of each bucket.
+        std::vector<Value> m_values;
+
+        std::size_t m_size;
+        std::size_t m_hits;
+        std::size_t m_misses;
+        std::size_t m_evictions;
+};
+
+#endif // MEMO_TABLE_HPP_INCLUDED
@@ -0,0 +1,525 @@
+#include "optimizer.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "tree_view.hpp"
+
+namespace
+{
+    // Left folds : (- a b c) => (a - b) - c, so their leading operands can be folded alone.
+    bool is_fold(Operator op)
+    {
+        return op >= Operator::OP_ADD && op <= Operator::OP_POW;
+    }
+
+    std::uint32_t bits(float numeric)
+    {
+        std::uint32_t value(0);
+        std::memcpy(&value, &numeric, sizeof(value));
+
+        return value;
+    }
+
+    // x * (1 / divisor) is rounded as x / divisor when the reciprocal is exact, that is for a normal power of two :
+    // no mantissa, and an exponent which is neither the one of the zeros and subnormals nor the one of inf and NaN.
+    bool has_exact_reciprocal(const Value& divisor)
+    {
+        if(divisor.type != ValueType::VT_NUMERIC)
+            return false;
+
+        std::uint32_t exponent = (bits(divisor.numeric) >> 23) & 0xFF;
+        return (bits(divisor.numeric) & 0x7FFFFF) == 0 && exponent != 0 && exponent != 0xFF;
+    }
+
+    // x * x is rounded as std::pow(x, 2) since the square of a float is exact in double, unlike the other powers.
+    bool is_two(const Value& exponent)
+    {
+        return exponent.type == ValueType::VT_NUMERIC && bits(exponent.numeric) == bits(2.f);
+    }
+
+    // The value of an expression of these operators is a number, or an error of their own.
+    bool yields_numeric(Operator op)
+    {
+        return op == Operator::OP_TO_NUMERIC || (op >= Operator::OP_SUB && op <= Operator::OP_SQUARE);
+    }
+
+    // A strength reduction changes the operator : it is only made when the first operand is known to be a number,
+    // the only operand whose type may fail the expression, for the errors to name the operator written.
+    bool is_known_numeric(NodeType type, ValueType valueType, Operator op)
+    {
+        return (type == NodeType::NT_CONST_VALUE && valueType == ValueType::VT_NUMERIC)
+               || (type == NodeType::NT_EXPRESSION && yields_numeric(op));
+    }
+
+    // The branch of (if constant then [else]) can replace it, but for a variable which assign does not take as its value.
+    bool can_replace(NodeType type)
+    {
+        return type == NodeType::NT_CONST_VALUE || type == NodeType::NT_EXPRESSION;
+    }
+
+    /** Dump. */
+    // The symbol of an arithmetic operator as written in the source, the other ones are words.
+    const char* spelling(Operator op)
+    {
+        static const char* symbols[] = {"+", "-", "*", "/", "%", "^"};
+
+        return is_fold(op) ? symbols[static_cast<int>(op) - static_cast<int>(Operator::OP_ADD)] : nullptr;
+    }
+
+    void write_value(const Value& value, std::ostream& stream)
+    {
+        if(value.type == ValueType::VT_NUMERIC)
+        {
+            char buffer[string_utils::maxFloatLength];
+            stream.write(buffer, static_cast<std::streamsize>(string_utils::formatFloat(value.numeric, buffer)));
+        }
+        else if(value.type == ValueType::VT_STRING)
+        {
+            stream << '"';
+
+            for(const char* c = value.string->getData() ; c != value.string->getData() + value.string->getSize() ; ++c)
+            {
+                if(*c == '\n')
+                    stream << "\\n";
+                else if(*c == '\t')
+                    stream << "\\t";
+                else if(*c == '\r')
+                    stream << "\\r";
+                else if(*c == '"' || *c == '\\')
+                    stream << '\\' << *c;
+                else
+                    stream << *c;
+            }
+
+            stream << '"';
+        }
+        else
+            stream << "null";
+    }
+
+    // Both trees are written through their accessors, see tree_view.hpp.
+    template<typename Tree>
+    void write_tree(const Tree& tree, typename Tree::Handle root, const SymbolTable& symbols, std::ostream& stream)
+    {
+        struct Visit
+        {
+            typename Tree::Handle node;
+            std::size_t next;
+        };
+
+        std::vector<Visit> visits;
+        typename Tree::Handle node = root;
+
+        for(;;)
+        {
+            if(tree.getType(node) == NodeType::NT_IDENTIFIER)
+                stream << symbols.getName(tree.getSlot(node));
+            else if(tree.getType(node) == NodeType::NT_LOCAL)
+                stream << "$" << tree.getSlot(node);
+            else if(tree.getType(node) == NodeType::NT_CONST_VALUE)
+                write_value(tree.getValue(node), stream);
+            else
+            {
+                const char* op = spelling(tree.getOperator(node));
+                stream << "(";
+
+                // The name of a call comes first, as a child.
+                if(op)
+                    stream << op;
+                else if(tree.getOperator(node) != Operator::OP_CALL)
+                    stream << string_utils::from(tree.getOperator(node));
+
+                if(tree.getChildCount(node) == 0)
+                    stream << ")";
+                else
+                    visits.push_back(Visit{node, 0});
+            }
+
+            while(!visits.empty() && visits.back().next == tree.getChildCount(visits.back().node))
+            {
+                stream << (tree.getOperator(visits.back().node) == Operator::OP_PROGRAM ? "\n)" : ")");
+                visits.pop_back();
+            }
+
+            if(visits.empty())
+            {
+                stream << std::endl;
+                return;
+            }
+
+            Visit& parent = visits.back();
+
+            // The name of a call is written right after its parenthesis.
+            if(tree.getOperator(parent.node) == Operator::OP_PROGRAM)
+                stream << "\n    ";
+            else if(tree.getOperator(parent.node) != Operator::OP_CALL || parent.next != 0)
+                stream << " ";
+
+            node = tree.getChild(parent.node, parent.next++);
+        }
+    }
+}
+
+Optimizer::Optimizer(SymbolTable* symbols)
+    : m_strings(4 * 1024)
+    , m_ssa(symbols)
+    , m_ssaEnabled(false)
+    , m_folded(0)
+    , m_reduced(0)
+{}
+
+Node* Optimizer::optimize(Node* root)
+{
+    root = fold(root);
+
+    if(!m_ssaEnabled)
+        return root;
+
+    root = m_ssa.optimize(root);
+
+    // The constants written in place of their variables may fold in turn, (+ x 1) => 3 for x of 2, or reduce (/ y x).
+    return m_ssa.hasPropagatedConstants() ? fold(root) : root;
+}
+
+void Optimizer::optimize(FlatAst& ast)
+{
+    fold(ast);
+
+    if(!m_ssaEnabled)
+        return;
+
+    m_ssa.optimize(ast);
+
+    if(m_ssa.hasPropagatedConstants())
+        fold(ast);
+}
+
+Node* Optimizer::fold(Node* root)
+{
+    // The expressions whose operands are being simplified, innermost last.
+    struct Visit
+    {
+        Node* node;
+        std::size_t next;
+    };
+
+    std::vector<Visit> visits(1, Visit{root, 0});
+
+    for(;;)
+    {
+        Node* node = visits.back().node;
+
+        // The leaves are left as they are.
+        if(node->getType() == NodeType::NT_EXPRESSION && visits.back().next < node->getChildren().size())
+        {
+            Node* child = node->getChildren()[visits.back().next++];
+
+            if(child->getType() == NodeType::NT_EXPRESSION)
+                visits.push_back(Visit{child, 0});
+
+            continue;
+        }
+
+        Node* simplified = simplify(node);
+        visits.pop_back();
+
+        if(visits.empty())
+            return simplified;
+
+        if(simplified != node)
+            visits.back().node->setChild(visits.back().next - 1, simplified);
+    }
+}
+
+void Optimizer::fold(FlatAst& ast)
+{
+    // The children come first : each expression is simplified once its operands are.
+    for(NodeIndex index(0) ; index < ast.size() ; ++index)
+    {
+        if(ast.getType(index) == NodeType::NT_EXPRESSION)
+            simplify(ast, index);
+    }
+}
+
+void Optimizer::setSsa(bool enabled)
+{
+    m_ssaEnabled = enabled;
+}
+
+void Optimizer::clear()
+{
+    m_strings.clear();
+    m_ssa.clear();
+}
+
+std::size_t Optimizer::getFoldedCount() const
+{
+    return m_folded;
+}
+
+std::size_t Optimizer::getReducedCount() const
+{
+    return m_reduced;
+}
+
+std::size_t Optimizer::getSavedCount() const
+{
+    return m_ssa.getSavedCount();
+}
+
+std::size_t Optimizer::getEliminatedCount() const
+{
+    return m_ssa.getEliminatedCount();
+}
+
+bool Optimizer::isPure(Operator op)
+{
+    return op == Operator::OP_TO_NUMERIC || op == Operator::OP_TO_STRING || (op >= Operator::OP_ADD && op <= Operator::OP_SQUARE);
+}
+
+void Optimizer::dump(const Node* root, const SymbolTable& symbols, std::ostream& stream)
+{
+    write_tree(PointerTree(), root, symbols, stream);
+}
+
+void Optimizer::dump(const FlatAst& ast, const SymbolTable& symbols, std::ostream& stream)
+{
+    write_tree(FlatTree{ast}, ast.getRoot(), symbols, stream);
+}
+
+Node* Optimizer::simplify(Node* node)
+{
+    Operator op = node->getOperator();
+    NodeList children = node->getChildren();
+
+    if(node->getType() != NodeType::NT_EXPRESSION || children.empty())
+        return node;
+
+    if(op == Operator::OP_IF && (children.size() == 2 || children.size() == 3) && children[0]->getType() == NodeType::NT_CONST_VALUE)
+    {
+        bool alternative = !Runtime::isTrue(children[0]->getValue());
+
+        if(alternative && children.size() == 2)
+        {
+            ++m_folded;
+            setConstant(node, Value());
+        }
+        else if(can_replace(children[alternative ? 2 : 1]->getType()))
+        {
+            ++m_folded;
+            return children[alternative ? 2 : 1];
+        }
+
+        return node;
+    }
+
+    if(!isPure(op))
+        return node;
+
+    std::size_t constants(0);
+
+    while(constants < children.size() && children[constants]->getType() == NodeType::NT_CONST_VALUE)
+        ++constants;
+
+    Value value;
+
+    if(constants == children.size())
+    {
+        if(evaluate(node, value))
+        {
+            ++m_folded;
+            setConstant(node, value);
+        }
+
+        return node;
+    }
+
+    if(is_fold(op) && constants >= 2)
+    {
+        // Evaluated apart, the last of the leading constants becomes their value.
+        m_operands.assign(children.begin(), children.begin() + constants);
+
+        Node head(op);
+        head.setChildren(m_operands.data(), m_operands.size());
+
+        if(!evaluate(&head, value))
+            return node;
+
+        setConstant(children[constants - 1], value);
+        node->removeFirstChildren(constants - 1);
+        children = node->getChildren();
+
+        ++m_folded;
+    }
+
+    // (/ (sin x) 2 4) => (* (sin x) 0.5 0.25).
+    if(op == Operator::OP_DIV && children.size() >= 2
+       && is_known_numeric(children[0]->getType(), children[0]->getValueType(), children[0]->getOperator()))
+    {
+        for(Node* const* divisor = children.begin() + 1 ; divisor != children.end() ; ++divisor)
+        {
+            if((*divisor)->getType() != NodeType::NT_CONST_VALUE || !has_exact_reciprocal((*divisor)->getValue()))
+                return node;
+        }
+
+        for(Node* const* divisor = children.begin() + 1 ; divisor != children.end() ; ++divisor)
+            setConstant(*divisor, Value(1.f / (*divisor)->getValue().numeric));
+
+        node->setOperator(Operator::OP_MUL);
+
+        ++m_reduced;
+    }
+
+    // (^ x 2) => (square x).
+    if(op == Operator::OP_POW && children.size() == 2 && children[1]->getType() == NodeType::NT_CONST_VALUE
+       && is_two(children[1]->getValue()))
+    {
+        node->setOperator(Operator::OP_SQUARE);
+        node->removeLastChildren(1);
+
+        ++m_reduced;
+    }
+
+    return node;
+}
+
+void Optimizer::simplify(FlatAst& ast, NodeIndex index)
+{
+    Operator op = ast.getOperator(index);
+
+    // No node is added : the children stay in place.
+    const NodeIndex* children = ast.getChildren(index);
+    std::uint32_t count = ast.getChildCount(index);
+
+    if(count == 0)
+        return;
+
+    if(op == Operator::OP_IF && (count == 2 || count == 3) && ast.getType(children[0]) == NodeType::NT_CONST_VALUE)
+    {
+        bool alternative = !Runtime::isTrue(ast.getLiteral(children[0]));
+
+        if(alternative && count == 2)
+        {
+            ++m_folded;
+            ast.setConstant(index, Value());
+        }
+        else if(can_replace(ast.getType(children[alternative ? 2 : 1])))
+        {
+            ++m_folded;
+            ast.replace(index, children[alternative ? 2 : 1]);
+        }
+
+        return;
+    }
+
+    if(!isPure(op))
+        return;
+
+    std::uint32_t constants(0);
+
+    while(constants < count && ast.getType(children[constants]) == NodeType::NT_CONST_VALUE)
+        ++constants;
+
+    Value value;
+
+    if(constants == count)
+    {
+        if(!evaluate(ast, index, value))
+            return;
+
+        ++m_folded;
+        ast.setConstant(index, value);
+        return;
+    }
+
+    if(is_fold(op) && constants >= 2)
+    {
+        // Evaluated apart, the last of the leading constants becomes their value.
+        FlatAst head;
+        std::vector<NodeIndex> operands;
+
+        for(std::uint32_t i(0) ; i < constants ; ++i)
+            operands.push_back(head.addConstant(ast.getLiteral(children[i])));
+
+        if(!evaluate(head, head.addExpression(op, operands.data(), operands.size()), value))
+            return;
+
+        ast.setConstant(children[constants - 1], value);
+        ast.removeFirstChildren(index, constants - 1);
+
+        children = ast.getChildren(index);
+        count = ast.getChildCount(index);
+
+        ++m_folded;
+    }
+
+    // (/ (sin x) 2 4) => (* (sin x) 0.5 0.25).
+    if(op == Operator::OP_DIV && count >= 2
+       && is_known_numeric(ast.getType(children[0]), ast.getType(children[0]) == NodeType::NT_CONST_VALUE ? ast.getLiteral(children[0]).type : ValueType::VT_NONE,
+                           ast.getOperator(children[0])))
+    {
+        for(std::uint32_t i(1) ; i < count ; ++i)
+        {
+            if(ast.getType(children[i]) != NodeType::NT_CONST_VALUE || !has_exact_reciprocal(ast.getLiteral(children[i])))
+                return;
+        }
+
+        for(std::uint32_t i(1) ; i < count ; ++i)
+            ast.setConstant(children[i], Value(1.f / ast.getLiteral(children[i]).numeric));
+
+        ast.setOperator(index, Operator::OP_MUL);
+
+        ++m_reduced;
+    }
+
+    // (^ x 2) => (square x).
+    if(op == Operator::OP_POW && count == 2 && ast.getType(children[1]) == NodeType::NT_CONST_VALUE && is_two(ast.getLiteral(children[1])))
+    {
+        ast.setOperator(index, Operator::OP_SQUARE);
+        ast.removeLastChildren(index, 1);
+
+        ++m_reduced;
+    }
+}
+
+bool Optimizer::evaluate(Node* node, Value& value)
+{
+    // The error is left to the evaluation of the program, when it reaches the expression.
+    try
+    {
+        value = m_runtime.eval(node);
+    }
+    catch(const errors::runtime_exception&)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool Optimizer::evaluate(FlatAst& ast, NodeIndex index, Value& value)
+{
+    try
+    {
+        value = m_runtime.eval(ast, index);
+    }
+    catch(const errors::runtime_exception&)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+void Optimizer::setConstant(Node* node, const Value& value)
+{
+    if(value.type == ValueType::VT_NUMERIC)
+        *node = Node(value.numeric);
+    else if(value.type == ValueType::VT_STRING)
+        *node = Node(m_strings, value.string->getData(), value.string->getSize());
+    else
+        *node = Node();
+}
@@ -0,0 +1,116 @@
+/*
+	optimizer.hpp
+
+	The MIT License (MIT)
+
+	Copyright (c) 2014 Maxime Alvarez
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+	Defines the pass simplifying the AST between the parser and the evaluation.
+*/
+
+#ifndef OPTIMIZER_HPP_INCLUDED
+#define OPTIMIZER_HPP_INCLUDED
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+#include "arena.hpp"
+#include "datatypes.hpp"
+#include "flat_ast.hpp"
+#include "runtime.hpp"
+#include "ssa.hpp"
+#include "symbol_table.hpp"
+
+/// Rewrites the expressions whose value is known before the evaluation, bottom-up and without recursion :
+///  - a pure built-in (the maths operators, to_numeric and to_string) of constants becomes its value,
+///    (* 2 3.14159) => 6.28318, and the leading constants of a left fold are folded, (+ 1 2 x) => (+ 3 x),
+///  - (if constant then [else]) becomes its chosen branch,
+///  - a division of a number by powers of two becomes a multiplication by their reciprocals, (/ (sin x) 4) =>
+///    (* (sin x) 0.25), which rounds exactly as the original, unlike other divisors. The dividend has to be known
+///    to be a number, a numeric constant or an operator giving one : the type of a variable is not known before
+///    the evaluation, and a string would make the error name mul instead of div.
+///  - a square becomes a multiplication of its operand by itself, (^ x 2) => (square x), evaluated once and failing
+///    as the power does. The other exponents are left : their products would be rounded more than once.
+/// An expression failing on its constants is left as it is, to fail at run time.
+/// With setSsa, the statements of a program then go through their static single assignment form, see ssa.hpp, and
+/// the constants it propagates in expressions are folded in turn.
+class Optimizer
+{
+    public:
+        // The temporaries of the common subexpressions are interned in the symbols, none is introduced without them.
+        explicit Optimizer(SymbolTable* symbols = nullptr);
+
+        // The trees are rewritten in place, a variable may become the leaf of two expressions. The new root of
+        // a pointer tree is returned, the text of its folded strings lives in the optimizer which has to outlive it.
+        Node* optimize(Node* root);
+        void optimize(FlatAst& ast);
+
+        // Remove the redundant evaluations and assignments of the program as well, off by default : the pass is global
+        // and costs more than the evaluation of a straight-line program without redundancy.
+        void setSsa(bool enabled);
+
+        // Release the folded strings and the new nodes, the trees rewritten so far must not be used anymore.
+        void clear();
+
+        // The number of expressions folded in constants or in their branch, and of those strength reduced.
+        std::size_t getFoldedCount() const;
+        std::size_t getReducedCount() const;
+        // The number of evaluations replaced by the read of a variable, and of statements removed.
+        std::size_t getSavedCount() const;
+        std::size_t getEliminatedCount() const;
+
+        // The built-ins without effects, whose value only depends on their operands.
+        static bool isPure(Operator op);
+
+        // Write the tree in its parenthesized form, one statement of the program per line.
+        static void dump(const Node* root, const SymbolTable& symbols, std::ostream& stream);
+        static void dump(const FlatAst& ast, const SymbolTable& symbols, std::ostream& stream);
+
+    protected:
+        // Simplify the expressions bottom-up.
+        Node* fold(Node* root);
+        void fold(FlatAst& ast);
+
+        // Rewrite an expression whose operands are simplified already, a pointer tree may replace it by a branch.
+        Node* simplify(Node* node);
+        void simplify(FlatAst& ast, NodeIndex index);
+
+        // The value of an expression of constants, false if it fails.
+        bool evaluate(Node* node, Value& value);
+        bool evaluate(FlatAst& ast, NodeIndex index, Value& value);
+
+        // Turn the node into a constant.
+        void setConstant(Node* node, const Value& value);
+
+        // Evaluates the constant expressions, which do not read variables nor call functions.
+        Runtime m_runtime;
+        Arena m_strings;
+        // The leading constants of a fold, evaluated apart.
+        std::vector<Node*> m_operands;
+
+        Ssa m_ssa;
+        bool m_ssaEnabled;
+
+        std::size_t m_folded;
+        std::size_t m_reduced;
+};
+
+#endif // OPTIMIZER_HPP_INCLUDED
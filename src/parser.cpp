@@ -1,157 +1,377 @@
 #include "parser.hpp"
 #include "errors.hpp"
 
-Parser::Parser(Lexer& lexer)
+namespace
+{
+    // Builds the pointer tree in the arena.
+    class TreeBuilder
+    {
+        public:
+            typedef Node* Handle;
+
+            TreeBuilder(Arena& arena)
+                : m_arena(&arena)
+            {}
+
+            Node* numeric(float value)
+            {
+                return m_arena->create<Node>(value);
+            }
+
+            Node* string(const char* text, std::size_t length, bool escaped)
+            {
+                return m_arena->create<Node>(*m_arena, text, length, escaped);
+            }
+
+            Node* identifier(Symbol symbol)
+            {
+                return m_arena->create<Node>(symbol);
+            }
+
+            Node* null()
+            {
+                return m_arena->create<Node>();
+            }
+
+            // The children are the pending nodes from first.
+            Node* expression(Operator op, std::size_t first)
+            {
+                std::size_t count = pending.size() - first;
+
+                Node* expression = m_arena->create<Node>(op);
+                expression->setChildren(m_arena->copy(pending.data() + first, count), count);
+
+                pending.resize(first);
+                return expression;
+            }
+
+            // Around a parenthesized form, at the index of its '(' and ')' tokens.
+            void open(std::size_t)
+            {}
+
+            void close(Node*, std::size_t)
+            {}
+
+            // A child of the top-level (program ...) form, complete : return true to take it out of the tree.
+            bool statement(Node*)
+            {
+                return false;
+            }
+
+            // Children of the expressions being parsed, copied in the arena once complete.
+            std::vector<Node*> pending;
+
+        protected:
+            Arena* m_arena;
+    };
+
+    // Builds the flat AST.
+    class FlatBuilder
+    {
+        public:
+            typedef NodeIndex Handle;
+
+            FlatBuilder(FlatAst& ast)
+                : m_ast(ast)
+            {}
+
+            NodeIndex numeric(float value)
+            {
+                return m_ast.addNumeric(value);
+            }
+
+            NodeIndex string(const char* text, std::size_t length, bool escaped)
+            {
+                return m_ast.addString(text, length, escaped);
+            }
+
+            NodeIndex identifier(Symbol symbol)
+            {
+                return m_ast.addIdentifier(symbol);
+            }
+
+            NodeIndex null()
+            {
+                return m_ast.addNull();
+            }
+
+            // The children are the pending nodes from first.
+            NodeIndex expression(Operator op, std::size_t first)
+            {
+                NodeIndex expression = m_ast.addExpression(op, pending.data() + first, pending.size() - first);
+
+                pending.resize(first);
+                return expression;
+            }
+
+            void open(std::size_t)
+            {}
+
+            void close(NodeIndex, std::size_t)
+            {}
+
+            bool statement(NodeIndex)
+            {
+                return false;
+            }
+
+            // Children of the expressions being parsed, copied in the children array once complete.
+            std::vector<NodeIndex> pending;
+
+        protected:
+            FlatAst& m_ast;
+    };
+
+    // Builds the pointer tree and gives its parenthesized forms to the sink.
+    class FormBuilder : public TreeBuilder
+    {
+        public:
+            FormBuilder(Arena& arena, FormSink& sink)
+                : TreeBuilder(arena)
+                , m_sink(sink)
+            {}
+
+            void open(std::size_t token)
+            {
+                // Nothing is pending between the '(' of the enclosing form and its first child.
+                m_sink.open(token, m_firstChildren.empty() ? 0 : pending.size() - m_firstChildren.back());
+                m_firstChildren.push_back(pending.size());
+            }
+
+            void close(Node* node, std::size_t token)
+            {
+                m_firstChildren.pop_back();
+                m_sink.close(node, token);
+            }
+
+        protected:
+            FormSink& m_sink;
+
+            // Pending children before those of each open form.
+            std::vector<std::size_t> m_firstChildren;
+    };
+
+    // Builds the pointer tree without the statements of the top-level program, given to the sink instead.
+    class StatementBuilder : public TreeBuilder
+    {
+        public:
+            StatementBuilder(Arena& arena, StatementSink& sink)
+                : TreeBuilder(arena)
+                , m_sink(sink)
+            {}
+
+            bool statement(Node* node)
+            {
+                m_arena = &m_sink.take(node);
+                return true;
+            }
+
+        protected:
+            StatementSink& m_sink;
+    };
+}
+
+Parser::Parser(Lexer& lexer, Arena& arena)
     : m_lexer(lexer)
+    , m_arena(arena)
 {
 }
 
 Node* Parser::parse()
 {
-    return getExpression();
+    TreeBuilder builder(m_arena);
+    return getExpression(builder);
 }
 
-Token Parser::match(TokenType type)
+Node* Parser::parse(FormSink& sink)
 {
-    Token token = m_lexer.getLook();
-
-    if(m_lexer.getLook().type == type)
-        m_lexer.getNext();
-    else
-        errors::parserError("expected " + string_utils::from(type));
+    FormBuilder builder(m_arena, sink);
+    return getExpression(builder);
+}
 
-    return token;
+Node* Parser::parse(StatementSink& sink)
+{
+    StatementBuilder builder(m_arena, sink);
+    return getExpression(builder);
 }
 
-Token Parser::match(const std::string& value)
+FlatAst Parser::parseFlat()
 {
-    Token token = m_lexer.getLook();
+    FlatAst ast;
+    FlatBuilder builder(ast);
+
+    ast.setRoot(getExpression(builder));
+    return ast;
+}
 
-    if(m_lexer.getLook().value == value)
+void Parser::match(TokenType type)
+{
+    if(m_lexer.getLook().type == type)
         m_lexer.getNext();
     else
-        errors::parserError("expected " + value);
-
-    return token;
+        errors::parserError("expected " + string_utils::from(type));
 }
 
-std::string Parser::getIdentifier()
+// The text of a token is always read before matching it : in pull mode, it does not survive getNext().
+template<typename Builder>
+typename Builder::Handle Parser::getIdentifier(Builder& builder)
 {
-    Token identifier = match(TokenType::TT_IDENTIFIER);
-    return identifier.value;
+    typename Builder::Handle node = builder.identifier(m_lexer.getLook().symbol);
+
+    match(TokenType::TT_IDENTIFIER);
+    return node;
 }
 
-std::string Parser::getString()
+template<typename Builder>
+typename Builder::Handle Parser::getString(Builder& builder)
 {
-    Token string = match(TokenType::TT_STRING);
-    return string.value;
+    const Token& string = m_lexer.getLook();
+    typename Builder::Handle node = builder.string(m_lexer.getText(string), string.length, string.escaped);
+
+    match(TokenType::TT_STRING);
+    return node;
 }
 
 float Parser::getNumeric()
 {
-    Token numeric = match(TokenType::TT_NUMERIC);
-    return string_utils::to<float>(numeric.value);
+    const Token& look = m_lexer.getLook();
+    const char* text = m_lexer.getText(look);
+    float numeric = string_utils::parseFloat(text, text + look.length);
+
+    match(TokenType::TT_NUMERIC);
+    return numeric;
 }
 
 Operator Parser::getOperator()
 {
-    Token op = match(TokenType::TT_OPERATOR);
+    Operator op = m_lexer.getLook().op;
 
-    if(operatorsTable.find(op.value) != operatorsTable.end())
-       return operatorsTable.at(op.value);
-    else
-        return Operator::OP_NONE;
+    match(TokenType::TT_OPERATOR);
+    return op;
 }
 
-std::string Parser::getNull()
+void Parser::getNull()
 {
-    Token null_token = match(TokenType::TT_NULL);
-    return null_token.value;
+    match(TokenType::TT_NULL);
 }
 
-Node* Parser::getExpression()
+bool Parser::isAtom(TokenType type) const
 {
-    if(m_lexer.getLook().type == TokenType::TT_LEFT_PAR)
-    {
-        match(TokenType::TT_LEFT_PAR);
-
-        if(m_lexer.getLook().type == TokenType::TT_NUMERIC)
-        {
-            Node* tempNode = new Node(getNumeric());
-            match(TokenType::TT_RIGHT_PAR);
-
-            return tempNode;
-        }
-        else if(m_lexer.getLook().type == TokenType::TT_STRING)
-        {
-            Node* tempNode = new Node(getString(), NodeType::NT_CONST_VALUE);
-            match(TokenType::TT_RIGHT_PAR);
-
-            return tempNode;
-        }
-        else if(m_lexer.getLook().type == TokenType::TT_IDENTIFIER)
-        {
-            Node* tempNode = new Node(getIdentifier(), NodeType::NT_IDENTIFIER);
-            match(TokenType::TT_RIGHT_PAR);
-
-            return tempNode;
-        }
-        else if(m_lexer.getLook().type == TokenType::TT_NULL)
-        {
-            Node* tempNode = new Node(NodeType::NT_CONST_VALUE, Operator::OP_NONE, Value());
-            match(TokenType::TT_RIGHT_PAR);
-
-            return tempNode;
-        }
-        else
-        {
-            Operator op = getOperator();
-            std::vector<Node*> children = getExpressionList();
-
-            Node* expression = new Node(op);
-
-            for(Node* child : children)
-                expression->addChild(child);
-
-            match(TokenType::TT_RIGHT_PAR);
+    return type == TokenType::TT_NUMERIC || type == TokenType::TT_STRING || type == TokenType::TT_IDENTIFIER || type == TokenType::TT_NULL;
+}
 
-            return expression;
-        }
-    }
-    else if(m_lexer.getLook().type == TokenType::TT_NUMERIC)
+template<typename Builder>
+typename Builder::Handle Parser::getAtom(Builder& builder)
+{
+    if(m_lexer.getLook().type == TokenType::TT_NUMERIC)
     {
-        return new Node(getNumeric());
+        return builder.numeric(getNumeric());
     }
     else if(m_lexer.getLook().type == TokenType::TT_STRING)
     {
-        return new Node(getString(), NodeType::NT_CONST_VALUE);
+        return getString(builder);
     }
     else if(m_lexer.getLook().type == TokenType::TT_IDENTIFIER)
     {
-        return new Node(getIdentifier(), NodeType::NT_IDENTIFIER);
+        return getIdentifier(builder);
     }
     else if(m_lexer.getLook().type == TokenType::TT_NULL)
     {
         // For a call to match.
         getNull();
-        return new Node(NodeType::NT_CONST_VALUE, Operator::OP_NONE, Value());
+        return builder.null();
     }
     else
     {
-        errors::parserError("unexpected token \"" + m_lexer.getLook().value + "\"");
+        errors::parserError("unexpected token \"" + m_lexer.getString(m_lexer.getLook()) + "\"");
 
         // Totally useless, since errors::parserError() calls abort() which calls std::exit().
         // But the compiler keep throwing a warning for non-returning in a non-void function.
-        return nullptr;
+        return typename Builder::Handle();
     }
 }
 
-std::vector<Node*> Parser::getExpressionList()
+template<typename Builder>
+typename Builder::Handle Parser::getExpression(Builder& builder)
 {
-    std::vector<Node*> nodes;
+    // The operator forms being parsed, innermost last, with the index of their first child in the pending nodes.
+    struct Open
+    {
+        Operator op;
+        std::size_t first;
+    };
+
+    std::vector<Open> opened;
+
+    for(;;)
+    {
+        typename Builder::Handle node = typename Builder::Handle();
+        bool complete = true;
+
+        // Shift : a '(' opens an operator form, a function definition or call, or surrounds a single atom.
+        if(m_lexer.getLook().type == TokenType::TT_LEFT_PAR)
+        {
+            builder.open(m_lexer.getPosition());
+            match(TokenType::TT_LEFT_PAR);
+
+            if(m_lexer.getLook().type == TokenType::TT_IDENTIFIER)
+            {
+                // (name arguments...) : the name is the first child. Without arguments, the runtime reads
+                // the variable if there is no such function, as (name) always did.
+                opened.push_back(Open{Operator::OP_CALL, builder.pending.size()});
+                builder.pending.push_back(getIdentifier(builder));
+                complete = false;
+            }
+            else if(m_lexer.getLook().type == TokenType::TT_FUNCTION)
+            {
+                // (function name parameters... body) : checked by the runtime, like the other forms.
+                match(TokenType::TT_FUNCTION);
 
-    while(m_lexer.getLook().type != TokenType::TT_RIGHT_PAR && !m_lexer.isEmpty())
-        nodes.push_back(getExpression());
+                opened.push_back(Open{Operator::OP_FUNCTION, builder.pending.size()});
+                complete = false;
+            }
+            else if(isAtom(m_lexer.getLook().type))
+            {
+                node = getAtom(builder);
 
-    return nodes;
+                builder.close(node, m_lexer.getPosition());
+                match(TokenType::TT_RIGHT_PAR);
+            }
+            else
+            {
+                Operator op = getOperator();
+
+                opened.push_back(Open{op, builder.pending.size()});
+                complete = false;
+            }
+        }
+        else
+            node = getAtom(builder);
+
+        for(;;)
+        {
+            if(complete)
+            {
+                if(opened.empty())
+                    return node;
+
+                // The builder may take the statements of the top-level program out of the tree.
+                if(opened.size() > 1 || opened.back().op != Operator::OP_PROGRAM || !builder.statement(node))
+                    builder.pending.push_back(node);
+            }
+
+            // Reduce : the innermost form, once its children have all been parsed.
+            if(m_lexer.getLook().type != TokenType::TT_RIGHT_PAR && !m_lexer.isEmpty())
+                break;
+
+            Open form = opened.back();
+            opened.pop_back();
+
+            node = builder.expression(form.op, form.first);
+            complete = true;
+
+            builder.close(node, m_lexer.getPosition());
+            match(TokenType::TT_RIGHT_PAR);
+        }
+    }
 }
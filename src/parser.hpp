@@ -28,31 +28,77 @@
 #ifndef PARSER_HPP_INCLUDED
 #define PARSER_HPP_INCLUDED
 
+#include <cstdint>
 #include <vector>
 
+#include "arena.hpp"
+#include "flat_ast.hpp"
 #include "lexer.hpp"
 
+/// Receives the parenthesized forms of a tree in order of their opening, see Parser::parse(sink).
+class FormSink
+{
+    public:
+        virtual ~FormSink() = default;
+
+        // Index of the '(' token of a form, and of its node in the children of the enclosing form.
+        virtual void open(std::size_t token, std::size_t child) = 0;
+        // Node of the innermost open form, and index of its ')' token.
+        virtual void close(Node* node, std::size_t token) = 0;
+};
+
+/// Receives the statements of a top-level (program ...) form, see Parser::parse(sink).
+class StatementSink
+{
+    public:
+        virtual ~StatementSink() = default;
+
+        // Take a complete statement, return the arena of the next nodes.
+        virtual Arena& take(Node* statement) = 0;
+};
+
 class Parser
 {
     public:
-        Parser(Lexer& lexer);
+        // The nodes are allocated in the arena and live as long as it does.
+        Parser(Lexer& lexer, Arena& arena);
 
         Node* parse();
+        FlatAst parseFlat();
+
+        // Parse giving the parenthesized forms to the sink. Batch and incremental lexer modes only.
+        Node* parse(FormSink& sink);
+
+        // Parse giving each statement of a top-level (program ...) form to the sink as soon as it is complete,
+        // instead of adding it to the tree : the program node returned has no children.
+        // Any other root is returned whole.
+        Node* parse(StatementSink& sink);
 
     protected:
-        Token match(TokenType type);
-        Token match(const std::string& value);
+        void match(TokenType type);
 
-        std::string getIdentifier();
-        std::string getString();
+        // The tokens are consumed in place, their text is read through the lexer.
+        template<typename Builder>
+        typename Builder::Handle getIdentifier(Builder& builder);
+        template<typename Builder>
+        typename Builder::Handle getString(Builder& builder);
         float getNumeric();
         Operator getOperator();
-        std::string getNull();
-        Node* getExpression();
-        std::vector<Node*> getExpressionList();
+        void getNull();
+
+        // A numeric, string, identifier or null token.
+        bool isAtom(TokenType type) const;
+        template<typename Builder>
+        typename Builder::Handle getAtom(Builder& builder);
+
+        // The builder creates the nodes : a pointer tree for parse(), a flat AST for parseFlat().
+        // No recursion : the nesting depth is only limited by the memory.
+        template<typename Builder>
+        typename Builder::Handle getExpression(Builder& builder);
 
     protected:
-        Lexer m_lexer;
+        Lexer& m_lexer;
+        Arena& m_arena;
 };
 
 #endif // PARSER_HPP_INCLUDED
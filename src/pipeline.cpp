@@ -0,0 +1,167 @@
+#include "pipeline.hpp"
+#include "lexer.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    // Thrown on the producer thread to stop parsing once the consumer is gone.
+    struct Stopped
+    {};
+}
+
+const std::size_t Pipeline::maxBatchStatements;
+const std::size_t Pipeline::maxQueuedBatches;
+
+Pipeline::Pipeline(const char* source, std::size_t size)
+    : m_source(source)
+    , m_size(size)
+    , m_declaredSymbols(0)
+    , m_arena(new Arena())
+    , m_batchStatements(1)
+    , m_handedBatches(0)
+    , m_done(false)
+    , m_stopped(false)
+    , m_thread(&Pipeline::produce, this)
+{
+    m_current.root = nullptr;
+}
+
+Pipeline::~Pipeline()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopped = true;
+    }
+
+    m_changed.notify_all();
+    m_thread.join();
+}
+
+Node* Pipeline::next(SymbolTable& symbols)
+{
+    if(m_current.arena)
+        m_current.arena->clear();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if(m_current.arena)
+    {
+        m_freeArenas.push_back(std::move(m_current.arena));
+        m_changed.notify_all();
+    }
+
+    m_changed.wait(lock, [this] { return !m_batches.empty() || m_done; });
+
+    if(m_batches.empty())
+    {
+        if(m_error)
+            std::rethrow_exception(m_error);
+
+        return nullptr;
+    }
+
+    m_current = std::move(m_batches.front());
+    m_batches.pop_front();
+    m_changed.notify_all();
+
+    lock.unlock();
+
+    for(const std::string& name : m_current.symbols)
+        symbols.intern(name.data(), name.size());
+
+    return m_current.root;
+}
+
+void Pipeline::produce()
+{
+    std::exception_ptr error;
+
+    try
+    {
+        try
+        {
+            // Pull mode : the tokens are cut while parsing, the memory does not grow with the source.
+            Lexer lexer(m_source, m_size, m_symbols, Lexer::Mode::PULL);
+            lexer.lex();
+
+            Parser parser(lexer, *m_arena);
+            Node* root = parser.parse(*this);
+
+            // A root which is not a program, or a program without statements which fails as usual.
+            if(m_statements.empty() && m_handedBatches == 0)
+                handOver(root);
+        }
+        catch(const Stopped&)
+        {
+            throw;
+        }
+        catch(...)
+        {
+            error = std::current_exception();
+        }
+
+        // The statements parsed before the end of the program, or before the error.
+        if(!m_statements.empty())
+            flush();
+    }
+    catch(const Stopped&)
+    {}
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_error = error;
+    m_done = true;
+    m_changed.notify_all();
+}
+
+Arena& Pipeline::take(Node* statement)
+{
+    m_statements.push_back(statement);
+
+    if(m_statements.size() >= m_batchStatements)
+    {
+        flush();
+        m_batchStatements = std::min(m_batchStatements * 2, maxBatchStatements);
+    }
+
+    return *m_arena;
+}
+
+void Pipeline::flush()
+{
+    Node* program = m_arena->create<Node>(Operator::OP_PROGRAM);
+    program->setChildren(m_arena->copy(m_statements.data(), m_statements.size()), m_statements.size());
+
+    m_statements.clear();
+    handOver(program);
+}
+
+void Pipeline::handOver(Node* root)
+{
+    Batch batch;
+    batch.root = root;
+    batch.arena = std::move(m_arena);
+
+    for( ; m_declaredSymbols < m_symbols.size() ; ++m_declaredSymbols)
+        batch.symbols.push_back(m_symbols.getName(static_cast<Symbol>(m_declaredSymbols)));
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_changed.wait(lock, [this] { return m_batches.size() < maxQueuedBatches || m_stopped; });
+
+    if(m_stopped)
+        throw Stopped();
+
+    m_batches.push_back(std::move(batch));
+    ++m_handedBatches;
+
+    // The arena of the next statements, one of an evaluated batch when there is one.
+    if(m_freeArenas.empty())
+        m_arena.reset(new Arena());
+    else
+    {
+        m_arena = std::move(m_freeArenas.back());
+        m_freeArenas.pop_back();
+    }
+
+    m_changed.notify_all();
+}
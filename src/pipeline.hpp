@@ -0,0 +1,118 @@
+/*
+	pipeline.hpp
+
+	The MIT License (MIT)
+
+	Copyright (c) 2014 Maxime Alvarez
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+	Defines the front end lexing and parsing on another thread, ahead of the evaluation.
+*/
+
+#ifndef PIPELINE_HPP_INCLUDED
+#define PIPELINE_HPP_INCLUDED
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "arena.hpp"
+#include "parser.hpp"
+#include "symbol_table.hpp"
+
+/// Lexes and parses a source on a producer thread. The statements of a top-level (program ...) form
+/// are handed over in batches as soon as they are parsed, each batch in its own arena which is reused
+/// once the batch has been evaluated : the first statements run before the next ones are even read,
+/// and the memory does not grow with the number of statements.
+class Pipeline : protected StatementSink
+{
+    public:
+        // The source must outlive the pipeline.
+        Pipeline(const char* source, std::size_t size);
+        ~Pipeline();
+
+        Pipeline(const Pipeline&) = delete;
+        Pipeline& operator=(const Pipeline&) = delete;
+
+        // Release the previous batch and wait for the next one : a (program ...) node of the next statements,
+        // the whole tree if the root is not a program, nullptr at the end. Its new identifiers are interned
+        // in the symbols first, in order : they get the same symbols as in the table of the producer.
+        // The lexer and parser errors are thrown once the statements before them have been handed over.
+        Node* next(SymbolTable& symbols);
+
+    protected:
+        struct Batch
+        {
+            Node* root;
+            std::unique_ptr<Arena> arena;
+
+            // Names of the symbols interned since the previous batch.
+            std::vector<std::string> symbols;
+        };
+
+        /** Producer thread. */
+        void produce();
+
+        Arena& take(Node* statement) override;
+
+        // Hand the pending statements over in a program node.
+        void flush();
+        void handOver(Node* root);
+
+    protected:
+        // The first batch has a single statement, for the first one to run at once,
+        // the next ones twice as many as the previous one up to the maximum.
+        static const std::size_t maxBatchStatements = 1024;
+        static const std::size_t maxQueuedBatches = 4;
+
+        const char* m_source;
+        std::size_t m_size;
+
+        /** Owned by the producer. */
+        SymbolTable m_symbols;
+        std::size_t m_declaredSymbols;
+
+        std::unique_ptr<Arena> m_arena;
+        std::vector<Node*> m_statements;
+        std::size_t m_batchStatements;
+        std::size_t m_handedBatches;
+
+        /** Shared, under the mutex. */
+        std::mutex m_mutex;
+        std::condition_variable m_changed;
+
+        std::deque<Batch> m_batches;
+        std::vector<std::unique_ptr<Arena>> m_freeArenas;
+
+        std::exception_ptr m_error;
+        bool m_done;
+        bool m_stopped;
+
+        /** Owned by the consumer : the batch being evaluated. */
+        Batch m_current;
+
+        std::thread m_thread;
+};
+
+#endif // PIPELINE_HPP_INCLUDED
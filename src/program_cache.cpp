@@ -0,0 +1,526 @@
+#include "program_cache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+
+#include "function.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+    #define PROGRAM_CACHE_MMAP
+
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace
+{
+    // Bump when the bytecode or the layout of the files changes, for the old files to be ignored.
+    const std::uint64_t formatVersion = 7;
+
+    const char magic[8] = {'e', '-', 'l', 'a', 'n', 'g', 'b', 'c'};
+
+    // Followed by the units, their instructions, an entry per constant and message of the units then per
+    // symbol, the symbols of the locals and of the callees of the functions, and the characters of the entries.
+    struct Header
+    {
+        char magic[8];
+        std::uint64_t version;
+
+        std::uint64_t sourceHash;
+        std::uint64_t sourceSize;
+
+        // Of the bytes after the header : a corrupted file is a miss.
+        std::uint64_t payloadHash;
+
+        std::uint32_t unitCount;
+        std::uint32_t instructionCount;
+        std::uint32_t entryCount;
+        std::uint32_t symbolCount;
+        std::uint32_t localCount;
+        std::uint32_t settings;
+
+        std::uint64_t characterCount;
+    };
+
+    // The code of the program or of a function. The program comes first, the functions defined by a unit
+    // follow it, each one with its own functions.
+    struct Unit
+    {
+        std::uint64_t maxStackSize;
+        std::uint32_t instructionCount;
+        std::uint32_t constantCount;
+        std::uint32_t messageCount;
+        std::uint32_t functionCount;
+
+        // Of a function.
+        std::uint32_t name;
+        std::uint32_t parameterCount;
+        std::uint32_t localCount;
+        std::uint32_t calleeCount;
+        std::uint32_t sideEffects;
+        std::uint32_t padding;
+    };
+
+    // A string of the file, its offset is in the characters.
+    struct Entry
+    {
+        std::uint32_t offset;
+        std::uint32_t length;
+    };
+
+    // The format, the opcodes and the layout of the instructions.
+    std::uint64_t version()
+    {
+        const std::uint64_t values[] =
+        {
+            formatVersion,
+            static_cast<std::uint64_t>(OpCode::OC_RETURN),
+            sizeof(Instruction),
+            sizeof(Header),
+            sizeof(Unit),
+            sizeof(Entry)
+        };
+
+        return ProgramCache::hash(reinterpret_cast<const char*>(values), sizeof(values));
+    }
+
+    std::uint64_t mix(std::uint64_t value)
+    {
+        value ^= value >> 32;
+        value *= 0xD6E8FEB86659FD93ull;
+        value ^= value >> 32;
+
+        return value;
+    }
+
+    void add_entry(std::vector<Entry>& entries, std::string& characters, const char* text, std::size_t length)
+    {
+        Entry entry;
+        entry.offset = static_cast<std::uint32_t>(characters.size());
+        entry.length = static_cast<std::uint32_t>(length);
+
+        entries.push_back(entry);
+        characters.append(text, length);
+    }
+
+    // The sections of a file, in the order of the units.
+    struct Layout
+    {
+        std::vector<Unit> units;
+        std::vector<Instruction> instructions;
+        std::vector<Entry> entries;
+        std::vector<std::uint32_t> locals;
+        std::string characters;
+    };
+
+    bool add_unit(Layout& layout, const Bytecode& bytecode, const Function* function)
+    {
+        Unit unit;
+        std::memset(&unit, 0, sizeof(unit));
+
+        unit.maxStackSize = bytecode.maxStackSize;
+        unit.instructionCount = static_cast<std::uint32_t>(bytecode.code.size());
+        unit.constantCount = static_cast<std::uint32_t>(bytecode.constants.size());
+        unit.messageCount = static_cast<std::uint32_t>(bytecode.messages.size());
+        unit.functionCount = static_cast<std::uint32_t>(bytecode.functions.size());
+
+        if(function)
+        {
+            unit.name = function->name;
+            unit.parameterCount = function->parameterCount;
+            unit.localCount = static_cast<std::uint32_t>(function->locals.size());
+            unit.calleeCount = static_cast<std::uint32_t>(function->callees.size());
+            unit.sideEffects = function->sideEffects;
+
+            layout.locals.insert(layout.locals.end(), function->locals.begin(), function->locals.end());
+            layout.locals.insert(layout.locals.end(), function->callees.begin(), function->callees.end());
+        }
+
+        layout.units.push_back(unit);
+        layout.instructions.insert(layout.instructions.end(), bytecode.code.begin(), bytecode.code.end());
+
+        for(const Value& constant : bytecode.constants)
+        {
+            // Only the strings are constants, the numerics are in the instructions.
+            if(constant.type != ValueType::VT_STRING)
+                return false;
+
+            add_entry(layout.entries, layout.characters, constant.string->getData(), constant.string->getSize());
+        }
+
+        for(const std::string& message : bytecode.messages)
+            add_entry(layout.entries, layout.characters, message.data(), message.size());
+
+        for(const std::shared_ptr<Function>& defined : bytecode.functions)
+        {
+            if(!add_unit(layout, defined->bytecode, defined.get()))
+                return false;
+        }
+
+        return true;
+    }
+
+    // The sections of a loaded file, read in the order of the units.
+    struct Reader
+    {
+        const Unit* unit;
+        const Unit* lastUnit;
+
+        Instruction* instruction;
+        Instruction* lastInstruction;
+
+        const Entry* entry;
+        const Entry* lastEntry;
+
+        const std::uint32_t* local;
+        const std::uint32_t* lastLocal;
+
+        const char* characters;
+        std::uint32_t symbolCount;
+    };
+
+    // The operands index the constants, messages, functions and locals of their unit, or the symbols, and the
+    // jumps stay in their unit : those of a corrupted file must not make the virtual machine read out of them.
+    bool check_operand(const Instruction& instruction, std::uint32_t remaining, const Unit& unit, bool inFunction, std::uint32_t symbolCount)
+    {
+        std::uint32_t operand = instruction.operand;
+
+        switch(instruction.opcode)
+        {
+            case OpCode::OC_PUSH_CONSTANT:
+            case OpCode::OC_PUSH_ESCAPED:
+                return operand < unit.constantCount;
+            case OpCode::OC_LOAD:
+            case OpCode::OC_STORE:
+                return operand < symbolCount;
+            case OpCode::OC_LOAD_LOCAL:
+            case OpCode::OC_STORE_LOCAL:
+                return inFunction && operand < unit.localCount;
+            case OpCode::OC_CHECK:
+                return operand < static_cast<std::uint32_t>(Operator::OP_NONE);
+            case OpCode::OC_DEFINE:
+                return operand < unit.functionCount;
+            case OpCode::OC_CALL:
+            case OpCode::OC_TAIL_CALL:
+                return (operand & 0xFFFFFF) < symbolCount;
+            case OpCode::OC_JUMP:
+            case OpCode::OC_JUMP_IF_FALSE:
+                return operand > 0 && operand < remaining;
+            case OpCode::OC_FAIL:
+                return operand < unit.messageCount;
+            case OpCode::OC_PUSH_NULL:
+            case OpCode::OC_PUSH_NUMERIC:
+            case OpCode::OC_POP:
+            case OpCode::OC_TO_NUMERIC:
+            case OpCode::OC_TO_STRING:
+            case OpCode::OC_PRINT:
+            case OpCode::OC_INPUT:
+            case OpCode::OC_ADD:
+            case OpCode::OC_SUB:
+            case OpCode::OC_MUL:
+            case OpCode::OC_DIV:
+            case OpCode::OC_MOD:
+            case OpCode::OC_POW:
+            case OpCode::OC_SIN:
+            case OpCode::OC_COS:
+            case OpCode::OC_TAN:
+            case OpCode::OC_ASIN:
+            case OpCode::OC_ACOS:
+            case OpCode::OC_ATAN:
+            case OpCode::OC_TO_RAD:
+            case OpCode::OC_TO_DEG:
+            case OpCode::OC_LN:
+            case OpCode::OC_EXP:
+            case OpCode::OC_LOG10:
+            case OpCode::OC_SQUARE:
+            case OpCode::OC_RETURN:
+                return true;
+            default:
+                // Not an opcode.
+                return false;
+        }
+    }
+
+    bool read_unit(Reader& reader, Bytecode& bytecode, Function* function)
+    {
+        if(reader.unit == reader.lastUnit)
+            return false;
+
+        const Unit& unit = *reader.unit++;
+
+        if(std::uint64_t(unit.instructionCount) > std::uint64_t(reader.lastInstruction - reader.instruction)
+           || std::uint64_t(unit.constantCount) + unit.messageCount > std::uint64_t(reader.lastEntry - reader.entry))
+            return false;
+
+        // The code ends with its return, the virtual machine does not check for its end.
+        if(unit.instructionCount == 0 || reader.instruction[unit.instructionCount - 1].opcode != OpCode::OC_RETURN)
+            return false;
+
+        for(std::uint32_t i(0) ; i < unit.instructionCount ; ++i)
+        {
+            if(!check_operand(reader.instruction[i], unit.instructionCount - i, unit, function != nullptr, reader.symbolCount))
+                return false;
+        }
+
+        bytecode.mappedCode = reader.instruction;
+        bytecode.maxStackSize = static_cast<std::size_t>(unit.maxStackSize);
+        reader.instruction += unit.instructionCount;
+
+        for(std::uint32_t i(0) ; i < unit.constantCount ; ++i, ++reader.entry)
+            bytecode.constants.push_back(Value(StringObject::create(reader.characters + reader.entry->offset, reader.entry->length)));
+
+        for(std::uint32_t i(0) ; i < unit.messageCount ; ++i, ++reader.entry)
+            bytecode.messages.push_back(std::string(reader.characters + reader.entry->offset, reader.entry->length));
+
+        if(function)
+        {
+            if(unit.name >= reader.symbolCount || unit.parameterCount > unit.localCount
+               || std::uint64_t(unit.localCount) + unit.calleeCount > std::uint64_t(reader.lastLocal - reader.local))
+                return false;
+
+            function->name = unit.name;
+            function->parameterCount = unit.parameterCount;
+            function->sideEffects = unit.sideEffects != 0;
+
+            for(std::uint32_t i(0) ; i < unit.localCount + unit.calleeCount ; ++i, ++reader.local)
+            {
+                if(*reader.local >= reader.symbolCount)
+                    return false;
+
+                (i < unit.localCount ? function->locals : function->callees).push_back(*reader.local);
+            }
+        }
+
+        for(std::uint32_t i(0) ; i < unit.functionCount ; ++i)
+        {
+            std::shared_ptr<Function> defined = std::make_shared<Function>();
+
+            if(!read_unit(reader, defined->bytecode, defined.get()))
+                return false;
+
+            bytecode.functions.push_back(defined);
+        }
+
+        return true;
+    }
+}
+
+const std::uint32_t ProgramCache::optimized;
+const std::uint32_t ProgramCache::ssa;
+
+ProgramCache::ProgramCache(const std::string& directory, const char* source, std::size_t size, std::uint32_t settings)
+    : m_directory(directory)
+    , m_sourceHash(hash(source, size))
+    , m_sourceSize(size)
+    , m_settings(settings)
+    , m_data(nullptr)
+    , m_size(0)
+    , m_mapped(false)
+{
+    char name[40];
+    std::snprintf(name, sizeof(name), "%016llx%016llx.ebc", static_cast<unsigned long long>(m_sourceHash),
+                  static_cast<unsigned long long>(version() ^ mix(m_settings + 1)));
+
+    m_path = m_directory + "/" + name;
+}
+
+ProgramCache::~ProgramCache()
+{
+    #ifdef PROGRAM_CACHE_MMAP
+    if(m_mapped)
+        ::munmap(m_data, m_size);
+    #endif // PROGRAM_CACHE_MMAP
+}
+
+bool ProgramCache::load(Bytecode& bytecode, SymbolTable& symbols)
+{
+    if(symbols.size() != 0)
+        return false;
+
+    #ifdef PROGRAM_CACHE_MMAP
+    int descriptor = ::open(m_path.c_str(), O_RDONLY);
+
+    if(descriptor < 0)
+        return false;
+
+    struct stat status;
+
+    if(::fstat(descriptor, &status) == 0 && S_ISREG(status.st_mode) && static_cast<std::size_t>(status.st_size) >= sizeof(Header))
+    {
+        // Private and writable : the virtual machine rewrites some instructions on their first execution,
+        // the pages it writes are copied, the file never changes.
+        void* address = ::mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0);
+
+        if(address != MAP_FAILED)
+        {
+            m_data = static_cast<char*>(address);
+            m_size = static_cast<std::size_t>(status.st_size);
+            m_mapped = true;
+        }
+    }
+
+    ::close(descriptor);
+    #else
+    std::ifstream file(m_path.c_str(), std::ios::binary);
+
+    if(file)
+    {
+        m_buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        m_data = m_buffer.data();
+        m_size = m_buffer.size();
+    }
+    #endif // PROGRAM_CACHE_MMAP
+
+    if(m_size < sizeof(Header))
+        return false;
+
+    Header header;
+    std::memcpy(&header, m_data, sizeof(header));
+
+    if(std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version()
+       || header.sourceHash != m_sourceHash || header.sourceSize != m_sourceSize || header.settings != m_settings
+       || header.payloadHash != hash(m_data + sizeof(Header), m_size - sizeof(Header)))
+        return false;
+
+    std::uint64_t entryCount = std::uint64_t(header.entryCount) + header.symbolCount;
+    std::uint64_t expectedSize = sizeof(Header) + std::uint64_t(header.unitCount) * sizeof(Unit)
+                                 + std::uint64_t(header.instructionCount) * sizeof(Instruction) + entryCount * sizeof(Entry)
+                                 + std::uint64_t(header.localCount) * sizeof(std::uint32_t) + header.characterCount;
+
+    if(expectedSize != m_size)
+        return false;
+
+    const Unit* units = reinterpret_cast<const Unit*>(m_data + sizeof(Header));
+    Instruction* instructions = reinterpret_cast<Instruction*>(m_data + sizeof(Header) + std::size_t(header.unitCount) * sizeof(Unit));
+    const Entry* entries = reinterpret_cast<const Entry*>(instructions + header.instructionCount);
+    const std::uint32_t* locals = reinterpret_cast<const std::uint32_t*>(entries + entryCount);
+    const char* characters = reinterpret_cast<const char*>(locals + header.localCount);
+
+    for(std::uint64_t i(0) ; i < entryCount ; ++i)
+    {
+        if(std::uint64_t(entries[i].offset) + entries[i].length > header.characterCount)
+            return false;
+    }
+
+    Reader reader;
+    reader.unit = units;
+    reader.lastUnit = units + header.unitCount;
+    reader.instruction = instructions;
+    reader.lastInstruction = instructions + header.instructionCount;
+    reader.entry = entries;
+    reader.lastEntry = entries + header.entryCount;
+    reader.local = locals;
+    reader.lastLocal = locals + header.localCount;
+    reader.characters = characters;
+    reader.symbolCount = header.symbolCount;
+
+    bytecode = Bytecode();
+
+    if(!read_unit(reader, bytecode, nullptr) || reader.unit != reader.lastUnit)
+    {
+        bytecode = Bytecode();
+        return false;
+    }
+
+    for(const Entry* symbol = reader.lastEntry ; symbol != entries + entryCount ; ++symbol)
+        symbols.intern(characters + symbol->offset, symbol->length);
+
+    return true;
+}
+
+bool ProgramCache::store(const Bytecode& bytecode, const SymbolTable& symbols) const
+{
+    Header header;
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version();
+    header.sourceHash = m_sourceHash;
+    header.sourceSize = m_sourceSize;
+
+    Layout layout;
+
+    if(!add_unit(layout, bytecode, nullptr))
+        return false;
+
+    std::uint32_t entryCount = static_cast<std::uint32_t>(layout.entries.size());
+
+    for(Symbol symbol(0) ; symbol < symbols.size() ; ++symbol)
+        add_entry(layout.entries, layout.characters, symbols.getName(symbol).data(), symbols.getName(symbol).size());
+
+    header.unitCount = static_cast<std::uint32_t>(layout.units.size());
+    header.instructionCount = static_cast<std::uint32_t>(layout.instructions.size());
+    header.entryCount = entryCount;
+    header.symbolCount = static_cast<std::uint32_t>(symbols.size());
+    header.localCount = static_cast<std::uint32_t>(layout.locals.size());
+    header.settings = m_settings;
+    header.characterCount = layout.characters.size();
+
+    std::string payload;
+    payload.append(reinterpret_cast<const char*>(layout.units.data()), layout.units.size() * sizeof(Unit));
+    payload.append(reinterpret_cast<const char*>(layout.instructions.data()), layout.instructions.size() * sizeof(Instruction));
+    payload.append(reinterpret_cast<const char*>(layout.entries.data()), layout.entries.size() * sizeof(Entry));
+    payload.append(reinterpret_cast<const char*>(layout.locals.data()), layout.locals.size() * sizeof(std::uint32_t));
+    payload.append(layout.characters);
+
+    header.payloadHash = hash(payload.data(), payload.size());
+
+    #ifdef PROGRAM_CACHE_MMAP
+    ::mkdir(m_directory.c_str(), 0755);
+    #endif // PROGRAM_CACHE_MMAP
+
+    // Written aside then renamed : the other runs see either no file or a complete one.
+    std::string temporary = m_path + "." + std::to_string(std::random_device()()) + ".tmp";
+
+    {
+        std::ofstream file(temporary.c_str(), std::ios::binary | std::ios::trunc);
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+
+        if(!file)
+        {
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+
+    if(std::rename(temporary.c_str(), m_path.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+const std::string& ProgramCache::getPath() const
+{
+    return m_path;
+}
+
+std::uint64_t ProgramCache::hash(const char* data, std::size_t size)
+{
+    std::uint64_t hash = 0x9E3779B97F4A7C15ull ^ size;
+    std::size_t i(0);
+
+    for( ; i + 8 <= size ; i += 8)
+    {
+        std::uint64_t word(0);
+        std::memcpy(&word, data + i, sizeof(word));
+
+        hash = (hash ^ (word * 0x9E3779B97F4A7C15ull)) * 0xBF58476D1CE4E5B9ull;
+        hash ^= hash >> 29;
+    }
+
+    std::uint64_t tail(0);
+
+    if(i < size)
+        std::memcpy(&tail, data + i, size - i);
+
+    return mix(hash ^ (tail * 0x94D049BB133111EBull));
+}
@@ -0,0 +1,85 @@
+/*
+	program_cache.hpp
+
+	The MIT License (MIT)
+
+	Copyright (c) 2014 Maxime Alvarez
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+	Defines the cache of the compiled programs, kept in files between the runs.
+*/
+
+#ifndef PROGRAM_CACHE_HPP_INCLUDED
+#define PROGRAM_CACHE_HPP_INCLUDED
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bytecode.hpp"
+#include "symbol_table.hpp"
+
+/// A directory of compiled programs, one file per source named after a hash of the source, of the settings
+/// it is compiled with and of the version of the bytecode. A file is laid out as the virtual machine reads it : a hit maps the file and
+/// the instructions are executed in place, without lexing, parsing nor pointer fix-ups. Only the string
+/// constants, the messages, the symbols and the descriptions of the functions are copied. A file whose
+/// bytes do not match their hash, or whose operands are out of their program, is a miss.
+class ProgramCache
+{
+    public:
+        // The settings of the compilation, one bit each : a program compiled with others is a miss.
+        static const std::uint32_t optimized = 1 << 0;
+        static const std::uint32_t ssa = 1 << 1;
+
+        ProgramCache(const std::string& directory, const char* source, std::size_t size, std::uint32_t settings = 0);
+        ~ProgramCache();
+
+        ProgramCache(const ProgramCache&) = delete;
+        ProgramCache& operator=(const ProgramCache&) = delete;
+
+        // Return false if the source has no compiled program in the cache. On a hit, the instructions of
+        // the bytecode stay in the cache file mapping, valid as long as this object. The identifiers are
+        // interned in the symbols, which must be empty : they get the slots of the compiled program.
+        bool load(Bytecode& bytecode, SymbolTable& symbols);
+
+        // Store the program compiled from the source. The cache is only an optimization : return false
+        // on errors, without throwing.
+        bool store(const Bytecode& bytecode, const SymbolTable& symbols) const;
+
+        const std::string& getPath() const;
+
+        // Not cryptographic : 8 bytes at a time, for the large sources to be hashed quickly.
+        static std::uint64_t hash(const char* data, std::size_t size);
+
+    protected:
+        std::string m_directory;
+        std::string m_path;
+
+        std::uint64_t m_sourceHash;
+        std::uint64_t m_sourceSize;
+        std::uint32_t m_settings;
+
+        // The loaded file, mapped where it is supported (POSIX), read at once otherwise.
+        char* m_data;
+        std::size_t m_size;
+        bool m_mapped;
+        std::vector<char> m_buffer;
+};
+
+#endif // PROGRAM_CACHE_HPP_INCLUDED
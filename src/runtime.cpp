@@ -1,11 +1,101 @@
-#include "Runtime.hpp"
+#include "runtime.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // The conversions of angles are computed in single precision, as the values are.
+    const float radiansPerDegree = static_cast<float>(M_PI / 180.0);
+    const float degreesPerRadian = static_cast<float>(180.0 / M_PI);
+
+    // Counts an expression as nested while the evaluators are in it, errors included.
+    class Nesting
+    {
+        public:
+            Nesting(std::size_t& depth)
+                : m_depth(depth)
+            {
+                ++m_depth;
+            }
+
+            ~Nesting()
+            {
+                --m_depth;
+            }
+
+        protected:
+            std::size_t& m_depth;
+    };
+}
+
+const std::size_t Runtime::maxEvalDepth;
+const std::size_t Runtime::maxExecuteDepth;
+const std::size_t Runtime::maxNestingDepth;
 
 Runtime::Runtime()
-{}
+    : m_stack(256)  // Deep enough for most programs, so that executing them does not allocate.
+    , m_functionNodes(4 * 1024)
+    , m_function(nullptr)
+    , m_frame(0)
+    , m_top(0)
+    , m_depth(0)
+    , m_nesting(0)
+    , m_tailCall(nullptr)
+    , m_memoize(false)
+    , m_bindings(1)
+{
+    m_frames.reserve(64);
+}
+
+Value Runtime::unassigned()
+{
+    Value value;
+    value.type = ValueType::VT_UNASSIGNED;
+
+    return value;
+}
 
 void Runtime::clear()
 {
-    m_variables.clear();
+    // The slots are kept, only their values are forgotten.
+    std::fill(m_variables.begin(), m_variables.end(), unassigned());
+    std::fill(m_functions.begin(), m_functions.end(), std::shared_ptr<Function>());
+
+    // The calls interrupted by an error.
+    m_function = nullptr;
+    m_frame = 0;
+    m_top = 0;
+    m_depth = 0;
+    m_nesting = 0;
+    m_tailCall = nullptr;
+
+    ++m_bindings;
+    m_memoKeys.clear();
+
+    m_frames.clear();
+    m_retired.clear();
+}
+
+SymbolTable& Runtime::getSymbols()
+{
+    return m_symbols;
+}
+
+void Runtime::declareSymbols()
+{
+    m_variables.resize(m_symbols.size(), unassigned());
+    m_functions.resize(m_symbols.size());
+}
+
+void Runtime::setMemoization(bool enabled)
+{
+    m_memoize = enabled;
+}
+
+const std::vector<std::shared_ptr<Function>>& Runtime::getFunctions() const
+{
+    return m_functions;
 }
 
 Value Runtime::eval(Node* node)
@@ -13,88 +103,111 @@ Value Runtime::eval(Node* node)
     if(node->getOperator() == Operator::OP_NONE)
     {
         if(node->getType() == NodeType::NT_IDENTIFIER)
-            return getVariable(node->getIdentifier());
+            return getVariable(node->getSlot());
+        else if(node->getType() == NodeType::NT_LOCAL)
+            return getLocal(node->getSlot());
         else if(node->getType() == NodeType::NT_CONST_VALUE)
             return node->getValue();
     }
 
-    if(node->getChildren().size() == 0)
+    NodeList children = node->getChildren();
+
+    if(children.empty())
         errors::runtimeError("expression with operator but no parameters");
 
+    // Each nested expression is a native call : too many of them would overflow the stack.
+    if(m_nesting == maxNestingDepth)
+        errors::runtimeError("expression nested more than " + std::to_string(maxNestingDepth) + " times, use the vm engine");
+
+    Nesting nesting(m_nesting);
+
     switch(node->getOperator())
     {
         /** Specials built-in operations. */
         case Operator::OP_PROGRAM:
-            return program(node->getChildren());
+            return program(children);
             break;
         case Operator::OP_ASSIGN:
-            return assign(node->getChildren());
+            return assign(children);
             break;
         case Operator::OP_TO_NUMERIC:
-            return to_numeric(node->getChildren());
+            return to_numeric(children);
             break;
         case Operator::OP_TO_STRING:
-            return to_string(node->getChildren());
+            return to_string(children);
             break;
         case Operator::OP_PRINT:
-            return print(node->getChildren());
+            return print(children);
             break;
         case Operator::OP_INPUT:
-            return input(node->getChildren());
+            return input(children);
+            break;
+        case Operator::OP_IF:
+            return condition(children);
+            break;
+        case Operator::OP_FUNCTION:
+            return define(node);
+            break;
+        case Operator::OP_CALL:
+            return call(children);
             break;
 
         /** Maths built-in operations. */
         case Operator::OP_ADD:
-            return add(node->getChildren());
+            return add(children);
             break;
         case Operator::OP_SUB:
-            return sub(node->getChildren());
+            return sub(children);
             break;
         case Operator::OP_MUL:
-            return mul(node->getChildren());
+            return mul(children);
             break;
         case Operator::OP_DIV:
-            return div(node->getChildren());
+            return div(children);
             break;
         case Operator::OP_MOD:
-            return mod(node->getChildren());
+            return mod(children);
             break;
         case Operator::OP_POW:
-            return pow(node->getChildren());
+            return pow(children);
             break;
         case Operator::OP_SIN:
-            return sin(node->getChildren());
+            return sin(children);
             break;
         case Operator::OP_COS:
-            return cos(node->getChildren());
+            return cos(children);
             break;
         case Operator::OP_TAN:
-            return tan(node->getChildren());
+            return tan(children);
             break;
         case Operator::OP_ASIN:
-            return asin(node->getChildren());
+            return asin(children);
             break;
         case Operator::OP_ACOS:
-            return acos(node->getChildren());
+            return acos(children);
             break;
         case Operator::OP_ATAN:
-            return atan(node->getChildren());
+            return atan(children);
             break;
         case Operator::OP_TO_RAD:
-            return to_rad(node->getChildren());
+            return to_rad(children);
             break;
         case Operator::OP_TO_DEG:
-            return to_deg(node->getChildren());
+            return to_deg(children);
             break;
         case Operator::OP_LN:
+            return ln(children);
             break;
-            return ln(node->getChildren());
         case Operator::OP_EXP:
-            return exp(node->getChildren());
+            return exp(children);
             break;
         case Operator::OP_LOG10:
-            return log10(node->getChildren());
+            return log10(children);
             break;
+        case Operator::OP_SQUARE:
+            return square(children);
+            break;
+        case Operator::OP_NONE:
         default:
             break;
     }
@@ -102,545 +215,876 @@ Value Runtime::eval(Node* node)
     return 0.f;
 }
 
-Value Runtime::getVariable(const std::string& identifier)
+Value Runtime::eval(FlatAst& ast)
 {
-    if(m_variables.find(identifier) != m_variables.end())
-        return m_variables.at(identifier);
-    else
-        errors::runtimeError("unassigned identifier " + identifier);
-
-    // Useless but prevent compiler's warnings.
-    return 0.f;
+    return eval(ast, ast.getRoot());
 }
 
-/** Special built-in operations. */
-Value Runtime::program(std::vector<Node*> nodes)
+Value Runtime::eval(FlatAst& ast, NodeIndex index)
 {
-    for(Node* child : nodes)
-        this->eval(child);
+    Operator op = ast.getOperator(index);
 
-    return Value();
-}
+    if(op == Operator::OP_NONE)
+    {
+        if(ast.getType(index) == NodeType::NT_IDENTIFIER)
+            return getVariable(ast.getSlot(index));
+        else if(ast.getType(index) == NodeType::NT_LOCAL)
+            return getLocal(ast.getSlot(index));
+        else if(ast.getType(index) == NodeType::NT_CONST_VALUE)
+            return ast.getLiteral(index);
+    }
 
-Value Runtime::assign(std::vector<Node*> nodes)
-{
-    if(nodes.size() != 2)
-        errors::runtimeError("assign operator takes exactly two operators");
+    const NodeIndex* children = ast.getChildren(index);
+    std::uint32_t count = ast.getChildCount(index);
 
-    if(nodes.front()->getType() != NodeType::NT_IDENTIFIER)
-        errors::runtimeError("first parameter of assign operator must be an identifier");
+    if(count == 0)
+        errors::runtimeError("expression with operator but no parameters");
 
-    if(nodes.back()->getType() != NodeType::NT_CONST_VALUE && nodes.back()->getType() != NodeType::NT_EXPRESSION)
-        errors::runtimeError("second parameter of assign operator must be a constant value or an expression");
+    if(m_nesting == maxNestingDepth)
+        errors::runtimeError("expression nested more than " + std::to_string(maxNestingDepth) + " times, use the vm engine");
 
-    // Get the variable name & eval the value.
-    // If the variable already exist, it is overwritten.
-    // Otherwise it create the new variable.
-    m_variables[nodes.front()->getIdentifier()] = this->eval(nodes.back());
+    Nesting nesting(m_nesting);
 
-    // Return value type = VT_NONE.
-    return Value();
-}
+    switch(op)
+    {
+        /** Specials built-in operations. */
+        case Operator::OP_PROGRAM:
+            for(std::uint32_t i(0) ; i < count ; ++i)
+                eval(ast, children[i]);
 
-Value Runtime::to_numeric(std::vector<Node*> nodes)
-{
-    if(nodes.size() != 1)
-        errors::runtimeError("to_numeric operator takes only one operators");
+            return Value();
+        case Operator::OP_ASSIGN:
+            if(count != 2)
+                errors::runtimeError("assign operator takes exactly two operators");
 
-    Value conversion_result = eval(nodes.front());
+            if(ast.getType(children[0]) != NodeType::NT_IDENTIFIER && ast.getType(children[0]) != NodeType::NT_LOCAL)
+                errors::runtimeError("first parameter of assign operator must be an identifier");
 
-    // Convert type.
-    conversion_result.type = ValueType::VT_NUMERIC;
+            if(ast.getType(children[1]) == NodeType::NT_IDENTIFIER || ast.getType(children[1]) == NodeType::NT_LOCAL)
+                errors::runtimeError("second parameter of assign operator must be a constant value or an expression");
 
-    // Convert str -> num.
-    if(conversion_result.type == ValueType::VT_STRING)
-        conversion_result.numeric = string_utils::to<float>(conversion_result.string);
+            if(ast.getType(children[0]) == NodeType::NT_LOCAL)
+            {
+                // Evaluated first : the calls of the value may move the stack.
+                Value value = eval(ast, children[1]);
+                m_stack[m_frame + ast.getSlot(children[0])] = std::move(value);
+            }
+            else
+                m_variables[ast.getSlot(children[0])] = eval(ast, children[1]);
+
+            return Value();
+        case Operator::OP_TO_NUMERIC:
+            if(count != 1)
+                errors::runtimeError("to_numeric operator takes only one operators");
+
+            return convertToNumeric(eval(ast, children[0]));
+        case Operator::OP_TO_STRING:
+            if(count != 1)
+                errors::runtimeError("to_string operator takes only one operator");
+
+            return convertToString(eval(ast, children[0]));
+        case Operator::OP_PRINT:
+            for(std::uint32_t i(0) ; i < count ; ++i)
+                printValue(eval(ast, children[i]));
+
+            return Value();
+        case Operator::OP_INPUT:
+            for(std::uint32_t i(0) ; i < count ; ++i)
+                printValue(eval(ast, children[i]));
+
+            return readInput();
+        case Operator::OP_IF:
+        {
+            NodeIndex chosen = 0;
+            return branch(ast, index, chosen) ? eval(ast, chosen) : Value();
+        }
+        case Operator::OP_FUNCTION:
+            return define(ast, index);
+        case Operator::OP_CALL:
+            return call(ast, index);
+
+        /** Maths built-in operations. */
+        case Operator::OP_ADD:
+        case Operator::OP_SUB:
+        case Operator::OP_MUL:
+        case Operator::OP_DIV:
+        case Operator::OP_MOD:
+        case Operator::OP_POW:
+        {
+            Value result = eval(ast, children[0]);
+            checkOperand(op, result);
+
+            for(std::uint32_t i(1) ; i < count ; ++i)
+                applyBinary(op, result, eval(ast, children[i]));
+
+            return result;
+        }
+        case Operator::OP_SIN:
+        case Operator::OP_COS:
+        case Operator::OP_TAN:
+        case Operator::OP_ASIN:
+        case Operator::OP_ACOS:
+        case Operator::OP_ATAN:
+        case Operator::OP_TO_RAD:
+        case Operator::OP_TO_DEG:
+        case Operator::OP_LN:
+        case Operator::OP_EXP:
+        case Operator::OP_LOG10:
+        case Operator::OP_SQUARE:
+            if(count != 1)
+                errors::runtimeError(string_utils::from(op) + " operator only takes one argument");
 
-    return conversion_result;
+            return Value(applyUnary(op, eval(ast, children[0])));
+        case Operator::OP_NONE:
+        default:
+            break;
+    }
+
+    return 0.f;
 }
 
-Value Runtime::to_string(std::vector<Node*> nodes)
+const Value& Runtime::getVariable(std::uint32_t slot)
 {
-    if(nodes.size() != 1)
-        errors::runtimeError("to_string operator takes only one operator");
+    if(m_variables[slot].type == ValueType::VT_UNASSIGNED)
+        errors::runtimeError("unassigned identifier " + m_symbols.getName(slot));
 
-    Value conversion_result = eval(nodes.front());
+    return m_variables[slot];
+}
 
-    // Convert type.
-    conversion_result.type = ValueType::VT_STRING;
+const Value& Runtime::getLocal(std::uint32_t slot)
+{
+    const Value& local = m_stack[m_frame + slot];
 
-    // Convert num -> str.
-    if(conversion_result.type == ValueType::VT_NUMERIC)
-        conversion_result.string = string_utils::from<float>(conversion_result.numeric);
+    if(local.type == ValueType::VT_UNASSIGNED)
+        errors::runtimeError("unassigned identifier " + m_symbols.getName(m_function->locals[slot]));
 
-    return conversion_result;
+    return local;
 }
 
-Value Runtime::print(std::vector<Node*> nodes)
+/** User-defined functions, shared by the evaluators and the virtual machine. */
+Function* Runtime::getFunction(Symbol name, std::size_t argumentCount)
 {
-    for(Node* child : nodes)
+    Function* function = m_functions[name].get();
+
+    if(!function)
     {
-        Value value = this->eval(child);
+        if(argumentCount != 0)
+            errors::runtimeError("undefined function " + m_symbols.getName(name));
 
-        if(value.type == ValueType::VT_NUMERIC)
-            std::cout << value.numeric;
-        else if(value.type == ValueType::VT_STRING)
-            std::cout << value.string;
+        return nullptr;
     }
 
-    // Return value type = VT_NONE.
-    return Value();
+    if(argumentCount != function->parameterCount)
+        errors::runtimeError("function " + m_symbols.getName(name) + " takes " + std::to_string(function->parameterCount) + " arguments");
+
+    return function;
 }
 
-Value Runtime::input(std::vector<Node*> nodes)
+void Runtime::reserveStack(std::size_t size)
 {
-    // Output prompt.
-    print(nodes);
-
-    std::string word("");
-    std::cin >> word;
-
-    Value inputvalue(word);
-    return inputvalue;
+    // Doubled, for a deep recursion to move the stack a few times only.
+    if(size > m_stack.size())
+        m_stack.resize(std::max(size, 2 * m_stack.size()));
 }
 
-/** Maths built-in operations. */
-Value Runtime::add(std::vector<Node*> nodes)
+Value Runtime::define(Node* node)
 {
-    Value result = this->eval(nodes.front());
+    NodeList nodes = node->getChildren();
 
-    // The ValueType for the addition.
-    ValueType currentValueType = result.type;
+    if(nodes.size() < 2)
+        errors::runtimeError("function definition takes a name, parameters and a body");
 
-    // Cannot add non-typed values.
-    if(currentValueType == ValueType::VT_NONE)
-        errors::runtimeError("cannot apply add operator on non-typed values");
+    if(nodes.size() - 2 > Function::maxArguments)
+        errors::runtimeError("function definition takes at most 255 parameters");
 
-    if(nodes.size() > 1)
+    for(Node* const* child = nodes.begin() ; child != nodes.end() - 1 ; ++child)
     {
-        for(std::vector<Node*>::iterator it(nodes.begin() + 1) ; it != nodes.end() ; ++it)
-        {
-            Value childValue = this->eval(*it);
+        if((*child)->getType() != NodeType::NT_IDENTIFIER)
+            errors::runtimeError("name and parameters of function definition must be identifiers");
+    }
 
-            // Check if no incompatible types.
-            if(childValue.type != currentValueType)
-                errors::runtimeError("cannot apply add operator on different types");
+    // The slot of a definition is 1 + the index of its function, 0 until its body is copied.
+    if(node->getSlot() == 0)
+    {
+        std::shared_ptr<Function> function = std::make_shared<Function>();
+        function->declare(nodes);
+        function->copyBody(nodes.back(), m_functionNodes);
 
-            // Then add.
-            if(currentValueType == ValueType::VT_NUMERIC)
-                result.numeric += childValue.numeric;
-            else if(currentValueType == ValueType::VT_STRING)
-                result.string += childValue.string;
-        }
+        m_definitions.push_back(function);
+        node->setSlot(static_cast<std::uint32_t>(m_definitions.size()));
     }
 
-    return result;
+    const std::shared_ptr<Function>& function = m_definitions[node->getSlot() - 1];
+    m_functions[function->name] = function;
+    ++m_bindings;
+
+    return Value();
 }
 
-Value Runtime::sub(std::vector<Node*> nodes)
+Value Runtime::call(NodeList nodes, bool tail)
 {
-    Value result = this->eval(nodes.front());
-
-    // The ValueType for the substraction.
-    ValueType currentValueType = result.type;
+    Symbol name = nodes.front()->getSlot();
+    std::size_t count = nodes.size() - 1;
 
-    // Cannot sub non-typed values.
-    if(currentValueType == ValueType::VT_NONE)
-        errors::runtimeError("cannot apply sub operator on non-typed values");
+    if(count > Function::maxArguments)
+        errors::runtimeError("function call takes at most 255 arguments");
 
-    // Cannot sub strings.
-    if(currentValueType == ValueType::VT_STRING)
-        errors::runtimeError("cannot apply sub on strings");
+    // Each argument is evaluated above the previous ones, they become the first locals of the frame.
+    std::size_t frame = m_top;
 
-    if(nodes.size() > 1)
+    for(std::size_t i(0) ; i < count ; ++i)
     {
-        for(std::vector<Node*>::iterator it(nodes.begin() + 1) ; it != nodes.end() ; ++it)
-        {
-            Value childValue = this->eval(*it);
-
-            // Check if no incompatible types.
-            if(childValue.type != currentValueType)
-                errors::runtimeError("cannot apply sub operator on different types");
+        Value argument = eval(nodes[i + 1]);
 
-            // Then sub.
-            result.numeric -= childValue.numeric;
-        }
+        reserveStack(frame + i + 1);
+        m_stack[frame + i] = std::move(argument);
+        m_top = frame + i + 1;
     }
 
-    return result;
-}
+    Function* function = getFunction(name, count);
 
-Value Runtime::mul(std::vector<Node*> nodes)
-{
-    if(nodes.size() < 1)
-        errors::runtimeError("mul operator needs at least two arguments");
+    if(!function)
+        return getVariable(name);
 
-    Value result = this->eval(nodes.front());
+    if(tail)
+        return tailCall(function, frame, count);
+
+    return callBody(function, frame);
+}
 
-    // The ValueType for the multiplication.
-    ValueType currentValueType = result.type;
+Value Runtime::define(FlatAst& ast, NodeIndex index)
+{
+    const NodeIndex* children = ast.getChildren(index);
+    std::uint32_t count = ast.getChildCount(index);
 
-    // Cannot mul non-typed values.
-    if(currentValueType == ValueType::VT_NONE)
-        errors::runtimeError("cannot apply mul operator on non-typed values");
+    if(count < 2)
+        errors::runtimeError("function definition takes a name, parameters and a body");
 
-    // Cannot mul strings.
-    if(currentValueType == ValueType::VT_STRING)
-        errors::runtimeError("cannot apply mul operator on strings");
+    if(count - 2 > Function::maxArguments)
+        errors::runtimeError("function definition takes at most 255 parameters");
 
-    if(nodes.size() > 1)
+    for(std::uint32_t i(0) ; i + 1 < count ; ++i)
     {
-        for(std::vector<Node*>::iterator it(nodes.begin() + 1) ; it != nodes.end() ; ++it)
-        {
-            Value childValue = this->eval(*it);
+        if(ast.getType(children[i]) != NodeType::NT_IDENTIFIER)
+            errors::runtimeError("name and parameters of function definition must be identifiers");
+    }
 
-            // Check if no incompatible types.
-            if(childValue.type != currentValueType)
-                errors::runtimeError("cannot apply mul operator on different types");
+    if(ast.getSlot(index) == 0)
+    {
+        std::shared_ptr<Function> function = std::make_shared<Function>();
+        function->declare(ast, index);
+        function->copyBody(ast, children[count - 1]);
 
-            // Then mul.
-            result.numeric *= childValue.numeric;
-        }
+        m_definitions.push_back(function);
+        ast.setSlot(index, static_cast<std::uint32_t>(m_definitions.size()));
     }
 
-    return result;
+    const std::shared_ptr<Function>& function = m_definitions[ast.getSlot(index) - 1];
+    m_functions[function->name] = function;
+    ++m_bindings;
+
+    return Value();
 }
 
-Value Runtime::div(std::vector<Node*> nodes)
+Value Runtime::call(FlatAst& ast, NodeIndex index, bool tail)
 {
-    if(nodes.size() < 1)
-        errors::runtimeError("div operator needs at least two arguments");
+    Symbol name = ast.getSlot(ast.getChildren(index)[0]);
+    std::uint32_t count = ast.getChildCount(index) - 1;
 
-    Value result = this->eval(nodes.front());
+    if(count > Function::maxArguments)
+        errors::runtimeError("function call takes at most 255 arguments");
 
-    // The ValueType for the division.
-    ValueType currentValueType = result.type;
+    std::size_t frame = m_top;
 
-    // Cannot div non-typed values.
-    if(currentValueType == ValueType::VT_NONE)
-        errors::runtimeError("cannot apply div operator on non-typed values");
+    for(std::uint32_t i(0) ; i < count ; ++i)
+    {
+        Value argument = eval(ast, ast.getChildren(index)[i + 1]);
 
-    // Cannot div strings.
-    if(currentValueType == ValueType::VT_STRING)
-        errors::runtimeError("cannot apply div operator on strings");
+        reserveStack(frame + i + 1);
+        m_stack[frame + i] = std::move(argument);
+        m_top = frame + i + 1;
+    }
 
-    if(nodes.size() > 1)
-    {
-        for(std::vector<Node*>::iterator it(nodes.begin() + 1) ; it != nodes.end() ; ++it)
-        {
-            Value childValue = this->eval(*it);
+    Function* function = getFunction(name, count);
 
-            // Check if no incompatible types.
-            if(childValue.type != currentValueType)
-                errors::runtimeError("cannot apply div operator on different types");
+    if(!function)
+        return getVariable(name);
 
-            // Then div.
-            result.numeric /= childValue.numeric;
-        }
+    if(tail)
+        return tailCall(function, frame, count);
+
+    return callBody(function, frame);
+}
+
+Value Runtime::tailCall(Function* function, std::size_t arguments, std::size_t count)
+{
+    // The arguments replace the locals of the caller, which are below them on the stack.
+    std::move(m_stack.begin() + static_cast<std::ptrdiff_t>(arguments), m_stack.begin() + static_cast<std::ptrdiff_t>(arguments + count),
+              m_stack.begin() + static_cast<std::ptrdiff_t>(m_frame));
+
+    // A memoized result is the one of the caller.
+    if(MemoTable* memo = memoTable(function))
+    {
+        if(const Value* result = memo->find(m_stack.data() + m_frame))
+            return *result;
     }
 
-    return result;
+    m_tailCall = function;
+    return Value();
 }
 
-Value Runtime::mod(std::vector<Node*> nodes)
+Value Runtime::callBody(Function* function, std::size_t frame)
 {
-    if(nodes.size() < 1)
-        errors::runtimeError("mod operator needs at least two arguments");
+    MemoTable* memo = memoTable(function);
+    std::size_t keys = m_memoKeys.size();
 
-    Value result = this->eval(nodes.front());
+    if(memo)
+    {
+        if(const Value* result = memo->find(m_stack.data() + frame))
+        {
+            m_top = frame;
+            return *result;
+        }
+
+        // The arguments may be assigned or replaced by a tail call : the key is copied.
+        m_memoKeys.insert(m_memoKeys.end(), m_stack.begin() + static_cast<std::ptrdiff_t>(frame), m_stack.begin() + static_cast<std::ptrdiff_t>(frame + function->parameterCount));
+    }
+
+    if(m_depth == maxEvalDepth)
+        errors::runtimeError("stack overflow, more than " + std::to_string(maxEvalDepth) + " nested calls");
 
-    // The ValueType for the mod.
-    ValueType currentValueType = result.type;
+    Function* caller = m_function;
+    std::size_t callerFrame = m_frame;
 
-    // Cannot mod non-typed values.
-    if(currentValueType == ValueType::VT_NONE)
-        errors::runtimeError("cannot apply mod operator on non-typed values");
+    m_frame = frame;
+    ++m_depth;
 
-    // Cannot mod strings.
-    if(currentValueType == ValueType::VT_STRING)
-        errors::runtimeError("cannot apply mod operator on strings");
+    Value result;
 
-    if(nodes.size() > 1)
+    // The tail calls of the bodies are evaluated in the same frame, one after the other, without nesting.
+    do
     {
-        for(std::vector<Node*>::iterator it(nodes.begin() + 1) ; it != nodes.end() ; ++it)
-        {
-            Value childValue = this->eval(*it);
+        // The arguments are the first locals, the others are unassigned until the body assigns them.
+        std::size_t top = frame + function->locals.size();
 
-            // Check if no incompatible types.
-            if(childValue.type != currentValueType)
-                errors::runtimeError("cannot apply mod operator on different types");
+        reserveStack(top);
+        std::fill(m_stack.begin() + static_cast<std::ptrdiff_t>(frame + function->parameterCount), m_stack.begin() + static_cast<std::ptrdiff_t>(top), unassigned());
 
-            // Then mod.
-            result.numeric = std::fmod(result.numeric, childValue.numeric);
-        }
+        m_function = function;
+        m_top = top;
+
+        result = function->node ? evalTail(function->node) : evalTail(function->ast, function->ast.getRoot());
+
+        function = m_tailCall;
+        m_tailCall = nullptr;
+    }
+    while(function);
+
+    if(memo)
+    {
+        memo->insert(m_memoKeys.data() + keys, result);
+        m_memoKeys.resize(keys);
     }
 
+    m_function = caller;
+    m_frame = callerFrame;
+    m_top = frame;
+    --m_depth;
+
     return result;
 }
 
-Value Runtime::pow(std::vector<Node*> nodes)
+MemoTable* Runtime::memoTable(Function* function)
 {
-    if(nodes.size() < 1)
-        errors::runtimeError("pow operator needs at least two arguments");
+    if(!m_memoize)
+        return nullptr;
 
-    Value result = this->eval(nodes.front());
+    if(function->bindings != m_bindings)
+    {
+        function->bindings = m_bindings;
+        function->pure = isPure(function);
+
+        // Its results may come from other definitions of the functions it calls.
+        if(function->memo)
+            function->memo->clear();
+    }
+
+    if(!function->pure)
+        return nullptr;
 
-    // The ValueType for the pow.
-    ValueType currentValueType = result.type;
+    if(!function->memo)
+        function->memo.reset(new MemoTable(function->parameterCount));
 
-    // Cannot pow non-typed values.
-    if(currentValueType == ValueType::VT_NONE)
-        errors::runtimeError("cannot apply pow operator on non-typed values");
+    return function->memo.get();
+}
 
-    // Cannot pow strings.
-    if(currentValueType == ValueType::VT_STRING)
-        errors::runtimeError("cannot apply pow operator on strings");
+bool Runtime::isPure(Function* function)
+{
+    // Depth first on the functions it calls, as they are bound now : a recursion is pure if nothing else is impure.
+    std::vector<Function*> visited(1, function);
+    std::vector<Function*> functions(1, function);
 
-    if(nodes.size() > 1)
+    while(!functions.empty())
     {
-        for(std::vector<Node*>::iterator it(nodes.begin() + 1) ; it != nodes.end() ; ++it)
+        Function* current = functions.back();
+        functions.pop_back();
+
+        if(current->sideEffects)
+            return false;
+
+        for(Symbol callee : current->callees)
         {
-            Value childValue = this->eval(*it);
+            Function* bound = m_functions[callee].get();
 
-            // Check if no incompatible types.
-            if(childValue.type != currentValueType)
-                errors::runtimeError("cannot apply pow operator on different types");
+            // (name) reads the global variable when there is no such function.
+            if(!bound)
+                return false;
 
-            // Then pow.
-            result.numeric = std::pow(result.numeric, childValue.numeric);
+            if(std::find(visited.begin(), visited.end(), bound) == visited.end())
+            {
+                visited.push_back(bound);
+                functions.push_back(bound);
+            }
         }
     }
 
-    return result;
+    return true;
 }
 
-Value Runtime::sin(std::vector<Node*> nodes)
+Value Runtime::evalTail(Node* node)
 {
-    if(nodes.size() != 1)
-        errors::runtimeError("sin operator only takes one argument");
+    // Down the branches of the conditions, to the expression giving the result.
+    while(node->getOperator() == Operator::OP_IF && !node->getChildren().empty())
+    {
+        node = branch(node->getChildren());
 
-    Value result = this->eval(nodes.front());
+        if(!node)
+            return Value();
+    }
 
-    // The ValueType.
-    ValueType currentValueType = result.type;
+    if(node->getOperator() == Operator::OP_CALL && !node->getChildren().empty())
+        return call(node->getChildren(), true);
+
+    return eval(node);
+}
+
+Value Runtime::evalTail(FlatAst& ast, NodeIndex index)
+{
+    while(ast.getOperator(index) == Operator::OP_IF && ast.getChildCount(index) != 0)
+    {
+        if(!branch(ast, index, index))
+            return Value();
+    }
+
+    if(ast.getOperator(index) == Operator::OP_CALL && ast.getChildCount(index) != 0)
+        return call(ast, index, true);
+
+    return eval(ast, index);
+}
+
+/** Operations shared by the tree-walking evaluator and the virtual machine. */
+void Runtime::checkOperand(Operator op, const Value& operand)
+{
+    // The square of the optimizer fails as the (^ e 2) it was written.
+    if(op == Operator::OP_SQUARE)
+        op = Operator::OP_POW;
 
     // Cannot apply on non-typed values.
-    if(currentValueType == ValueType::VT_NONE)
-        errors::runtimeError("cannot apply sin operator on non-typed values");
+    if(operand.type == ValueType::VT_NONE)
+        errors::runtimeError("cannot apply " + string_utils::from(op) + " operator on non-typed values");
+
+    // Only add can be applied on strings.
+    if(operand.type == ValueType::VT_STRING && op != Operator::OP_ADD)
+        errors::runtimeError("cannot apply " + string_utils::from(op) + " operator on strings");
+}
 
-    // Cannot apply on strings.
-    if(currentValueType == ValueType::VT_STRING)
-        errors::runtimeError("cannot apply sin operator on strings");
+void Runtime::applyBinary(Operator op, Value& accumulator, const Value& operand)
+{
+    // Check if no incompatible types.
+    if(operand.type != accumulator.type)
+        errors::runtimeError("cannot apply " + string_utils::from(op) + " operator on different types");
 
-    return Value(std::sin(result.numeric));
+    switch(op)
+    {
+        case Operator::OP_ADD:
+            if(accumulator.type == ValueType::VT_NUMERIC)
+                accumulator.numeric += operand.numeric;
+            else if(accumulator.type == ValueType::VT_STRING)
+                accumulator = Value(StringObject::concatenate(accumulator.string, operand.string));
+            break;
+        case Operator::OP_SUB:
+            accumulator.numeric -= operand.numeric;
+            break;
+        case Operator::OP_MUL:
+            accumulator.numeric *= operand.numeric;
+            break;
+        case Operator::OP_DIV:
+            accumulator.numeric /= operand.numeric;
+            break;
+        case Operator::OP_MOD:
+            accumulator.numeric = std::fmod(accumulator.numeric, operand.numeric);
+            break;
+        case Operator::OP_POW:
+            accumulator.numeric = std::pow(accumulator.numeric, operand.numeric);
+            break;
+        case Operator::OP_PROGRAM:
+        case Operator::OP_ASSIGN:
+        case Operator::OP_TO_NUMERIC:
+        case Operator::OP_TO_STRING:
+        case Operator::OP_PRINT:
+        case Operator::OP_INPUT:
+        case Operator::OP_IF:
+        case Operator::OP_FUNCTION:
+        case Operator::OP_CALL:
+        case Operator::OP_SIN:
+        case Operator::OP_COS:
+        case Operator::OP_TAN:
+        case Operator::OP_ASIN:
+        case Operator::OP_ACOS:
+        case Operator::OP_ATAN:
+        case Operator::OP_TO_RAD:
+        case Operator::OP_TO_DEG:
+        case Operator::OP_LN:
+        case Operator::OP_EXP:
+        case Operator::OP_LOG10:
+        case Operator::OP_SQUARE:
+        case Operator::OP_NONE:
+        default:
+            errors::runtimeError("internal: " + string_utils::from(op) + " is not a binary maths operator");
+            break;
+    }
 }
 
-Value Runtime::cos(std::vector<Node*> nodes)
+float Runtime::applyUnary(Operator op, const Value& operand)
 {
-    if(nodes.size() != 1)
-        errors::runtimeError("cos operator only takes one argument");
+    checkOperand(op, operand);
 
-    Value result = this->eval(nodes.front());
+    switch(op)
+    {
+        case Operator::OP_SIN:
+            return std::sin(operand.numeric);
+        case Operator::OP_COS:
+            return std::cos(operand.numeric);
+        case Operator::OP_TAN:
+            return std::tan(operand.numeric);
+        case Operator::OP_ASIN:
+            return std::asin(operand.numeric);
+        case Operator::OP_ACOS:
+            return std::acos(operand.numeric);
+        case Operator::OP_ATAN:
+            return std::atan(operand.numeric);
+        case Operator::OP_TO_RAD:
+            return operand.numeric * radiansPerDegree;
+        case Operator::OP_TO_DEG:
+            return operand.numeric * degreesPerRadian;
+        case Operator::OP_LN:
+            return std::log(operand.numeric);
+        case Operator::OP_EXP:
+            return std::exp(operand.numeric);
+        case Operator::OP_LOG10:
+            return std::log10(operand.numeric);
+        case Operator::OP_SQUARE:
+            // Exact in double, the product rounds as std::pow.
+            return operand.numeric * operand.numeric;
+        case Operator::OP_PROGRAM:
+        case Operator::OP_ASSIGN:
+        case Operator::OP_TO_NUMERIC:
+        case Operator::OP_TO_STRING:
+        case Operator::OP_PRINT:
+        case Operator::OP_INPUT:
+        case Operator::OP_IF:
+        case Operator::OP_FUNCTION:
+        case Operator::OP_CALL:
+        case Operator::OP_ADD:
+        case Operator::OP_SUB:
+        case Operator::OP_MUL:
+        case Operator::OP_DIV:
+        case Operator::OP_MOD:
+        case Operator::OP_POW:
+        case Operator::OP_NONE:
+        default:
+            break;
+    }
 
-    // The ValueType.
-    ValueType currentValueType = result.type;
+    errors::runtimeError("internal: " + string_utils::from(op) + " is not a unary maths operator");
+    return 0.f;
+}
 
-    // Cannot apply on non-typed values.
-    if(currentValueType == ValueType::VT_NONE)
-        errors::runtimeError("cannot apply cos operator on non-typed values");
+Value Runtime::convertToNumeric(const Value& value)
+{
+    // Convert str -> num.
+    if(value.type == ValueType::VT_STRING)
+        return Value(string_utils::parseFloat(value.string->getData(), value.string->getData() + value.string->getSize()));
 
-    // Cannot apply on strings.
-    if(currentValueType == ValueType::VT_STRING)
-        errors::runtimeError("cannot apply cos operator on strings");
+    if(value.type == ValueType::VT_NUMERIC)
+        return value;
 
-    return Value(std::cos(result.numeric));
+    return Value(0.f);
 }
 
-Value Runtime::tan(std::vector<Node*> nodes)
+Value Runtime::convertToString(const Value& value)
 {
-    if(nodes.size() != 1)
-        errors::runtimeError("tan operator only takes one argument");
+    // Convert num -> str.
+    if(value.type == ValueType::VT_NUMERIC)
+    {
+        char buffer[string_utils::maxFloatLength];
+        std::size_t length = string_utils::formatFloat(value.numeric, buffer);
 
-    Value result = this->eval(nodes.front());
+        return Value(StringObject::create(buffer, length));
+    }
 
-    // The ValueType.
-    ValueType currentValueType = result.type;
+    if(value.type == ValueType::VT_STRING)
+        return value;
 
-    // Cannot apply on non-typed values.
-    if(currentValueType == ValueType::VT_NONE)
-        errors::runtimeError("cannot apply tan operator on non-typed values");
+    return Value(std::string(""));
+}
 
-    // Cannot apply on strings.
-    if(currentValueType == ValueType::VT_STRING)
-        errors::runtimeError("cannot apply tan operator on strings");
+void Runtime::printValue(const Value& value)
+{
+    if(value.type == ValueType::VT_NUMERIC)
+    {
+        char buffer[string_utils::maxFloatLength];
+        std::cout.write(buffer, static_cast<std::streamsize>(string_utils::formatFloat(value.numeric, buffer)));
+    }
+    else if(value.type == ValueType::VT_STRING)
+        std::cout.write(value.string->getData(), static_cast<std::streamsize>(value.string->getSize()));
+}
+
+Value Runtime::readInput()
+{
+    std::string word("");
+    std::cin >> word;
 
-    return Value(std::tan(result.numeric));
+    Value inputvalue(word);
+    return inputvalue;
 }
 
-Value Runtime::asin(std::vector<Node*> nodes)
+bool Runtime::isTrue(const Value& value)
 {
-    if(nodes.size() != 1)
-        errors::runtimeError("asin operator only takes one argument");
+    if(value.type == ValueType::VT_NUMERIC)
+        return std::fpclassify(value.numeric) != FP_ZERO;
 
-    Value result = this->eval(nodes.front());
+    if(value.type == ValueType::VT_STRING)
+        return value.string->getSize() != 0;
 
-    // The ValueType.
-    ValueType currentValueType = result.type;
+    return false;
+}
 
-    // Cannot apply on non-typed values.
-    if(currentValueType == ValueType::VT_NONE)
-        errors::runtimeError("cannot apply asin operator on non-typed values");
+Node* Runtime::branch(NodeList nodes)
+{
+    if(nodes.size() != 2 && nodes.size() != 3)
+        errors::runtimeError("if operator takes a condition, a value and an optional alternative");
 
-    // Cannot apply on strings.
-    if(currentValueType == ValueType::VT_STRING)
-        errors::runtimeError("cannot apply asin operator on strings");
+    if(isTrue(eval(nodes[0])))
+        return nodes[1];
 
-    return Value(std::asin(result.numeric));
+    return nodes.size() == 3 ? nodes[2] : nullptr;
 }
 
-Value Runtime::acos(std::vector<Node*> nodes)
+bool Runtime::branch(FlatAst& ast, NodeIndex index, NodeIndex& chosen)
 {
-    if(nodes.size() != 1)
-        errors::runtimeError("acos operator only takes one argument");
+    const NodeIndex* children = ast.getChildren(index);
+    std::uint32_t count = ast.getChildCount(index);
 
-    Value result = this->eval(nodes.front());
+    if(count != 2 && count != 3)
+        errors::runtimeError("if operator takes a condition, a value and an optional alternative");
 
-    // The ValueType.
-    ValueType currentValueType = result.type;
+    if(isTrue(eval(ast, children[0])))
+        chosen = children[1];
+    else if(count == 3)
+        chosen = children[2];
+    else
+        return false;
 
-    // Cannot apply on non-typed values.
-    if(currentValueType == ValueType::VT_NONE)
-        errors::runtimeError("cannot apply acos operator on non-typed values");
+    return true;
+}
 
-    // Cannot apply on strings.
-    if(currentValueType == ValueType::VT_STRING)
-        errors::runtimeError("cannot apply acos operator on strings");
+/** Special built-in operations. */
+Value Runtime::program(NodeList nodes)
+{
+    for(Node* child : nodes)
+        this->eval(child);
 
-    return Value(std::acos(result.numeric));
+    return Value();
 }
 
-Value Runtime::atan(std::vector<Node*> nodes)
+Value Runtime::assign(NodeList nodes)
 {
-    if(nodes.size() != 1)
-        errors::runtimeError("atan operator only takes one argument");
+    if(nodes.size() != 2)
+        errors::runtimeError("assign operator takes exactly two operators");
 
-    Value result = this->eval(nodes.front());
+    if(nodes.front()->getType() != NodeType::NT_IDENTIFIER && nodes.front()->getType() != NodeType::NT_LOCAL)
+        errors::runtimeError("first parameter of assign operator must be an identifier");
 
-    // The ValueType.
-    ValueType currentValueType = result.type;
+    if(nodes.back()->getType() != NodeType::NT_CONST_VALUE && nodes.back()->getType() != NodeType::NT_EXPRESSION)
+        errors::runtimeError("second parameter of assign operator must be a constant value or an expression");
 
-    // Cannot apply on non-typed values.
-    if(currentValueType == ValueType::VT_NONE)
-        errors::runtimeError("cannot apply atan operator on non-typed values");
+    if(nodes.front()->getType() == NodeType::NT_LOCAL)
+    {
+        // Evaluated first : the calls of the value may move the stack.
+        Value value = this->eval(nodes.back());
+        m_stack[m_frame + nodes.front()->getSlot()] = std::move(value);
+
+        return Value();
+    }
 
-    // Cannot apply on strings.
-    if(currentValueType == ValueType::VT_STRING)
-        errors::runtimeError("cannot apply atan operator on strings");
+    // Get the variable name & eval the value.
+    // If the variable already exist, it is overwritten.
+    // Otherwise it create the new variable.
+    m_variables[nodes.front()->getSlot()] = this->eval(nodes.back());
 
-    return Value(std::atan(result.numeric));
+    // Return value type = VT_NONE.
+    return Value();
 }
 
-Value Runtime::to_rad(std::vector<Node*> nodes)
+Value Runtime::to_numeric(NodeList nodes)
 {
     if(nodes.size() != 1)
-        errors::runtimeError("to_rad operator only takes one argument");
+        errors::runtimeError("to_numeric operator takes only one operators");
 
-    Value result = this->eval(nodes.front());
+    return convertToNumeric(eval(nodes.front()));
+}
 
-    // The ValueType.
-    ValueType currentValueType = result.type;
+Value Runtime::to_string(NodeList nodes)
+{
+    if(nodes.size() != 1)
+        errors::runtimeError("to_string operator takes only one operator");
 
-    // Cannot apply on non-typed values.
-    if(currentValueType == ValueType::VT_NONE)
-        errors::runtimeError("cannot apply to_rad operator on non-typed values");
+    return convertToString(eval(nodes.front()));
+}
 
-    // Cannot apply on strings.
-    if(currentValueType == ValueType::VT_STRING)
-        errors::runtimeError("cannot apply to_rad operator on strings");
+Value Runtime::print(NodeList nodes)
+{
+    for(Node* child : nodes)
+        printValue(this->eval(child));
 
-    return result.numeric * M_PI / 180.0;
+    // Return value type = VT_NONE.
+    return Value();
 }
 
-Value Runtime::to_deg(std::vector<Node*> nodes)
+Value Runtime::input(NodeList nodes)
 {
-    if(nodes.size() != 1)
-        errors::runtimeError("to_deg operator only takes one argument");
+    // Output prompt.
+    print(nodes);
 
-    Value result = this->eval(nodes.front());
+    return readInput();
+}
 
-    // The ValueType.
-    ValueType currentValueType = result.type;
+Value Runtime::condition(NodeList nodes)
+{
+    // Only the chosen branch is evaluated.
+    Node* chosen = branch(nodes);
 
-    // Cannot apply on non-typed values.
-    if(currentValueType == ValueType::VT_NONE)
-        errors::runtimeError("cannot apply to_deg operator on non-typed values");
+    return chosen ? eval(chosen) : Value();
+}
+
+/** Maths built-in operations. */
+Value Runtime::fold(Operator op, NodeList nodes)
+{
+    Value result = this->eval(nodes.front());
+    checkOperand(op, result);
 
-    // Cannot apply on strings.
-    if(currentValueType == ValueType::VT_STRING)
-        errors::runtimeError("cannot apply to_deg operator on strings");
+    // Left fold : (- a b c) => (a - b) - c.
+    for(Node* const* it(nodes.begin() + 1) ; it != nodes.end() ; ++it)
+        applyBinary(op, result, this->eval(*it));
 
-    return result.numeric * (180.0 / M_PI);
+    return result;
 }
 
-Value Runtime::ln(std::vector<Node*> nodes)
+Value Runtime::unary(Operator op, NodeList nodes)
 {
     if(nodes.size() != 1)
-        errors::runtimeError("ln operator only takes one argument");
+        errors::runtimeError(string_utils::from(op) + " operator only takes one argument");
 
-    Value result = this->eval(nodes.front());
+    return Value(applyUnary(op, this->eval(nodes.front())));
+}
 
-    // The ValueType.
-    ValueType currentValueType = result.type;
+Value Runtime::add(NodeList nodes)
+{
+    return fold(Operator::OP_ADD, nodes);
+}
 
-    // Cannot apply on non-typed values.
-    if(currentValueType == ValueType::VT_NONE)
-        errors::runtimeError("cannot apply ln operator on non-typed values");
+Value Runtime::sub(NodeList nodes)
+{
+    return fold(Operator::OP_SUB, nodes);
+}
 
-    // Cannot apply on strings.
-    if(currentValueType == ValueType::VT_STRING)
-        errors::runtimeError("cannot apply ln operator on strings");
+Value Runtime::mul(NodeList nodes)
+{
+    return fold(Operator::OP_MUL, nodes);
+}
 
-    return std::log(result.numeric);
+Value Runtime::div(NodeList nodes)
+{
+    return fold(Operator::OP_DIV, nodes);
 }
 
-Value Runtime::exp(std::vector<Node*> nodes)
+Value Runtime::mod(NodeList nodes)
 {
-    if(nodes.size() != 1)
-        errors::runtimeError("exp operator only takes one argument");
+    return fold(Operator::OP_MOD, nodes);
+}
 
-    Value result = this->eval(nodes.front());
+Value Runtime::pow(NodeList nodes)
+{
+    return fold(Operator::OP_POW, nodes);
+}
 
-    // The ValueType.
-    ValueType currentValueType = result.type;
+Value Runtime::sin(NodeList nodes)
+{
+    return unary(Operator::OP_SIN, nodes);
+}
 
-    // Cannot apply on non-typed values.
-    if(currentValueType == ValueType::VT_NONE)
-        errors::runtimeError("cannot apply exp operator on non-typed values");
+Value Runtime::cos(NodeList nodes)
+{
+    return unary(Operator::OP_COS, nodes);
+}
 
-    // Cannot apply on strings.
-    if(currentValueType == ValueType::VT_STRING)
-        errors::runtimeError("cannot apply exp operator on strings");
+Value Runtime::tan(NodeList nodes)
+{
+    return unary(Operator::OP_TAN, nodes);
+}
 
-    return std::exp(result.numeric);
+Value Runtime::asin(NodeList nodes)
+{
+    return unary(Operator::OP_ASIN, nodes);
 }
 
-Value Runtime::log10(std::vector<Node*> nodes)
+Value Runtime::acos(NodeList nodes)
 {
-    if(nodes.size() != 1)
-        errors::runtimeError("log10 operator only takes one argument");
+    return unary(Operator::OP_ACOS, nodes);
+}
 
-    Value result = this->eval(nodes.front());
+Value Runtime::atan(NodeList nodes)
+{
+    return unary(Operator::OP_ATAN, nodes);
+}
+
+Value Runtime::to_rad(NodeList nodes)
+{
+    return unary(Operator::OP_TO_RAD, nodes);
+}
 
-    // The ValueType.
-    ValueType currentValueType = result.type;
+Value Runtime::to_deg(NodeList nodes)
+{
+    return unary(Operator::OP_TO_DEG, nodes);
+}
 
-    // Cannot apply on non-typed values.
-    if(currentValueType == ValueType::VT_NONE)
-        errors::runtimeError("cannot apply log10 operator on non-typed values");
+Value Runtime::ln(NodeList nodes)
+{
+    return unary(Operator::OP_LN, nodes);
+}
 
-    // Cannot apply on strings.
-    if(currentValueType == ValueType::VT_STRING)
-        errors::runtimeError("cannot apply log10 operator on strings");
+Value Runtime::exp(NodeList nodes)
+{
+    return unary(Operator::OP_EXP, nodes);
+}
+
+Value Runtime::log10(NodeList nodes)
+{
+    return unary(Operator::OP_LOG10, nodes);
+}
 
-    return std::log10(result.numeric);
+Value Runtime::square(NodeList nodes)
+{
+    return unary(Operator::OP_SQUARE, nodes);
 }
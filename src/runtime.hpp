@@ -29,9 +29,16 @@
 #define RUNTIME_HPP_INCLUDED
 
 #include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
+#include "arena.hpp"
+#include "bytecode.hpp"
 #include "datatypes.hpp"
+#include "flat_ast.hpp"
+#include "function.hpp"
+#include "symbol_table.hpp"
 #include "errors.hpp"
 
 class Runtime
@@ -39,47 +46,173 @@ class Runtime
     public:
         Runtime();
 
+        // Forget the variables and the functions.
         void clear();
 
+        // The variable slot of an identifier is its symbol.
+        SymbolTable& getSymbols();
+
+        // Give a variable slot to the symbols interned since the last call.
+        void declareSymbols();
+
+        // Memoize the results of the pure functions by their arguments, off by default.
+        void setMemoization(bool enabled);
+
+        // The functions bound, indexed by the symbol of their name, for their memo tables.
+        const std::vector<std::shared_ptr<Function>>& getFunctions() const;
+
+        /** Tree-walking evaluation of an AST. */
         Value eval(Node* node);
 
+        /** Evaluation of a flat AST, from its root or from the given node. */
+        Value eval(FlatAst& ast);
+        Value eval(FlatAst& ast, NodeIndex index);
+
+        /** Execution of a compiled program by the virtual machine (see vm.cpp). */
+        Value execute(Bytecode& bytecode);
+
+        // The truth of a condition : null, 0 and the empty string are false.
+        static bool isTrue(const Value& value);
+
     protected:
-        Value getVariable(const std::string& identifier);
+        static Value unassigned();
+
+        const Value& getVariable(std::uint32_t slot);
+        const Value& getLocal(std::uint32_t slot);
+
+        /** User-defined functions, shared by the evaluators and the virtual machine. */
+        // The function called by (name arguments...). nullptr if there is none but no arguments either : (name) reads the variable.
+        Function* getFunction(Symbol name, std::size_t argumentCount);
+        // Room for size values on the stack, which may move.
+        void reserveStack(std::size_t size);
+
+        // Function definitions and calls of the evaluators. A tail call moves its arguments to the frame
+        // of the caller and leaves its function to callBody, instead of evaluating the body itself.
+        Value define(Node* node);
+        Value call(NodeList nodes, bool tail = false);
+        Value define(FlatAst& ast, NodeIndex index);
+        Value call(FlatAst& ast, NodeIndex index, bool tail = false);
+        Value tailCall(Function* function, std::size_t arguments, std::size_t count);
+        // Evaluate the body of a function, its arguments are on the stack from the frame slot.
+        Value callBody(Function* function, std::size_t frame);
+        // The memo table of a function, nullptr if memoization is off or if it is not pure : it does not print,
+        // read the input or a global variable nor define a function, and nor do the functions it calls.
+        MemoTable* memoTable(Function* function);
+        bool isPure(Function* function);
+        // Evaluate the body of a function, with its calls in tail position as tail calls.
+        Value evalTail(Node* node);
+        Value evalTail(FlatAst& ast, NodeIndex index);
+
+        /** Operations shared by the tree-walking evaluator and the virtual machine. */
+        void checkOperand(Operator op, const Value& operand);
+        void applyBinary(Operator op, Value& accumulator, const Value& operand);
+        float applyUnary(Operator op, const Value& operand);
+
+        Value convertToNumeric(const Value& value);
+        Value convertToString(const Value& value);
+
+        void printValue(const Value& value);
+        Value readInput();
+
+        // The branch chosen by the condition of (if condition then [else]), nullptr or false if there is no alternative.
+        Node* branch(NodeList nodes);
+        bool branch(FlatAst& ast, NodeIndex index, NodeIndex& chosen);
 
         /** Specials built-in operations. */
-        Value program(std::vector<Node*> nodes);
-        Value assign(std::vector<Node*> nodes);
+        Value program(NodeList nodes);
+        Value assign(NodeList nodes);
+
+        Value to_numeric(NodeList nodes);
+        Value to_string(NodeList nodes);
 
-        Value to_numeric(std::vector<Node*> nodes);
-        Value to_string(std::vector<Node*> nodes);
+        Value print(NodeList nodes);
+        Value input(NodeList nodes);
 
-        Value print(std::vector<Node*> nodes);
-        Value input(std::vector<Node*> nodes);
+        Value condition(NodeList nodes);
 
         /** Maths built-in operations. */
-        Value add(std::vector<Node*> nodes),
-              sub(std::vector<Node*> nodes),
-              mul(std::vector<Node*> nodes),
-              div(std::vector<Node*> nodes),
-              mod(std::vector<Node*> nodes),
-              pow(std::vector<Node*> nodes),
-
-              sin(std::vector<Node*> nodes),
-              cos(std::vector<Node*> nodes),
-              tan(std::vector<Node*> nodes),
-              asin(std::vector<Node*> nodes),
-              acos(std::vector<Node*> nodes),
-              atan(std::vector<Node*> nodes),
-
-              to_rad(std::vector<Node*> nodes),
-              to_deg(std::vector<Node*> nodes),
-
-              ln(std::vector<Node*> nodes),
-              exp(std::vector<Node*> nodes),
-              log10(std::vector<Node*> nodes);
+        Value fold(Operator op, NodeList nodes);
+        Value unary(Operator op, NodeList nodes);
+
+        Value add(NodeList nodes),
+              sub(NodeList nodes),
+              mul(NodeList nodes),
+              div(NodeList nodes),
+              mod(NodeList nodes),
+              pow(NodeList nodes),
+
+              sin(NodeList nodes),
+              cos(NodeList nodes),
+              tan(NodeList nodes),
+              asin(NodeList nodes),
+              acos(NodeList nodes),
+              atan(NodeList nodes),
+
+              to_rad(NodeList nodes),
+              to_deg(NodeList nodes),
+
+              ln(NodeList nodes),
+              exp(NodeList nodes),
+              log10(NodeList nodes),
+              square(NodeList nodes);
 
     protected:
-        std::map<std::string, Value> m_variables;
+        /** Variables, indexed by slot. */
+        std::vector<Value> m_variables;
+        SymbolTable m_symbols;
+
+        // Operands of the virtual machine and frames of the calls, which start with the locals of their function.
+        std::vector<Value> m_stack;
+
+        // Nested calls : the evaluators recurse on the native stack, the virtual machine does not.
+        static const std::size_t maxEvalDepth = 2000;
+        static const std::size_t maxExecuteDepth = 1 << 20;
+        // Nested expressions of the evaluators, those of the bodies of the nested calls included.
+        static const std::size_t maxNestingDepth = 20000;
+
+        /** User-defined functions, indexed by the symbol of their name, nullptr if there is none. */
+        std::vector<std::shared_ptr<Function>> m_functions;
+
+        // Functions of the evaluators, with the copies of their bodies, kept as long as the runtime :
+        // a definition node keeps the index of its function, to be copied only once.
+        std::vector<std::shared_ptr<Function>> m_definitions;
+        Arena m_functionNodes;
+
+        // The innermost call of the evaluators : its function, its frame in the stack, the first free slot.
+        Function* m_function;
+        std::size_t m_frame;
+        std::size_t m_top;
+        std::size_t m_depth;
+        // Expressions being evaluated by the evaluators, one inside the other.
+        std::size_t m_nesting;
+
+        // The function of the tail call which ended the body being evaluated, nullptr if none.
+        Function* m_tailCall;
+
+        bool m_memoize;
+        // Generation of the bindings of the functions, incremented by each definition : it tells whether the purity
+        // of a function and its memoized results are still valid.
+        std::size_t m_bindings;
+        // The arguments of the memoized calls being evaluated, innermost last.
+        std::vector<Value> m_memoKeys;
+
+        // A call of the virtual machine : where to return, and the frame and the code of the caller.
+        struct Frame
+        {
+            Instruction* returnAddress;
+            std::size_t frame;
+            Bytecode* bytecode;
+            Function* function;
+
+            // The table of the callee, to record its result in, nullptr if it is not memoized.
+            MemoTable* memo;
+        };
+
+        // Innermost last.
+        std::vector<Frame> m_frames;
+
+        // Functions redefined during an execution, kept until the next one : their code may still be running.
+        std::vector<std::shared_ptr<Function>> m_retired;
 };
 
 #endif // RUNTIME_HPP_INCLUDED
@@ -0,0 +1,313 @@
+#include "scan.hpp"
+
+/// x86 vector paths : SSE2 is always there on x86-64, AVX2 is detected at startup.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+    #define SCAN_X86
+    #include <immintrin.h>
+#endif
+
+namespace
+{
+    /** Scalar versions, also used for the tails shorter than a vector. */
+    bool is_whitespace(char c)
+    {
+        // '\t', '\n', '\v', '\f' and '\r' follow each other.
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+
+    const char* skip_whitespace_scalar(const char* cursor, const char* end)
+    {
+        while(cursor != end && is_whitespace(*cursor))
+            ++cursor;
+
+        return cursor;
+    }
+
+    const char* find_line_end_scalar(const char* cursor, const char* end)
+    {
+        while(cursor != end && *cursor != '\n' && *cursor != '\r')
+            ++cursor;
+
+        return cursor;
+    }
+
+    const char* find_string_end_scalar(const char* cursor, const char* end)
+    {
+        while(cursor != end && *cursor != '"' && *cursor != '\\')
+            ++cursor;
+
+        return cursor;
+    }
+
+    const char* find_string_or_comment_scalar(const char* cursor, const char* end)
+    {
+        while(cursor != end && *cursor != '"' && *cursor != '#')
+            ++cursor;
+
+        return cursor;
+    }
+
+    #ifdef SCAN_X86
+    /** SSE2 versions : 16 bytes at a time, the bits of the mask are the matching bytes. */
+    const char* skip_whitespace_sse2(const char* cursor, const char* end)
+    {
+        const __m128i tab = _mm_set1_epi8('\t');
+        const __m128i four = _mm_set1_epi8(4);
+        const __m128i space = _mm_set1_epi8(' ');
+
+        for( ; end - cursor >= 16 ; cursor += 16)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cursor));
+
+            // c - '\t' <= 4 (unsigned) for '\t' to '\r'.
+            __m128i shifted = _mm_sub_epi8(chunk, tab);
+            __m128i controls = _mm_cmpeq_epi8(_mm_min_epu8(shifted, four), shifted);
+            __m128i whitespaces = _mm_or_si128(controls, _mm_cmpeq_epi8(chunk, space));
+
+            unsigned int mask = ~static_cast<unsigned int>(_mm_movemask_epi8(whitespaces)) & 0xFFFFu;
+
+            if(mask != 0)
+                return cursor + __builtin_ctz(mask);
+        }
+
+        return skip_whitespace_scalar(cursor, end);
+    }
+
+    const char* find_line_end_sse2(const char* cursor, const char* end)
+    {
+        const __m128i lf = _mm_set1_epi8('\n');
+        const __m128i cr = _mm_set1_epi8('\r');
+
+        for( ; end - cursor >= 16 ; cursor += 16)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cursor));
+            unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, lf), _mm_cmpeq_epi8(chunk, cr))));
+
+            if(mask != 0)
+                return cursor + __builtin_ctz(mask);
+        }
+
+        return find_line_end_scalar(cursor, end);
+    }
+
+    const char* find_string_end_sse2(const char* cursor, const char* end)
+    {
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+
+        for( ; end - cursor >= 16 ; cursor += 16)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cursor));
+            unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash))));
+
+            if(mask != 0)
+                return cursor + __builtin_ctz(mask);
+        }
+
+        return find_string_end_scalar(cursor, end);
+    }
+
+    const char* find_string_or_comment_sse2(const char* cursor, const char* end)
+    {
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i hash = _mm_set1_epi8('#');
+
+        for( ; end - cursor >= 16 ; cursor += 16)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cursor));
+            unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, hash))));
+
+            if(mask != 0)
+                return cursor + __builtin_ctz(mask);
+        }
+
+        return find_string_or_comment_scalar(cursor, end);
+    }
+
+    /** AVX2 versions : the same on 32 bytes, compiled for AVX2 whatever the compiler flags. */
+    __attribute__((target("avx2")))
+    const char* skip_whitespace_avx2(const char* cursor, const char* end)
+    {
+        const __m256i tab = _mm256_set1_epi8('\t');
+        const __m256i four = _mm256_set1_epi8(4);
+        const __m256i space = _mm256_set1_epi8(' ');
+
+        for( ; end - cursor >= 32 ; cursor += 32)
+        {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cursor));
+
+            __m256i shifted = _mm256_sub_epi8(chunk, tab);
+            __m256i controls = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, four), shifted);
+            __m256i whitespaces = _mm256_or_si256(controls, _mm256_cmpeq_epi8(chunk, space));
+
+            unsigned int mask = ~static_cast<unsigned int>(_mm256_movemask_epi8(whitespaces));
+
+            if(mask != 0)
+                return cursor + __builtin_ctz(mask);
+        }
+
+        return skip_whitespace_sse2(cursor, end);
+    }
+
+    __attribute__((target("avx2")))
+    const char* find_line_end_avx2(const char* cursor, const char* end)
+    {
+        const __m256i lf = _mm256_set1_epi8('\n');
+        const __m256i cr = _mm256_set1_epi8('\r');
+
+        for( ; end - cursor >= 32 ; cursor += 32)
+        {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cursor));
+            unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, lf), _mm256_cmpeq_epi8(chunk, cr))));
+
+            if(mask != 0)
+                return cursor + __builtin_ctz(mask);
+        }
+
+        return find_line_end_sse2(cursor, end);
+    }
+
+    __attribute__((target("avx2")))
+    const char* find_string_end_avx2(const char* cursor, const char* end)
+    {
+        const __m256i quote = _mm256_set1_epi8('"');
+        const __m256i backslash = _mm256_set1_epi8('\\');
+
+        for( ; end - cursor >= 32 ; cursor += 32)
+        {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cursor));
+            unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, backslash))));
+
+            if(mask != 0)
+                return cursor + __builtin_ctz(mask);
+        }
+
+        return find_string_end_sse2(cursor, end);
+    }
+
+    __attribute__((target("avx2")))
+    const char* find_string_or_comment_avx2(const char* cursor, const char* end)
+    {
+        const __m256i quote = _mm256_set1_epi8('"');
+        const __m256i hash = _mm256_set1_epi8('#');
+
+        for( ; end - cursor >= 32 ; cursor += 32)
+        {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cursor));
+            unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, hash))));
+
+            if(mask != 0)
+                return cursor + __builtin_ctz(mask);
+        }
+
+        return find_string_or_comment_sse2(cursor, end);
+    }
+    #endif // SCAN_X86
+
+    struct Scanner
+    {
+        scan::InstructionSet instructionSet;
+
+        const char* (*skipWhitespace)(const char*, const char*);
+        const char* (*findLineEnd)(const char*, const char*);
+        const char* (*findStringEnd)(const char*, const char*);
+        const char* (*findStringOrComment)(const char*, const char*);
+    };
+
+    const Scanner scanners[] =
+    {
+        {scan::InstructionSet::SCALAR, skip_whitespace_scalar, find_line_end_scalar, find_string_end_scalar, find_string_or_comment_scalar},
+        #ifdef SCAN_X86
+        {scan::InstructionSet::SSE2, skip_whitespace_sse2, find_line_end_sse2, find_string_end_sse2, find_string_or_comment_sse2},
+        {scan::InstructionSet::AVX2, skip_whitespace_avx2, find_line_end_avx2, find_string_end_avx2, find_string_or_comment_avx2}
+        #endif // SCAN_X86
+    };
+
+    bool is_supported(scan::InstructionSet instructionSet)
+    {
+        #ifdef SCAN_X86
+        // Needed when called before main, by the initialization of selected.
+        __builtin_cpu_init();
+        #endif // SCAN_X86
+
+        switch(instructionSet)
+        {
+            #ifdef SCAN_X86
+            case scan::InstructionSet::SSE2:
+                return true;
+            case scan::InstructionSet::AVX2:
+                return __builtin_cpu_supports("avx2");
+            #endif // SCAN_X86
+            case scan::InstructionSet::SCALAR:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    const Scanner* best_scanner()
+    {
+        const Scanner* best = &scanners[0];
+
+        for(const Scanner& scanner : scanners)
+        {
+            if(is_supported(scanner.instructionSet))
+                best = &scanner;
+        }
+
+        return best;
+    }
+
+    const Scanner* selected = best_scanner();
+}
+
+bool scan::select(InstructionSet instructionSet)
+{
+    for(const Scanner& scanner : scanners)
+    {
+        if(scanner.instructionSet == instructionSet && is_supported(instructionSet))
+        {
+            selected = &scanner;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+scan::InstructionSet scan::getSelected()
+{
+    return selected->instructionSet;
+}
+
+const char* scan::skipWhitespace(const char* cursor, const char* end)
+{
+    return selected->skipWhitespace(cursor, end);
+}
+
+const char* scan::findLineEnd(const char* cursor, const char* end)
+{
+    return selected->findLineEnd(cursor, end);
+}
+
+const char* scan::findStringEnd(const char* cursor, const char* end)
+{
+    return selected->findStringEnd(cursor, end);
+}
+
+const char* scan::findStringOrComment(const char* cursor, const char* end)
+{
+    return selected->findStringOrComment(cursor, end);
+}
+
+template<>
+std::string string_utils::from(scan::InstructionSet instructionSet)
+{
+    switch(instructionSet)
+    {
+        case scan::InstructionSet::SSE2: return "sse2";
+        case scan::InstructionSet::AVX2: return "avx2";
+        case scan::InstructionSet::SCALAR:
+        default: return "scalar";
+    }
+}
@@ -0,0 +1,67 @@
+/*
+	scan.hpp
+
+	The MIT License (MIT)
+
+	Copyright (c) 2014 Maxime Alvarez
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+	Defines the byte scans the lexer spends most of its time in, vectorized when the CPU allows it.
+*/
+
+#ifndef SCAN_HPP_INCLUDED
+#define SCAN_HPP_INCLUDED
+
+#include <string>
+
+#include "string_utils.hpp"
+
+namespace scan
+{
+    enum class InstructionSet
+    {
+        SCALAR,
+        SSE2,
+        AVX2
+    };
+
+    // Use the given instruction set if the CPU supports it, return false otherwise.
+    // The best one is selected at startup.
+    bool select(InstructionSet instructionSet);
+    InstructionSet getSelected();
+
+    // Each scan returns end when nothing is found.
+
+    // First character after the whitespaces from cursor.
+    const char* skipWhitespace(const char* cursor, const char* end);
+
+    // First '\n' or '\r' from cursor.
+    const char* findLineEnd(const char* cursor, const char* end);
+
+    // First '"' or '\\' from cursor.
+    const char* findStringEnd(const char* cursor, const char* end);
+
+    // First '"' or '#' from cursor.
+    const char* findStringOrComment(const char* cursor, const char* end);
+}
+
+template<>
+std::string string_utils::from(scan::InstructionSet instructionSet);
+
+#endif // SCAN_HPP_INCLUDED
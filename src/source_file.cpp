@@ -0,0 +1,84 @@
+#include "source_file.hpp"
+#include "errors.hpp"
+
+#include <fstream>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #define SOURCE_FILE_MMAP
+
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+SourceFile::SourceFile(const std::string& filepath)
+    : m_data(nullptr)
+    , m_size(0)
+    , m_mapped(false)
+{
+    #ifdef SOURCE_FILE_MMAP
+    int descriptor = ::open(filepath.c_str(), O_RDONLY);
+
+    if(descriptor < 0)
+        errors::runtimeError("cannot open file : \"" + filepath + "\"");
+
+    struct stat status;
+
+    if(::fstat(descriptor, &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0)
+    {
+        void* address = ::mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+
+        if(address != MAP_FAILED)
+        {
+            // The lexer reads the file once, from the beginning to the end.
+            ::madvise(address, static_cast<std::size_t>(status.st_size), MADV_SEQUENTIAL);
+
+            m_data = static_cast<const char*>(address);
+            m_size = static_cast<std::size_t>(status.st_size);
+            m_mapped = true;
+        }
+    }
+
+    // The mapping stays valid once the file is closed.
+    ::close(descriptor);
+
+    if(m_mapped)
+        return;
+    #endif // SOURCE_FILE_MMAP
+
+    // Fallback : read the whole file in one go.
+    std::ifstream inputfile(filepath.c_str(), std::ios::binary);
+
+    if(!inputfile)
+        errors::runtimeError("cannot open file : \"" + filepath + "\"");
+
+    inputfile.seekg(0, std::ios::end);
+    std::streamoff size = inputfile.tellg();
+    inputfile.seekg(0, std::ios::beg);
+
+    if(size > 0)
+    {
+        m_buffer.resize(static_cast<std::size_t>(size));
+        inputfile.read(m_buffer.data(), size);
+        m_buffer.resize(static_cast<std::size_t>(inputfile.gcount()));
+    }
+    else
+    {
+        // Unknown size (pipes, devices...).
+        inputfile.clear();
+        m_buffer.assign(std::istreambuf_iterator<char>(inputfile), std::istreambuf_iterator<char>());
+    }
+
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+}
+
+SourceFile::~SourceFile()
+{
+    #ifdef SOURCE_FILE_MMAP
+    if(m_mapped)
+        ::munmap(const_cast<char*>(m_data), m_size);
+    #endif // SOURCE_FILE_MMAP
+}
@@ -0,0 +1,70 @@
+/*
+	source_file.hpp
+
+	The MIT License (MIT)
+
+	Copyright (c) 2014 Maxime Alvarez
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+	Defines the read-only view on a source file given to the lexer.
+*/
+
+#ifndef SOURCE_FILE_HPP_INCLUDED
+#define SOURCE_FILE_HPP_INCLUDED
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/// Memory map the file where it is supported (POSIX), read it at once otherwise.
+/// Either way the content is never copied again : the lexer works in place.
+class SourceFile
+{
+    public:
+        SourceFile(const std::string& filepath);
+        ~SourceFile();
+
+        SourceFile(const SourceFile&) = delete;
+        SourceFile& operator=(const SourceFile&) = delete;
+
+        const char* getData() const
+        {
+            return m_data;
+        }
+
+        std::size_t getSize() const
+        {
+            return m_size;
+        }
+
+        bool isMapped() const
+        {
+            return m_mapped;
+        }
+
+    protected:
+        const char* m_data;
+        std::size_t m_size;
+        bool m_mapped;
+
+        // Content of the file when it could not be mapped.
+        std::vector<char> m_buffer;
+};
+
+#endif // SOURCE_FILE_HPP_INCLUDED
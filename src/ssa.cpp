@@ -0,0 +1,862 @@
+#include "ssa.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "hashing.hpp"
+#include "optimizer.hpp"
+#include "tree_view.hpp"
+
+const Ssa::ValueId Ssa::noValue;
+const Symbol Ssa::noSymbol;
+const std::uint32_t Ssa::noStatement;
+
+namespace
+{
+    bool is_fold(Operator op)
+    {
+        return op >= Operator::OP_ADD && op <= Operator::OP_POW;
+    }
+
+    bool is_unary(Operator op)
+    {
+        return op >= Operator::OP_SIN && op <= Operator::OP_SQUARE;
+    }
+
+    // (assign name value) with a value assign takes.
+    template<typename Tree>
+    bool is_assignment(const Tree& tree, typename Tree::Handle statement)
+    {
+        if(tree.getType(statement) != NodeType::NT_EXPRESSION || tree.getOperator(statement) != Operator::OP_ASSIGN
+           || tree.getChildCount(statement) != 2 || tree.getType(tree.getChild(statement, 0)) != NodeType::NT_IDENTIFIER)
+            return false;
+
+        NodeType value = tree.getType(tree.getChild(statement, 1));
+        return value == NodeType::NT_CONST_VALUE || value == NodeType::NT_EXPRESSION;
+    }
+
+    // Constants, variables and pure built-ins only.
+    template<typename Tree>
+    bool is_pure_tree(const Tree& tree, typename Tree::Handle root, std::vector<typename Tree::Handle>& nodes)
+    {
+        nodes.assign(1, root);
+
+        while(!nodes.empty())
+        {
+            typename Tree::Handle node = nodes.back();
+            nodes.pop_back();
+
+            if(tree.getType(node) == NodeType::NT_EXPRESSION)
+            {
+                if(!Optimizer::isPure(tree.getOperator(node)))
+                    return false;
+
+                for(std::size_t i(0) ; i < tree.getChildCount(node) ; ++i)
+                    nodes.push_back(tree.getChild(node, i));
+            }
+            else if(tree.getType(node) != NodeType::NT_CONST_VALUE && tree.getType(node) != NodeType::NT_IDENTIFIER)
+                return false;
+        }
+
+        return true;
+    }
+
+    // The variables an opaque statement assigns, out of the bodies of its definitions.
+    template<typename Tree>
+    void find_assigned(const Tree& tree, typename Tree::Handle root, std::vector<typename Tree::Handle>& nodes, std::vector<Symbol>& assigned)
+    {
+        nodes.assign(1, root);
+
+        while(!nodes.empty())
+        {
+            typename Tree::Handle node = nodes.back();
+            nodes.pop_back();
+
+            if(tree.getType(node) != NodeType::NT_EXPRESSION || tree.getOperator(node) == Operator::OP_FUNCTION)
+                continue;
+
+            if(tree.getOperator(node) == Operator::OP_ASSIGN && tree.getChildCount(node) != 0
+               && tree.getType(tree.getChild(node, 0)) == NodeType::NT_IDENTIFIER)
+                assigned.push_back(tree.getSlot(tree.getChild(node, 0)));
+
+            for(std::size_t i(0) ; i < tree.getChildCount(node) ; ++i)
+                nodes.push_back(tree.getChild(node, i));
+        }
+    }
+
+    // Copy a statement kept as it is in the rebuilt flat AST.
+    NodeIndex copy_tree(const FlatAst& source, NodeIndex root, FlatAst& target)
+    {
+        // The expressions whose children are being copied, innermost last, and the copies of their children.
+        struct Copy
+        {
+            NodeIndex source;
+            std::uint32_t next;
+            std::size_t first;
+        };
+
+        std::vector<Copy> copies;
+        std::vector<NodeIndex> copied;
+
+        NodeIndex index = root;
+
+        for(;;)
+        {
+            if(source.getType(index) == NodeType::NT_EXPRESSION && source.getChildCount(index) != 0)
+                copies.push_back(Copy{index, 0, copied.size()});
+            else if(source.getType(index) == NodeType::NT_EXPRESSION)
+                copied.push_back(target.addExpression(source.getOperator(index), nullptr, 0));
+            else if(source.getType(index) == NodeType::NT_IDENTIFIER)
+                copied.push_back(target.addIdentifier(source.getSlot(index)));
+            else if(source.getType(index) == NodeType::NT_LOCAL)
+                copied.push_back(target.addLocal(source.getSlot(index)));
+            else if(source.getLiteral(index).type == ValueType::VT_NUMERIC)
+                copied.push_back(target.addNumeric(source.getLiteral(index).numeric));
+            else
+                copied.push_back(target.addConstant(source.getLiteral(index)));
+
+            while(!copies.empty() && copies.back().next == source.getChildCount(copies.back().source))
+            {
+                Copy complete = copies.back();
+                copies.pop_back();
+
+                NodeIndex expression = target.addExpression(source.getOperator(complete.source), copied.data() + complete.first, copied.size() - complete.first);
+
+                copied.resize(complete.first);
+                copied.push_back(expression);
+            }
+
+            if(copies.empty())
+                return copied.back();
+
+            Copy& parent = copies.back();
+            index = source.getChildren(parent.source)[parent.next++];
+        }
+    }
+}
+
+Ssa::Ssa(SymbolTable* symbols)
+    : m_symbols(symbols)
+    , m_nodes(4 * 1024)
+    , m_evaluations(0)
+    , m_saved(0)
+    , m_eliminated(0)
+    , m_propagated(false)
+{}
+
+Node* Ssa::optimize(Node* root)
+{
+    m_propagated = false;
+
+    if(root->getType() != NodeType::NT_EXPRESSION || root->getOperator() != Operator::OP_PROGRAM)
+        return root;
+
+    build(PointerTree(), root);
+    lower();
+
+    NodeList statements = root->getChildren();
+    std::vector<Node*> kept, operands;
+
+    for(const Lowered& statement : m_lowered)
+    {
+        if(statement.kind == StatementKind::SK_OPAQUE)
+            kept.push_back(statements[statement.source]);
+
+        if(statement.kind != StatementKind::SK_ASSIGN && statement.kind != StatementKind::SK_EVALUATE)
+            continue;
+
+        // Most statements read the same variables as they are written : their nodes are kept.
+        if(statement.source != noStatement && isUnchanged(statement, statements[statement.source]))
+        {
+            kept.push_back(statements[statement.source]);
+            continue;
+        }
+
+        // In reverse prefix order, the operands of an expression are on the stack once it is reached, the first on top.
+        for(std::uint32_t i(statement.count) ; i-- != 0 ; )
+        {
+            const Entry& entry = m_entries[statement.first + i];
+            const SsaValue& value = m_values[entry.value];
+            Node* node = nullptr;
+
+            if(entry.read != noSymbol)
+                node = m_nodes.create<Node>(entry.read);
+            else if(value.kind == ValueKind::VK_OPERATION)
+            {
+                Node** children = static_cast<Node**>(m_nodes.allocate(sizeof(Node*) * value.count, alignof(Node*)));
+
+                for(std::uint32_t j(0) ; j < value.count ; ++j)
+                {
+                    children[j] = operands.back();
+                    operands.pop_back();
+                }
+
+                node = m_nodes.create<Node>(value.op);
+                node->setChildren(value.count != 0 ? children : nullptr, value.count);
+            }
+            else
+            {
+                const Value& constant = m_constants[value.first];
+
+                if(constant.type == ValueType::VT_NUMERIC)
+                    node = m_nodes.create<Node>(constant.numeric);
+                else if(constant.type == ValueType::VT_STRING)
+                    node = m_nodes.create<Node>(m_nodes, constant.string->getData(), constant.string->getSize());
+                else
+                    node = m_nodes.create<Node>();
+            }
+
+            operands.push_back(node);
+        }
+
+        if(statement.kind == StatementKind::SK_ASSIGN)
+        {
+            Node** children = static_cast<Node**>(m_nodes.allocate(sizeof(Node*) * 2, alignof(Node*)));
+            children[0] = m_nodes.create<Node>(statement.variable);
+            children[1] = operands.back();
+
+            Node* assign = m_nodes.create<Node>(Operator::OP_ASSIGN);
+            assign->setChildren(children, 2);
+            kept.push_back(assign);
+        }
+        else
+            kept.push_back(operands.back());
+
+        operands.pop_back();
+    }
+
+    Node** children = static_cast<Node**>(m_nodes.allocate(sizeof(Node*) * (kept.size() + 1), alignof(Node*)));
+    std::copy(kept.begin(), kept.end(), children);
+    root->setChildren(kept.empty() ? nullptr : children, kept.size());
+
+    return root;
+}
+
+void Ssa::optimize(FlatAst& ast)
+{
+    NodeIndex root = ast.getRoot();
+    m_propagated = false;
+
+    if(ast.size() == 0 || ast.getType(root) != NodeType::NT_EXPRESSION || ast.getOperator(root) != Operator::OP_PROGRAM)
+        return;
+
+    build(FlatTree{ast}, root);
+    lower();
+
+    FlatAst lowered;
+    std::vector<NodeIndex> kept, operands;
+
+    for(const Lowered& statement : m_lowered)
+    {
+        if(statement.kind == StatementKind::SK_OPAQUE)
+            kept.push_back(copy_tree(ast, ast.getChildren(root)[statement.source], lowered));
+
+        if(statement.kind != StatementKind::SK_ASSIGN && statement.kind != StatementKind::SK_EVALUATE)
+            continue;
+
+        // Same as for a pointer tree : the operands come first, in reverse order.
+        for(std::uint32_t i(statement.count) ; i-- != 0 ; )
+        {
+            const Entry& entry = m_entries[statement.first + i];
+            const SsaValue& value = m_values[entry.value];
+            NodeIndex index = 0;
+
+            if(entry.read != noSymbol)
+                index = lowered.addIdentifier(entry.read);
+            else if(value.kind == ValueKind::VK_OPERATION)
+            {
+                std::reverse(operands.end() - value.count, operands.end());
+                index = lowered.addExpression(value.op, operands.data() + operands.size() - value.count, value.count);
+                operands.resize(operands.size() - value.count);
+            }
+            else if(m_constants[value.first].type == ValueType::VT_NUMERIC)
+                index = lowered.addNumeric(m_constants[value.first].numeric);
+            else
+                index = lowered.addConstant(m_constants[value.first]);
+
+            operands.push_back(index);
+        }
+
+        if(statement.kind == StatementKind::SK_ASSIGN)
+        {
+            NodeIndex children[] = {lowered.addIdentifier(statement.variable), operands.back()};
+            kept.push_back(lowered.addExpression(Operator::OP_ASSIGN, children, 2));
+        }
+        else
+            kept.push_back(operands.back());
+
+        operands.pop_back();
+    }
+
+    lowered.setRoot(lowered.addExpression(Operator::OP_PROGRAM, kept.data(), kept.size()));
+    ast = std::move(lowered);
+}
+
+void Ssa::clear()
+{
+    m_nodes.clear();
+}
+
+std::size_t Ssa::getSavedCount() const
+{
+    return m_saved;
+}
+
+std::size_t Ssa::getEliminatedCount() const
+{
+    return m_eliminated;
+}
+
+bool Ssa::hasPropagatedConstants() const
+{
+    return m_propagated;
+}
+
+template<typename Tree>
+void Ssa::build(const Tree& tree, typename Tree::Handle root)
+{
+    m_values.clear();
+    m_operands.clear();
+    m_constants.clear();
+    m_buckets.assign(1024, Bucket{0, 0});
+    m_statements.clear();
+    m_contents.clear();
+    m_evaluations = 0;
+
+    // The expressions whose operands are being numbered, innermost last, and the numbers of their operands.
+    struct Pending
+    {
+        typename Tree::Handle node;
+        std::size_t next;
+    };
+
+    std::vector<Pending> visits;
+    std::vector<ValueId> values;
+    std::vector<Symbol> assigned;
+    std::vector<typename Tree::Handle> nodes;
+
+    for(std::size_t i(0) ; i < tree.getChildCount(root) ; ++i)
+    {
+        typename Tree::Handle statement = tree.getChild(root, i);
+        typename Tree::Handle node = statement;
+        Symbol variable = noSymbol;
+
+        if(is_assignment(tree, statement))
+        {
+            variable = tree.getSlot(tree.getChild(statement, 0));
+            node = tree.getChild(statement, 1);
+        }
+
+        if(!is_pure_tree(tree, node, nodes))
+        {
+            m_statements.push_back(Statement{StatementKind::SK_OPAQUE, noSymbol, noValue, static_cast<std::uint32_t>(i)});
+
+            assigned.clear();
+            find_assigned(tree, statement, nodes, assigned);
+
+            for(Symbol symbol : assigned)
+            {
+                setContent(symbol, noValue);
+                read(symbol);
+            }
+
+            continue;
+        }
+
+        for(;;)
+        {
+            if(tree.getType(node) == NodeType::NT_CONST_VALUE)
+                values.push_back(constant(tree.getValue(node)));
+            else if(tree.getType(node) == NodeType::NT_IDENTIFIER)
+            {
+                values.push_back(read(tree.getSlot(node)));
+                m_propagated |= m_values[values.back()].kind == ValueKind::VK_CONSTANT;
+            }
+            else
+                visits.push_back(Pending{node, 0});
+
+            while(!visits.empty() && visits.back().next == tree.getChildCount(visits.back().node))
+            {
+                std::uint32_t count = static_cast<std::uint32_t>(tree.getChildCount(visits.back().node));
+                ValueId value = operation(tree.getOperator(visits.back().node), values.data() + values.size() - count, count);
+
+                values.resize(values.size() - count);
+                values.push_back(value);
+                visits.pop_back();
+
+                ++m_evaluations;
+            }
+
+            if(visits.empty())
+                break;
+
+            node = tree.getChild(visits.back().node, visits.back().next++);
+        }
+
+        if(variable != noSymbol)
+        {
+            m_statements.push_back(Statement{StatementKind::SK_ASSIGN, variable, values.back(), static_cast<std::uint32_t>(i)});
+            setContent(variable, values.back());
+        }
+        else
+            m_statements.push_back(Statement{StatementKind::SK_EVALUATE, noSymbol, values.back(), static_cast<std::uint32_t>(i)});
+
+        values.pop_back();
+    }
+}
+
+Ssa::ValueId Ssa::constant(const Value& value)
+{
+    std::uint32_t hash = hashing::mix(hashing::basis, static_cast<std::uint32_t>(value.type));
+
+    if(value.type == ValueType::VT_NUMERIC)
+    {
+        std::uint32_t bits(0);
+        std::memcpy(&bits, &value.numeric, sizeof(bits));
+        hash = hashing::mix(hash, bits);
+    }
+    else if(value.type == ValueType::VT_STRING)
+        hash = hashing::mix(hash, value.string->getData(), value.string->getSize());
+
+    return intern(SsaValue{ValueKind::VK_CONSTANT, Operator::OP_NONE, value.type, false, 0, 0, hash, noSymbol, 0}, nullptr, &value);
+}
+
+Ssa::ValueId Ssa::read(Symbol variable)
+{
+    ValueId value = getContent(variable);
+
+    if(value != noValue)
+        return value;
+
+    // The value held before the statement : it is unknown, and the variable may be unassigned.
+    value = static_cast<ValueId>(m_values.size());
+    m_values.push_back(SsaValue{ValueKind::VK_VARIABLE, Operator::OP_NONE, ValueType::VT_UNASSIGNED, true, variable, 0, 0, noSymbol, 0});
+
+    m_statements.push_back(Statement{StatementKind::SK_DEFINE, variable, value, 0});
+    setContent(variable, value);
+
+    return value;
+}
+
+Ssa::ValueId Ssa::operation(Operator op, const ValueId* operands, std::uint32_t count)
+{
+    std::uint32_t hash = hashing::mix(hashing::mix(hashing::basis, static_cast<std::uint32_t>(op)), count);
+    bool mayFail(false);
+
+    for(std::uint32_t i(0) ; i < count ; ++i)
+    {
+        hash = hashing::mix(hash, operands[i]);
+        mayFail |= m_values[operands[i]].mayFail;
+    }
+
+    // Only the operands of known types are sure to be taken, as the runtime checks them.
+    ValueType type = ValueType::VT_UNASSIGNED;
+    ValueType first = count != 0 ? m_values[operands[0]].type : ValueType::VT_UNASSIGNED;
+
+    if(op == Operator::OP_TO_NUMERIC && count == 1)
+        type = ValueType::VT_NUMERIC;
+    else if(op == Operator::OP_TO_STRING && count == 1)
+        type = ValueType::VT_STRING;
+    else if(is_unary(op) && count == 1 && first == ValueType::VT_NUMERIC)
+        type = ValueType::VT_NUMERIC;
+    else if(is_fold(op) && count != 0 && (first == ValueType::VT_NUMERIC || (first == ValueType::VT_STRING && op == Operator::OP_ADD)))
+    {
+        type = first;
+
+        for(std::uint32_t i(1) ; i < count ; ++i)
+        {
+            if(m_values[operands[i]].type != first)
+                type = ValueType::VT_UNASSIGNED;
+        }
+    }
+
+    mayFail |= type == ValueType::VT_UNASSIGNED;
+
+    return intern(SsaValue{ValueKind::VK_OPERATION, op, type, mayFail, 0, count, hash, noSymbol, 0}, operands, nullptr);
+}
+
+Ssa::ValueId Ssa::intern(SsaValue value, const ValueId* operands, const Value* constant)
+{
+    std::size_t mask = m_buckets.size() - 1;
+    std::size_t bucket = hashing::finalize(value.hash) & mask;
+
+    for( ; m_buckets[bucket].value != 0 ; bucket = (bucket + 1) & mask)
+    {
+        if(m_buckets[bucket].hash == value.hash && equals(m_values[m_buckets[bucket].value - 1], value, operands, constant))
+            return m_buckets[bucket].value - 1;
+    }
+
+    if(constant)
+    {
+        value.first = static_cast<std::uint32_t>(m_constants.size());
+        m_constants.push_back(*constant);
+    }
+    else
+    {
+        value.first = static_cast<std::uint32_t>(m_operands.size());
+        m_operands.insert(m_operands.end(), operands, operands + value.count);
+    }
+
+    ValueId id = static_cast<ValueId>(m_values.size());
+    m_values.push_back(value);
+    m_buckets[bucket] = Bucket{id + 1, value.hash};
+
+    // Half full at most.
+    if(m_values.size() * 2 > m_buckets.size())
+        grow();
+
+    return id;
+}
+
+bool Ssa::equals(const SsaValue& value, const SsaValue& other, const ValueId* operands, const Value* constant) const
+{
+    if(value.kind != other.kind || value.op != other.op || value.type != other.type || value.count != other.count)
+        return false;
+
+    if(value.kind == ValueKind::VK_OPERATION)
+        return value.count == 0 || std::memcmp(m_operands.data() + value.first, operands, sizeof(ValueId) * value.count) == 0;
+
+    const Value& known = m_constants[value.first];
+
+    // The numbers are the same to the bit : 0 and -0 are two constants.
+    if(known.type == ValueType::VT_NUMERIC)
+        return std::memcmp(&known.numeric, &constant->numeric, sizeof(float)) == 0;
+
+    if(known.type == ValueType::VT_STRING)
+        return known.string->getSize() == constant->string->getSize()
+            && std::memcmp(known.string->getData(), constant->string->getData(), known.string->getSize()) == 0;
+
+    return true;
+}
+
+void Ssa::grow()
+{
+    std::vector<Bucket> buckets(m_buckets.size() * 2, Bucket{0, 0});
+    std::size_t mask = buckets.size() - 1;
+
+    for(const Bucket& old : m_buckets)
+    {
+        if(old.value == 0)
+            continue;
+
+        std::size_t bucket = hashing::finalize(old.hash) & mask;
+
+        while(buckets[bucket].value != 0)
+            bucket = (bucket + 1) & mask;
+
+        buckets[bucket] = old;
+    }
+
+    m_buckets.swap(buckets);
+}
+
+void Ssa::setContent(Symbol variable, ValueId value)
+{
+    if(variable >= m_contents.size())
+        m_contents.resize(variable + 1, noValue);
+
+    m_contents[variable] = value;
+}
+
+Ssa::ValueId Ssa::getContent(Symbol variable) const
+{
+    return variable < m_contents.size() ? m_contents[variable] : noValue;
+}
+
+void Ssa::lower()
+{
+    m_lowered.clear();
+    m_entries.clear();
+    m_temporaries.clear();
+
+    // Twice through the statements : the evaluations are counted first, then the statements are planned the same way.
+    for(int pass(0) ; pass < 2 ; ++pass)
+    {
+        std::fill(m_contents.begin(), m_contents.end(), noValue);
+
+        for(SsaValue& value : m_values)
+            value.holder = noSymbol;
+
+        for(const Statement& statement : m_statements)
+        {
+            if(statement.kind == StatementKind::SK_DEFINE)
+                store(statement.variable, statement.value);
+            else if(statement.kind == StatementKind::SK_OPAQUE && pass == 1)
+                m_lowered.push_back(Lowered{StatementKind::SK_OPAQUE, noSymbol, statement.source, 0, 0, true});
+
+            if(statement.kind != StatementKind::SK_ASSIGN && statement.kind != StatementKind::SK_EVALUATE)
+                continue;
+
+            // The variable holds the value already.
+            if(statement.kind == StatementKind::SK_ASSIGN && getContent(statement.variable) == statement.value)
+            {
+                m_eliminated += pass;
+                continue;
+            }
+
+            if(pass == 0)
+                count(statement.value);
+            else
+            {
+                temporaries(statement.value);
+
+                Lowered lowered{statement.kind, statement.variable, statement.source, 0, 0, false};
+                plan(lowered, statement.value);
+                m_lowered.push_back(lowered);
+            }
+
+            if(statement.kind == StatementKind::SK_ASSIGN)
+                store(statement.variable, statement.value);
+        }
+    }
+
+    eliminate();
+}
+
+void Ssa::count(ValueId root)
+{
+    if(m_values[root].kind != ValueKind::VK_OPERATION)
+        return;
+
+    m_pending.assign(m_operands.begin() + m_values[root].first, m_operands.begin() + m_values[root].first + m_values[root].count);
+
+    while(!m_pending.empty())
+    {
+        SsaValue& value = m_values[m_pending.back()];
+        bool evaluated = value.kind == ValueKind::VK_OPERATION && !isHeld(m_pending.back());
+
+        // Once a value has its temporary, its operands are not evaluated anymore.
+        if(evaluated && needsTemporary(m_pending.back()))
+            evaluated = value.evaluations++ == 0;
+
+        m_pending.pop_back();
+
+        if(evaluated)
+            m_pending.insert(m_pending.end(), m_operands.begin() + value.first, m_operands.begin() + value.first + value.count);
+    }
+}
+
+void Ssa::temporaries(ValueId root)
+{
+    // The operands first : the temporaries of a value read those of its operands.
+    std::vector<Visit>& visits = m_visits;
+    visits.assign(1, Visit{root, 0});
+
+    while(!visits.empty())
+    {
+        Visit& visit = visits.back();
+        const SsaValue& value = m_values[visit.value];
+
+        if(value.kind != ValueKind::VK_OPERATION || visit.next == value.count)
+        {
+            ValueId complete = visit.value;
+            visits.pop_back();
+
+            if(visits.empty() || value.kind != ValueKind::VK_OPERATION || isHeld(complete)
+               || !needsTemporary(complete) || value.evaluations < 2)
+                continue;
+
+            std::string name = "#" + std::to_string(m_temporaries.size());
+            Symbol temporary = m_symbols->intern(name.data(), name.size());
+            m_temporaries.push_back(temporary);
+
+            Lowered lowered{StatementKind::SK_ASSIGN, temporary, noStatement, 0, 0, false};
+            plan(lowered, complete);
+            m_lowered.push_back(lowered);
+
+            store(temporary, complete);
+            continue;
+        }
+
+        ValueId operand = m_operands[value.first + visit.next++];
+
+        if(m_values[operand].kind == ValueKind::VK_OPERATION && !isHeld(operand))
+            visits.push_back(Visit{operand, 0});
+    }
+}
+
+void Ssa::plan(Lowered& statement, ValueId root)
+{
+    statement.first = static_cast<std::uint32_t>(m_entries.size());
+    statement.mayFail = m_values[root].mayFail;
+
+    m_pending.assign(1, root);
+
+    while(!m_pending.empty())
+    {
+        ValueId id = m_pending.back();
+        const SsaValue& value = m_values[id];
+        m_pending.pop_back();
+
+        // The value of an assignment is evaluated, assign does not take a variable.
+        if(value.kind == ValueKind::VK_CONSTANT || (value.kind == ValueKind::VK_OPERATION && (id == root || !isHeld(id))))
+        {
+            m_entries.push_back(Entry{id, noSymbol});
+
+            for(std::uint32_t i(value.count) ; value.kind == ValueKind::VK_OPERATION && i-- != 0 ; )
+                m_pending.push_back(m_operands[value.first + i]);
+        }
+        else
+            m_entries.push_back(Entry{id, isHeld(id) ? value.holder : value.first});
+    }
+
+    statement.count = static_cast<std::uint32_t>(m_entries.size()) - statement.first;
+}
+
+void Ssa::eliminate()
+{
+    // Backward : a variable is overwritten after the statement when it is assigned before it is read. The
+    // opaque statements read all the variables, and the program reads them at the end, but the temporaries.
+    m_overwritten.assign(m_contents.size(), false);
+    m_temporary.assign(m_contents.size(), false);
+
+    for(Symbol temporary : m_temporaries)
+    {
+        m_overwritten[temporary] = true;
+        m_temporary[temporary] = true;
+    }
+
+    std::vector<Symbol> overwritten;
+    std::size_t evaluations(0);
+
+    for(std::size_t i(m_lowered.size()) ; i-- != 0 ; )
+    {
+        Lowered& statement = m_lowered[i];
+
+        if(statement.kind == StatementKind::SK_OPAQUE)
+        {
+            for(Symbol variable : overwritten)
+                m_overwritten[variable] = false;
+
+            overwritten.clear();
+            continue;
+        }
+
+        if(!statement.mayFail && (statement.kind == StatementKind::SK_EVALUATE || m_overwritten[statement.variable]))
+        {
+            if(statement.kind == StatementKind::SK_EVALUATE || !m_temporary[statement.variable])
+                ++m_eliminated;
+
+            // Nothing is lowered for it.
+            statement.kind = StatementKind::SK_DEFINE;
+            continue;
+        }
+
+        if(statement.kind == StatementKind::SK_ASSIGN)
+        {
+            m_overwritten[statement.variable] = true;
+
+            if(!m_temporary[statement.variable])
+                overwritten.push_back(statement.variable);
+        }
+
+        for(std::uint32_t j(statement.first) ; j < statement.first + statement.count ; ++j)
+        {
+            if(m_entries[j].read != noSymbol)
+                m_overwritten[m_entries[j].read] = false;
+            else
+                evaluations += m_values[m_entries[j].value].kind == ValueKind::VK_OPERATION;
+        }
+    }
+
+    m_saved += m_evaluations - evaluations;
+}
+
+bool Ssa::isUnchanged(const Lowered& statement, const Node* source)
+{
+    m_compared.assign(1, statement.kind == StatementKind::SK_ASSIGN ? source->getChildren()[1] : source);
+
+    for(std::uint32_t i(statement.first) ; i < statement.first + statement.count ; ++i)
+    {
+        if(m_compared.empty())
+            return false;
+
+        const Node* node = m_compared.back();
+        const Entry& entry = m_entries[i];
+        const SsaValue& value = m_values[entry.value];
+        m_compared.pop_back();
+
+        if(entry.read != noSymbol)
+        {
+            if(node->getType() != NodeType::NT_IDENTIFIER || node->getSlot() != entry.read)
+                return false;
+        }
+        else if(value.kind == ValueKind::VK_OPERATION)
+        {
+            NodeList children = node->getChildren();
+
+            if(node->getType() != NodeType::NT_EXPRESSION || node->getOperator() != value.op || children.size() != value.count)
+                return false;
+
+            for(std::size_t j(children.size()) ; j-- != 0 ; )
+                m_compared.push_back(children[j]);
+        }
+        else
+        {
+            const Value& constant = m_constants[value.first];
+
+            // The escaped strings are decoded in the plan.
+            if(node->getType() != NodeType::NT_CONST_VALUE || node->getValueType() != constant.type || node->hasEscapes())
+                return false;
+
+            float numeric = node->getValue().numeric;
+
+            if(constant.type == ValueType::VT_NUMERIC && std::memcmp(&constant.numeric, &numeric, sizeof(float)) != 0)
+                return false;
+
+            if(constant.type == ValueType::VT_STRING && (constant.string->getSize() != node->getTextLength()
+               || std::memcmp(constant.string->getData(), node->getText(), node->getTextLength()) != 0))
+                return false;
+        }
+    }
+
+    return m_compared.empty();
+}
+
+bool Ssa::isHeld(ValueId value) const
+{
+    return m_values[value].holder != noSymbol;
+}
+
+bool Ssa::needsTemporary(ValueId value) const
+{
+    return m_symbols && m_values[value].kind == ValueKind::VK_OPERATION && !m_values[value].mayFail;
+}
+
+void Ssa::store(Symbol variable, ValueId value)
+{
+    ValueId previous = getContent(variable);
+
+    if(previous == value)
+        return;
+
+    setContent(variable, value);
+
+    if(m_nextHolder.size() < m_contents.size())
+    {
+        m_nextHolder.resize(m_contents.size(), noSymbol);
+        m_previousHolder.resize(m_contents.size(), noSymbol);
+    }
+
+    // Out of the holders of its previous value, ahead of those of the new one.
+    if(previous != noValue)
+    {
+        Symbol next = m_nextHolder[variable];
+        Symbol before = m_previousHolder[variable];
+
+        (before != noSymbol ? m_nextHolder[before] : m_values[previous].holder) = next;
+
+        if(next != noSymbol)
+            m_previousHolder[next] = before;
+    }
+
+    Symbol first = m_values[value].holder;
+
+    if(first != noSymbol)
+        m_previousHolder[first] = variable;
+
+    m_nextHolder[variable] = first;
+    m_previousHolder[variable] = noSymbol;
+    m_values[value].holder = variable;
+}
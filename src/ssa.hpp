@@ -0,0 +1,230 @@
+/*
+	ssa.hpp
+
+	The MIT License (MIT)
+
+	Copyright (c) 2014 Maxime Alvarez
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+	Defines the static single assignment form of the statements of a program, and the passes on it.
+*/
+
+#ifndef SSA_HPP_INCLUDED
+#define SSA_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "arena.hpp"
+#include "datatypes.hpp"
+#include "flat_ast.hpp"
+#include "symbol_table.hpp"
+
+/// The statements of a (program ...) run in sequence : each (assign name value) of a pure value (constants,
+/// variables and the pure built-ins) defines a new version of the variable, numbered by its value.
+/// The values are numbered globally : two expressions of the same operator on the same values are one value,
+/// however far apart and through whatever variables they are written. The other statements are opaque :
+/// they keep their place and order, read all the variables (a call reads the globals) and give a new
+/// unknown value to those they assign.
+///
+/// The statements are then lowered back :
+///  - a constant is written in place of the variable holding it, a value already held by a variable is read from it instead of being evaluated again (common subexpressions
+///    and copies), a value evaluated more than once otherwise is assigned to a temporary #n the first time,
+///  - an assignment of the value the variable holds already is removed, and so is any assignment overwritten
+///    before it is read, but those whose value may fail : a type error or an unassigned variable still happens.
+/// Only the values which cannot fail, on operands of known types, move to a temporary or are removed : the
+/// statements which may fail are all evaluated in their order, the errors and the outputs are the same.
+/// The variables hold their last value at the end of the program, the next ones may read them.
+class Ssa
+{
+    public:
+        // The temporaries are interned in the symbols, none is introduced without them.
+        explicit Ssa(SymbolTable* symbols = nullptr);
+
+        // Rewrite the statements of a program, any other root is left as it is. The new nodes of a pointer tree
+        // live in the pass, which has to outlive them. The flat AST is rebuilt with its statements lowered.
+        Node* optimize(Node* root);
+        void optimize(FlatAst& ast);
+
+        // Release the new nodes, the trees rewritten so far must not be used anymore.
+        void clear();
+
+        // The number of evaluations of the pure built-ins saved, and of statements removed.
+        std::size_t getSavedCount() const;
+        std::size_t getEliminatedCount() const;
+
+        // True if the last program read a variable of constant value : its constant may fold with others.
+        bool hasPropagatedConstants() const;
+
+    protected:
+        typedef std::uint32_t ValueId;
+
+        static const ValueId noValue = 0xFFFFFFFF;
+        static const Symbol noSymbol = 0xFFFFFFFF;
+        static const std::uint32_t noStatement = 0xFFFFFFFF;
+
+        enum class ValueKind : std::uint8_t
+        {
+            VK_CONSTANT,
+            // The unknown value of a variable before the program, or after an opaque statement assigned it.
+            VK_VARIABLE,
+            VK_OPERATION
+        };
+
+        struct SsaValue
+        {
+            ValueKind kind;
+            Operator op;
+            // VT_UNASSIGNED when the type is not known.
+            ValueType type;
+            // The value or one of its operands may fail to evaluate.
+            bool mayFail;
+
+            // The operands of an operation, the constant, or the symbol of a variable.
+            std::uint32_t first;
+            std::uint32_t count;
+            std::uint32_t hash;
+
+            /** Lowering. */
+            // The first of the variables and temporaries holding the value, noSymbol if none does.
+            Symbol holder;
+            // The number of its evaluations as an operand, when no variable holds it.
+            std::uint32_t evaluations;
+        };
+
+        enum class StatementKind : std::uint8_t
+        {
+            SK_ASSIGN,
+            // A pure expression whose value is discarded.
+            SK_EVALUATE,
+            // Kept as it is.
+            SK_OPAQUE,
+            // The variable holds a new value of kind VK_VARIABLE, nothing is lowered.
+            SK_DEFINE
+        };
+
+        struct Statement
+        {
+            StatementKind kind;
+            Symbol variable;
+            ValueId value;
+            // The index of an opaque statement in the program.
+            std::uint32_t source;
+        };
+
+        // A lowered statement evaluates its plan : the values in prefix order, each of them read from its
+        // variable or evaluated from the entries of its operands which follow.
+        struct Entry
+        {
+            ValueId value;
+            Symbol read;
+        };
+
+        struct Visit
+        {
+            ValueId value;
+            std::uint32_t next;
+        };
+
+        struct Lowered
+        {
+            StatementKind kind;
+            Symbol variable;
+            // The index of the statement in the program, noStatement for a temporary.
+            std::uint32_t source;
+            std::uint32_t first;
+            std::uint32_t count;
+            bool mayFail;
+        };
+
+        /** Construction. */
+        template<typename Tree>
+        void build(const Tree& tree, typename Tree::Handle root);
+
+        ValueId constant(const Value& value);
+        ValueId read(Symbol variable);
+        ValueId operation(Operator op, const ValueId* operands, std::uint32_t count);
+        // The number of the value, a new one if no value is the same.
+        ValueId intern(SsaValue value, const ValueId* operands, const Value* constant);
+        bool equals(const SsaValue& value, const SsaValue& other, const ValueId* operands, const Value* constant) const;
+        void grow();
+
+        void setContent(Symbol variable, ValueId value);
+        ValueId getContent(Symbol variable) const;
+
+        /** Lowering. */
+        void lower();
+        // The evaluations of the operands of the value, as if the statements were lowered.
+        void count(ValueId root);
+        // Assign the operands evaluated more than once to temporaries, before the statement.
+        void temporaries(ValueId root);
+        void plan(Lowered& statement, ValueId root);
+        void eliminate();
+        // True if the plan evaluates the statement as it is written.
+        bool isUnchanged(const Lowered& statement, const Node* source);
+
+        bool isHeld(ValueId value) const;
+        // A temporary for the values which cannot fail, evaluated more than once.
+        bool needsTemporary(ValueId value) const;
+        void store(Symbol variable, ValueId value);
+
+        SymbolTable* m_symbols;
+        Arena m_nodes;
+
+        std::vector<SsaValue> m_values;
+        std::vector<ValueId> m_operands;
+        std::vector<Value> m_constants;
+        // Open addressing on a power of two buckets : value + 1, 0 for an empty bucket, and the hash of the value
+        // for the probes not to read the others.
+        struct Bucket
+        {
+            ValueId value;
+            std::uint32_t hash;
+        };
+
+        std::vector<Bucket> m_buckets;
+
+        std::vector<Statement> m_statements;
+        // The value held by each variable, noValue if it is not known.
+        std::vector<ValueId> m_contents;
+        // The variables holding the same value are linked, from the holder of the value.
+        std::vector<Symbol> m_nextHolder;
+        std::vector<Symbol> m_previousHolder;
+
+        std::vector<Lowered> m_lowered;
+        std::vector<Entry> m_entries;
+        std::vector<Symbol> m_temporaries;
+        // The variables and temporaries overwritten after a statement before being read, see eliminate().
+        std::vector<bool> m_overwritten;
+        std::vector<bool> m_temporary;
+        // The values to count or plan, and the values whose operands are visited for temporaries.
+        std::vector<ValueId> m_pending;
+        std::vector<Visit> m_visits;
+        // The nodes of a statement to compare with its plan.
+        std::vector<const Node*> m_compared;
+
+        // The evaluations of the pure statements, as written.
+        std::size_t m_evaluations;
+        std::size_t m_saved;
+        std::size_t m_eliminated;
+        bool m_propagated;
+};
+
+#endif // SSA_HPP_INCLUDED
@@ -29,6 +29,12 @@
 #define STRING_UTILS_HPP
 
 #include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <locale>
 #include <sstream>
@@ -67,6 +73,156 @@ class string_utils
 			return stream.str();
 		}
 
+        // Parse a decimal number the way std::stringstream does : leading whitespaces, sign, digits,
+        // fraction and exponent. Stop at the first other character, return 0 if there is no number.
+        static float parseFloat(const char* begin, const char* end)
+        {
+            const char* cursor = begin;
+
+            while(cursor != end && std::isspace(static_cast<unsigned char>(*cursor)))
+                ++cursor;
+
+            const char* start = cursor;
+            bool negative(false);
+
+            if(cursor != end && (*cursor == '+' || *cursor == '-'))
+                negative = (*cursor++ == '-');
+
+            // Up to 19 significant digits fit in the mantissa, the value is mantissa * 10^exponent.
+            std::uint64_t mantissa(0);
+            int digits(0), exponent(0);
+            bool found(false), exact(true);
+
+            for( ; cursor != end && *cursor >= '0' && *cursor <= '9' ; ++cursor, found = true)
+            {
+                if(digits < 19)
+                {
+                    mantissa = mantissa * 10 + static_cast<std::uint64_t>(*cursor - '0');
+                    digits += (mantissa != 0);
+                }
+                else
+                {
+                    exact = exact && *cursor == '0';
+                    ++exponent;
+                }
+            }
+
+            if(cursor != end && *cursor == '.')
+            {
+                for(++cursor ; cursor != end && *cursor >= '0' && *cursor <= '9' ; ++cursor, found = true)
+                {
+                    if(digits < 19)
+                    {
+                        mantissa = mantissa * 10 + static_cast<std::uint64_t>(*cursor - '0');
+                        digits += (mantissa != 0);
+                        --exponent;
+                    }
+                    else
+                        exact = exact && *cursor == '0';
+                }
+            }
+
+            if(!found)
+                return 0.f;
+
+            // The exponent is only taken with at least one digit.
+            if(cursor != end && (*cursor == 'e' || *cursor == 'E'))
+            {
+                const char* exponentCursor = cursor + 1;
+                bool negativeExponent(false);
+
+                if(exponentCursor != end && (*exponentCursor == '+' || *exponentCursor == '-'))
+                    negativeExponent = (*exponentCursor++ == '-');
+
+                if(exponentCursor != end && *exponentCursor >= '0' && *exponentCursor <= '9')
+                {
+                    int value(0);
+
+                    for( ; exponentCursor != end && *exponentCursor >= '0' && *exponentCursor <= '9' ; ++exponentCursor)
+                        value = std::min(value * 10 + (*exponentCursor - '0'), 100000);
+
+                    exponent += negativeExponent ? -value : value;
+                    cursor = exponentCursor;
+                }
+            }
+
+            // Both operands are exact floats : a single rounding, the correct one.
+            static const float powers[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+            if(exact && mantissa <= (1u << 24) && exponent >= -10 && exponent <= 10)
+            {
+                float value = static_cast<float>(mantissa);
+                value = exponent < 0 ? value / powers[-exponent] : value * powers[exponent];
+
+                return negative ? -value : value;
+            }
+
+            // Rare long or huge numbers.
+            return std::strtof(std::string(start, cursor).c_str(), nullptr);
+        }
+
+        // Write the shortest digits reading back as the same float, in the %g style of std::ostream : its
+        // precision of 6, raised to the number of digits when more are needed, tells the fixed notation from
+        // the scientific one, 100 and 1234567 but 1e+06 and 1.474579e+07. Return its length, the buffer must
+        // hold maxFloatLength characters.
+        static const std::size_t maxFloatLength = 32;
+
+        static std::size_t formatFloat(float value, char* buffer)
+        {
+            if(!std::isfinite(value))
+                return static_cast<std::size_t>(std::snprintf(buffer, maxFloatLength, "%g", static_cast<double>(value)));
+
+            std::size_t length(0);
+
+            if(std::signbit(value))
+                buffer[length++] = '-';
+
+            // Integers, most of the numbers of the scripts. Past 6 digits, a trailing zero makes the digits
+            // fewer than the exponent : those are written in the scientific notation.
+            if(std::fabs(value) < 16777216.f && sameBits(value, std::trunc(value)))
+            {
+                std::uint32_t integer = static_cast<std::uint32_t>(std::fabs(value));
+
+                if(integer < 1000000u || integer % 10 != 0)
+                    return length + writeDigits(integer, countDigits(integer), buffer + length);
+            }
+
+            // The float is exact in a double, as are the powers of ten up to 10^22 : the n digits of the
+            // value are the rounding of value * 10^(n - 1 - exponent), with a single rounding error.
+            double magnitude = std::fabs(static_cast<double>(value));
+            int exponent = static_cast<int>(std::floor(std::log10(magnitude)));
+
+            if(magnitude >= static_cast<double>(FLT_MIN) && exponent >= -12 && exponent <= 12)
+            {
+                // log10 may be one off around the powers of ten.
+                std::uint64_t mantissa = static_cast<std::uint64_t>(std::llrint(scale(magnitude, 8 - exponent)));
+
+                if(mantissa >= 1000000000u)
+                    ++exponent;
+                else if(mantissa < 100000000u)
+                    --exponent;
+
+                for(int digits(1) ; digits <= 9 ; ++digits)
+                {
+                    mantissa = static_cast<std::uint64_t>(std::llrint(scale(magnitude, digits - 1 - exponent)));
+
+                    if(readsBackAs(mantissa, exponent - digits + 1, std::fabs(value)))
+                        return length + writeScientific(mantissa, digits, exponent, buffer + length);
+                }
+            }
+
+            // Tiny or huge numbers : let the C library do the rounding.
+            for(int precision(1) ; precision < 9 ; ++precision)
+            {
+                int written = std::snprintf(buffer, maxFloatLength, "%.*g", precision, static_cast<double>(value));
+
+                if(sameBits(std::strtof(buffer, nullptr), value))
+                    return static_cast<std::size_t>(written);
+            }
+
+            return static_cast<std::size_t>(std::snprintf(buffer, maxFloatLength, "%.9g", static_cast<double>(value)));
+        }
+
         // Convert a std::string to lowercase.
         static std::string lowercase(std::string data)
         {
@@ -80,6 +236,143 @@ class string_utils
             std::transform(data.begin(), data.end(), data.begin(), ::toupper);
             return data;
         }
+
+    protected:
+        static bool sameBits(float lhs, float rhs)
+        {
+            return std::memcmp(&lhs, &rhs, sizeof(float)) == 0;
+        }
+
+        // value * 10^power, correctly rounded for |power| <= 22.
+        static double scale(double value, int power)
+        {
+            static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+            return power < 0 ? value / powers[-power] : value * powers[power];
+        }
+
+        // Whether mantissa * 10^power reads back as the given float. The double is correctly rounded,
+        // its rounding to float too unless it was rounded onto the middle of two floats : refuse those.
+        static bool readsBackAs(std::uint64_t mantissa, int power, float value)
+        {
+            double decimal = scale(static_cast<double>(mantissa), power);
+
+            std::uint64_t bits(0);
+            std::memcpy(&bits, &decimal, sizeof(bits));
+
+            const std::uint64_t halfway = std::uint64_t(1) << 28;
+
+            if((bits & ((halfway << 1) - 1)) == halfway)
+            {
+                double m = static_cast<double>(mantissa);
+                double error = power < 0 ? std::fma(decimal, scale(1., -power), -m) : std::fma(m, scale(1., power), -decimal);
+
+                if(std::fpclassify(error) != FP_ZERO)
+                    return false;
+            }
+
+            return sameBits(static_cast<float>(decimal), value);
+        }
+
+        static std::size_t countDigits(std::uint64_t integer)
+        {
+            std::size_t count(1);
+
+            while(integer >= 10)
+            {
+                integer /= 10;
+                ++count;
+            }
+
+            return count;
+        }
+
+        static std::size_t writeDigits(std::uint64_t integer, std::size_t count, char* buffer)
+        {
+            for(std::size_t i(count) ; i != 0 ; --i)
+            {
+                buffer[i - 1] = static_cast<char>('0' + integer % 10);
+                integer /= 10;
+            }
+
+            buffer[count] = '\0';
+            return count;
+        }
+
+        // Write the digits of mantissa, the first one being of weight 10^exponent, like %.<digits>g does.
+        static std::size_t writeScientific(std::uint64_t mantissa, int digits, int exponent, char* buffer)
+        {
+            // A rounding up to the next power of ten, 9.99 -> 10.
+            if(countDigits(mantissa) > static_cast<std::size_t>(digits))
+            {
+                mantissa /= 10;
+                ++exponent;
+            }
+
+            // %g drops the trailing zeros.
+            std::size_t count = static_cast<std::size_t>(digits);
+
+            while(count > 1 && mantissa % 10 == 0)
+            {
+                mantissa /= 10;
+                --count;
+            }
+
+            char text[16];
+            writeDigits(mantissa, count, text);
+
+            std::size_t length(0);
+
+            if(exponent >= -4 && exponent < std::max(digits, 6))
+            {
+                if(exponent < 0)
+                {
+                    buffer[length++] = '0';
+                    buffer[length++] = '.';
+
+                    for(int i(-1) ; i > exponent ; --i)
+                        buffer[length++] = '0';
+
+                    std::memcpy(buffer + length, text, count);
+                    length += count;
+                }
+                else
+                {
+                    std::size_t integral = static_cast<std::size_t>(exponent) + 1;
+
+                    for(std::size_t i(0) ; i < integral ; ++i)
+                        buffer[length++] = i < count ? text[i] : '0';
+
+                    if(count > integral)
+                    {
+                        buffer[length++] = '.';
+                        std::memcpy(buffer + length, text + integral, count - integral);
+                        length += count - integral;
+                    }
+                }
+            }
+            else
+            {
+                buffer[length++] = text[0];
+
+                if(count > 1)
+                {
+                    buffer[length++] = '.';
+                    std::memcpy(buffer + length, text + 1, count - 1);
+                    length += count - 1;
+                }
+
+                buffer[length++] = 'e';
+                buffer[length++] = exponent < 0 ? '-' : '+';
+
+                std::uint64_t power = static_cast<std::uint64_t>(std::abs(exponent));
+                length += writeDigits(power, std::max<std::size_t>(2, countDigits(power)), buffer + length);
+            }
+
+            buffer[length] = '\0';
+            return length;
+        }
 };
 
 #endif // STRING_UTILS_HPP
@@ -0,0 +1,67 @@
+#include "symbol_table.hpp"
+
+#include <cstring>
+
+#include "hashing.hpp"
+
+namespace
+{
+    // FNV-1a, identifiers are short.
+    std::uint32_t hash(const char* name, std::size_t length)
+    {
+        return hashing::mix(hashing::basis, name, length);
+    }
+}
+
+SymbolTable::SymbolTable()
+    : m_buckets(64, 0)
+{}
+
+Symbol SymbolTable::intern(const char* name, std::size_t length)
+{
+    std::uint32_t nameHash = hash(name, length);
+    std::size_t mask = m_buckets.size() - 1;
+
+    for(std::size_t bucket(nameHash & mask) ; ; bucket = (bucket + 1) & mask)
+    {
+        Symbol entry = m_buckets[bucket];
+
+        if(entry == 0)
+        {
+            Symbol symbol = static_cast<Symbol>(m_names.size());
+
+            m_names.push_back(std::string(name, name + length));
+            m_hashes.push_back(nameHash);
+            m_buckets[bucket] = symbol + 1;
+
+            // Keep the buckets at most half full.
+            if(m_names.size() * 2 > m_buckets.size())
+                grow();
+
+            return symbol;
+        }
+
+        const std::string& other = m_names[entry - 1];
+
+        if(m_hashes[entry - 1] == nameHash && other.size() == length && std::memcmp(other.data(), name, length) == 0)
+            return entry - 1;
+    }
+}
+
+void SymbolTable::grow()
+{
+    std::vector<Symbol> buckets(m_buckets.size() * 2, 0);
+    std::size_t mask = buckets.size() - 1;
+
+    for(Symbol symbol(0) ; symbol < m_names.size() ; ++symbol)
+    {
+        std::size_t bucket(m_hashes[symbol] & mask);
+
+        while(buckets[bucket] != 0)
+            bucket = (bucket + 1) & mask;
+
+        buckets[bucket] = symbol + 1;
+    }
+
+    m_buckets.swap(buckets);
+}
@@ -0,0 +1,68 @@
+/*
+	symbol_table.hpp
+
+	The MIT License (MIT)
+
+	Copyright (c) 2014 Maxime Alvarez
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+	Defines the table interning the identifiers.
+*/
+
+#ifndef SYMBOL_TABLE_HPP_INCLUDED
+#define SYMBOL_TABLE_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "datatypes.hpp"
+
+/// Each distinct identifier is stored once and numbered from 0 in order of appearance.
+/// The runtime keeps the value of the symbol n in its variable slot n.
+class SymbolTable
+{
+    public:
+        SymbolTable();
+
+        // Return the symbol of the name, a new one if it was never seen.
+        Symbol intern(const char* name, std::size_t length);
+
+        const std::string& getName(Symbol symbol) const
+        {
+            return m_names[symbol];
+        }
+
+        std::size_t size() const
+        {
+            return m_names.size();
+        }
+
+    protected:
+        void grow();
+
+        std::vector<std::string> m_names;
+        std::vector<std::uint32_t> m_hashes;
+
+        // Open addressing on a power of two buckets : symbol + 1, 0 for an empty bucket.
+        std::vector<Symbol> m_buckets;
+};
+
+#endif // SYMBOL_TABLE_HPP_INCLUDED
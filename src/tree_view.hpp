@@ -0,0 +1,65 @@
+/*
+	tree_view.hpp
+
+	The MIT License (MIT)
+
+	Copyright (c) 2014 Maxime Alvarez
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in
+	the Software without restriction, including without limitation the rights to
+	use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+	FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+	COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+	IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+	CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+	Defines the accessors walking the pointer tree and the flat AST alike.
+*/
+
+#ifndef TREE_VIEW_HPP_INCLUDED
+#define TREE_VIEW_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+
+#include "datatypes.hpp"
+#include "flat_ast.hpp"
+
+/// The nodes of a pointer tree are their handle.
+struct PointerTree
+{
+    typedef const Node* Handle;
+
+    NodeType getType(Handle node) const { return node->getType(); }
+    Operator getOperator(Handle node) const { return node->getOperator(); }
+    std::size_t getChildCount(Handle node) const { return node->getChildren().size(); }
+    Handle getChild(Handle node, std::size_t index) const { return node->getChildren()[index]; }
+    Value getValue(Handle node) const { return node->getValue(); }
+    std::uint32_t getSlot(Handle node) const { return node->getSlot(); }
+};
+
+/// The nodes of a flat AST are their index.
+struct FlatTree
+{
+    typedef NodeIndex Handle;
+
+    const FlatAst& ast;
+
+    NodeType getType(Handle index) const { return ast.getType(index); }
+    Operator getOperator(Handle index) const { return ast.getOperator(index); }
+    std::size_t getChildCount(Handle index) const { return ast.getChildCount(index); }
+    Handle getChild(Handle index, std::size_t child) const { return ast.getChildren(index)[child]; }
+    Value getValue(Handle index) const { return ast.getLiteral(index); }
+    std::uint32_t getSlot(Handle index) const { return ast.getSlot(index); }
+};
+
+#endif // TREE_VIEW_HPP_INCLUDED
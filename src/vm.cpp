@@ -0,0 +1,383 @@
+#include "runtime.hpp"
+
+#include <cstring>
+
+/// Use GCC/Clang "labels as values" for the dispatch loop when available.
+/// Comment the next lines to force the portable switch dispatch.
+#if defined(__GNUC__) || defined(__clang__)
+    #define VM_COMPUTED_GOTO
+#endif
+
+#ifdef VM_COMPUTED_GOTO
+    #define VM_DISPATCH() instruction = ip++; goto *dispatchTable[static_cast<std::size_t>(instruction->opcode)];
+    #define VM_CASE(opcode) label_##opcode:
+    #define VM_NEXT() VM_DISPATCH()
+#else
+    #define VM_DISPATCH() instruction = ip++; switch(instruction->opcode)
+    #define VM_CASE(opcode) case OpCode::opcode:
+    #define VM_NEXT() continue
+#endif
+
+// Numeric fast path, falls back on the checked operation for other types.
+#define VM_BINARY(op, expression) \
+    --sp; \
+    if(sp[-1].type == ValueType::VT_NUMERIC && sp->type == ValueType::VT_NUMERIC) \
+        sp[-1].numeric = expression; \
+    else \
+        applyBinary(op, sp[-1], *sp);
+
+#define VM_UNARY(op) \
+    sp[-1] = Value(applyUnary(op, sp[-1]));
+
+Value Runtime::execute(Bytecode& bytecode)
+{
+    if(m_stack.size() < bytecode.maxStackSize)
+        m_stack.resize(bytecode.maxStackSize);
+
+    m_frames.clear();
+    m_retired.clear();
+    m_memoKeys.clear();
+
+    // The code being executed : the program, or the body of the function called last.
+    Bytecode* code = &bytecode;
+    Function* function = nullptr;
+
+    Instruction* ip = code->mappedCode ? code->mappedCode : code->code.data();
+    Instruction* instruction = nullptr;
+
+    // Points to the first free slot of the stack.
+    Value* sp = m_stack.data();
+    // Points to the first local of the function.
+    Value* fp = sp;
+
+    #ifdef VM_COMPUTED_GOTO
+    static void* dispatchTable[] =
+    {
+        &&label_OC_PUSH_NULL,
+        &&label_OC_PUSH_NUMERIC,
+        &&label_OC_PUSH_CONSTANT,
+        &&label_OC_PUSH_ESCAPED,
+        &&label_OC_POP,
+        &&label_OC_LOAD,
+        &&label_OC_STORE,
+        &&label_OC_LOAD_LOCAL,
+        &&label_OC_STORE_LOCAL,
+        &&label_OC_TO_NUMERIC,
+        &&label_OC_TO_STRING,
+        &&label_OC_PRINT,
+        &&label_OC_INPUT,
+        &&label_OC_CHECK,
+        &&label_OC_ADD,
+        &&label_OC_SUB,
+        &&label_OC_MUL,
+        &&label_OC_DIV,
+        &&label_OC_MOD,
+        &&label_OC_POW,
+        &&label_OC_SIN,
+        &&label_OC_COS,
+        &&label_OC_TAN,
+        &&label_OC_ASIN,
+        &&label_OC_ACOS,
+        &&label_OC_ATAN,
+        &&label_OC_TO_RAD,
+        &&label_OC_TO_DEG,
+        &&label_OC_LN,
+        &&label_OC_EXP,
+        &&label_OC_LOG10,
+        &&label_OC_SQUARE,
+        &&label_OC_DEFINE,
+        &&label_OC_CALL,
+        &&label_OC_TAIL_CALL,
+        &&label_OC_JUMP,
+        &&label_OC_JUMP_IF_FALSE,
+        &&label_OC_FAIL,
+        &&label_OC_RETURN
+    };
+    #endif // VM_COMPUTED_GOTO
+
+    for(;;)
+    {
+        VM_DISPATCH()
+        {
+            /** Stack operations. */
+            VM_CASE(OC_PUSH_NULL)
+                *sp++ = Value();
+                VM_NEXT();
+            VM_CASE(OC_PUSH_NUMERIC)
+            {
+                float numeric(0.f);
+                std::memcpy(&numeric, &instruction->operand, sizeof(numeric));
+
+                *sp++ = Value(numeric);
+                VM_NEXT();
+            }
+            VM_CASE(OC_PUSH_CONSTANT)
+                *sp++ = code->constants[instruction->operand];
+                VM_NEXT();
+            VM_CASE(OC_PUSH_ESCAPED)
+            {
+                // The decoded string replaces the constant, the next executions push it directly.
+                Value& constant = code->constants[instruction->operand];
+                constant = Value(StringObject::unescape(constant.string->getData(), constant.string->getSize()));
+                instruction->opcode = OpCode::OC_PUSH_CONSTANT;
+
+                *sp++ = constant;
+                VM_NEXT();
+            }
+            VM_CASE(OC_POP)
+                --sp;
+                VM_NEXT();
+
+            /** Variables. */
+            VM_CASE(OC_LOAD)
+                *sp++ = getVariable(instruction->operand);
+                VM_NEXT();
+            VM_CASE(OC_STORE)
+                m_variables[instruction->operand] = std::move(*--sp);
+                VM_NEXT();
+            VM_CASE(OC_LOAD_LOCAL)
+                if(fp[instruction->operand].type == ValueType::VT_UNASSIGNED)
+                    errors::runtimeError("unassigned identifier " + m_symbols.getName(function->locals[instruction->operand]));
+
+                *sp++ = fp[instruction->operand];
+                VM_NEXT();
+            VM_CASE(OC_STORE_LOCAL)
+                fp[instruction->operand] = std::move(*--sp);
+                VM_NEXT();
+
+            /** Specials built-in operations. */
+            VM_CASE(OC_TO_NUMERIC)
+                sp[-1] = convertToNumeric(sp[-1]);
+                VM_NEXT();
+            VM_CASE(OC_TO_STRING)
+                sp[-1] = convertToString(sp[-1]);
+                VM_NEXT();
+            VM_CASE(OC_PRINT)
+                printValue(*--sp);
+                VM_NEXT();
+            VM_CASE(OC_INPUT)
+                *sp++ = readInput();
+                VM_NEXT();
+
+            /** Maths built-in operations. */
+            VM_CASE(OC_CHECK)
+                checkOperand(static_cast<Operator>(instruction->operand), sp[-1]);
+                VM_NEXT();
+            VM_CASE(OC_ADD)
+                VM_BINARY(Operator::OP_ADD, sp[-1].numeric + sp->numeric);
+                VM_NEXT();
+            VM_CASE(OC_SUB)
+                VM_BINARY(Operator::OP_SUB, sp[-1].numeric - sp->numeric);
+                VM_NEXT();
+            VM_CASE(OC_MUL)
+                VM_BINARY(Operator::OP_MUL, sp[-1].numeric * sp->numeric);
+                VM_NEXT();
+            VM_CASE(OC_DIV)
+                VM_BINARY(Operator::OP_DIV, sp[-1].numeric / sp->numeric);
+                VM_NEXT();
+            VM_CASE(OC_MOD)
+                VM_BINARY(Operator::OP_MOD, std::fmod(sp[-1].numeric, sp->numeric));
+                VM_NEXT();
+            VM_CASE(OC_POW)
+                VM_BINARY(Operator::OP_POW, std::pow(sp[-1].numeric, sp->numeric));
+                VM_NEXT();
+            VM_CASE(OC_SIN)
+                VM_UNARY(Operator::OP_SIN);
+                VM_NEXT();
+            VM_CASE(OC_COS)
+                VM_UNARY(Operator::OP_COS);
+                VM_NEXT();
+            VM_CASE(OC_TAN)
+                VM_UNARY(Operator::OP_TAN);
+                VM_NEXT();
+            VM_CASE(OC_ASIN)
+                VM_UNARY(Operator::OP_ASIN);
+                VM_NEXT();
+            VM_CASE(OC_ACOS)
+                VM_UNARY(Operator::OP_ACOS);
+                VM_NEXT();
+            VM_CASE(OC_ATAN)
+                VM_UNARY(Operator::OP_ATAN);
+                VM_NEXT();
+            VM_CASE(OC_TO_RAD)
+                VM_UNARY(Operator::OP_TO_RAD);
+                VM_NEXT();
+            VM_CASE(OC_TO_DEG)
+                VM_UNARY(Operator::OP_TO_DEG);
+                VM_NEXT();
+            VM_CASE(OC_LN)
+                VM_UNARY(Operator::OP_LN);
+                VM_NEXT();
+            VM_CASE(OC_EXP)
+                VM_UNARY(Operator::OP_EXP);
+                VM_NEXT();
+            VM_CASE(OC_LOG10)
+                VM_UNARY(Operator::OP_LOG10);
+                VM_NEXT();
+            VM_CASE(OC_SQUARE)
+                VM_UNARY(Operator::OP_SQUARE);
+                VM_NEXT();
+
+            /** Functions. */
+            VM_CASE(OC_DEFINE)
+            {
+                const std::shared_ptr<Function>& defined = code->functions[instruction->operand];
+                std::shared_ptr<Function>& binding = m_functions[defined->name];
+
+                // Only the bytecode of this execution keeps its own functions alive.
+                if(binding && binding != defined)
+                    m_retired.push_back(binding);
+
+                binding = defined;
+                ++m_bindings;
+
+                *sp++ = Value();
+                VM_NEXT();
+            }
+            VM_CASE(OC_CALL)
+            {
+                Symbol name = instruction->operand & 0xFFFFFF;
+                std::uint32_t count = instruction->operand >> 24;
+                Function* callee = getFunction(name, count);
+
+                if(!callee)
+                {
+                    *sp++ = getVariable(name);
+                    VM_NEXT();
+                }
+
+                MemoTable* memo = m_memoize ? memoTable(callee) : nullptr;
+
+                if(memo)
+                {
+                    if(const Value* result = memo->find(sp - count))
+                    {
+                        sp -= count;
+                        *sp++ = *result;
+                        VM_NEXT();
+                    }
+
+                    // The arguments may be assigned or replaced by a tail call : the key is copied.
+                    m_memoKeys.insert(m_memoKeys.end(), sp - count, sp);
+                }
+
+                if(m_frames.size() == maxExecuteDepth)
+                    errors::runtimeError("stack overflow, more than " + std::to_string(maxExecuteDepth) + " nested calls");
+
+                // The locals and the operands of the body, the arguments already are on the stack.
+                std::size_t top = static_cast<std::size_t>(sp - m_stack.data());
+                std::size_t frame = static_cast<std::size_t>(fp - m_stack.data());
+
+                if(top + callee->locals.size() - count + callee->bytecode.maxStackSize > m_stack.size())
+                {
+                    reserveStack(top + callee->locals.size() - count + callee->bytecode.maxStackSize);
+
+                    sp = m_stack.data() + top;
+                    fp = m_stack.data() + frame;
+                }
+
+                m_frames.push_back(Frame{ip, frame, code, function, memo});
+
+                fp = sp - count;
+
+                for(std::size_t i(count) ; i < callee->locals.size() ; ++i)
+                    *sp++ = unassigned();
+
+                code = &callee->bytecode;
+                function = callee;
+                ip = code->mappedCode ? code->mappedCode : code->code.data();
+                VM_NEXT();
+            }
+            VM_CASE(OC_TAIL_CALL)
+            {
+                Symbol name = instruction->operand & 0xFFFFFF;
+                std::uint32_t count = instruction->operand >> 24;
+                Function* callee = getFunction(name, count);
+
+                if(!callee)
+                {
+                    *sp++ = getVariable(name);
+                    VM_NEXT();
+                }
+
+                // A memoized result is the one of the caller.
+                if(MemoTable* memo = m_memoize ? memoTable(callee) : nullptr)
+                {
+                    if(const Value* result = memo->find(sp - count))
+                    {
+                        sp -= count;
+                        *sp++ = *result;
+                        VM_NEXT();
+                    }
+                }
+
+                // The arguments replace the locals of the caller, at or below them on the stack.
+                Value* arguments = sp - count;
+
+                for(std::uint32_t i(0) ; i < count ; ++i)
+                    fp[i] = std::move(arguments[i]);
+
+                sp = fp + count;
+
+                std::size_t top = static_cast<std::size_t>(sp - m_stack.data());
+                std::size_t frame = static_cast<std::size_t>(fp - m_stack.data());
+
+                if(top + callee->locals.size() - count + callee->bytecode.maxStackSize > m_stack.size())
+                {
+                    reserveStack(top + callee->locals.size() - count + callee->bytecode.maxStackSize);
+
+                    sp = m_stack.data() + top;
+                    fp = m_stack.data() + frame;
+                }
+
+                for(std::size_t i(count) ; i < callee->locals.size() ; ++i)
+                    *sp++ = unassigned();
+
+                // The frame of the caller is reused : its return address is the one of the callee.
+                code = &callee->bytecode;
+                function = callee;
+                ip = code->mappedCode ? code->mappedCode : code->code.data();
+                VM_NEXT();
+            }
+
+            /** Control. */
+            VM_CASE(OC_JUMP)
+                ip = instruction + instruction->operand;
+                VM_NEXT();
+            VM_CASE(OC_JUMP_IF_FALSE)
+                if(!isTrue(*--sp))
+                    ip = instruction + instruction->operand;
+                VM_NEXT();
+            VM_CASE(OC_FAIL)
+                errors::runtimeError(code->messages[instruction->operand]);
+                VM_NEXT();
+            VM_CASE(OC_RETURN)
+            {
+                if(m_frames.empty())
+                    return std::move(*--sp);
+
+                // The result replaces the frame.
+                *fp = std::move(sp[-1]);
+                sp = fp + 1;
+
+                const Frame& caller = m_frames.back();
+
+                if(caller.memo)
+                {
+                    std::size_t keys = m_memoKeys.size() - caller.memo->getArity();
+
+                    caller.memo->insert(m_memoKeys.data() + keys, *fp);
+                    m_memoKeys.resize(keys);
+                }
+
+                ip = caller.returnAddress;
+                fp = m_stack.data() + caller.frame;
+                code = caller.bytecode;
+                function = caller.function;
+
+                m_frames.pop_back();
+                VM_NEXT();
+            }
+        }
+    }
+}
@@ -0,0 +1,160 @@
+// Evaluating numeric expressions must not allocate : the numeric program of bench.sh is evaluated by each
+// engine with malloc counted, and the test fails if the evaluation allocated. Neither must the evaluation
+// of a string literal, which is decoded once.
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "../src/arena.hpp"
+#include "../src/compiler.hpp"
+#include "../src/lexer.hpp"
+#include "../src/optimizer.hpp"
+#include "../src/parser.hpp"
+#include "../src/runtime.hpp"
+
+namespace
+{
+    std::atomic<std::size_t> allocations(0);
+}
+
+// Both the strings of the runtime and operator new allocate with malloc, counted before glibc's own.
+extern "C" void* __libc_malloc(std::size_t size);
+
+extern "C" void* malloc(std::size_t size)
+{
+    ++allocations;
+    return __libc_malloc(size);
+}
+
+namespace
+{
+    enum class Engine
+    {
+        VM,
+        TREE,
+        FLAT
+    };
+
+    // A straight-line program of (+ (* a b) (sin c) (/ d 3) 1) assignments on a few variables.
+    std::string numeric_program(std::size_t size)
+    {
+        std::string source("(program\n");
+
+        for(std::size_t i(0) ; i < 16 ; ++i)
+            source += "(assign x" + std::to_string(i) + " " + std::to_string(i) + ".5)\n";
+
+        for(std::size_t i(16) ; i < size ; ++i)
+        {
+            source += "(assign x" + std::to_string(i % 16) + " (+ (* x" + std::to_string((i - 1) % 16) + " 0.5) (sin x"
+                    + std::to_string((i - 2) % 16) + ") (/ x" + std::to_string((i - 3) % 16) + " 3) 1))\n";
+        }
+
+        return source + ")\n";
+    }
+
+    // A tail-recursive function passing the same escaped string literal to itself at each of its calls.
+    std::string string_program(std::size_t calls)
+    {
+        return "(program\n(function loop n s (if n (loop (- n 1) \"a\\nb\") s))\n(assign s (loop " + std::to_string(calls) + " \"\"))\n)\n";
+    }
+
+    // The heap allocations made by the evaluation alone, once the program is parsed and compiled.
+    std::size_t count_allocations(const std::string& source, Engine engine, bool optimize)
+    {
+        Arena arena;
+        Runtime runtime;
+
+        Lexer lexer(source.data(), source.size(), runtime.getSymbols());
+        lexer.lex();
+
+        Parser parser(lexer, arena);
+        Optimizer optimizer(&runtime.getSymbols());
+        std::size_t count(0);
+
+        if(engine == Engine::FLAT)
+        {
+            FlatAst ast = parser.parseFlat();
+
+            if(optimize)
+                optimizer.optimize(ast);
+
+            runtime.declareSymbols();
+
+            count = allocations;
+            runtime.eval(ast);
+            count = allocations - count;
+        }
+        else
+        {
+            Node* root = parser.parse();
+
+            if(optimize)
+                root = optimizer.optimize(root);
+
+            runtime.declareSymbols();
+
+            if(engine == Engine::TREE)
+            {
+                count = allocations;
+                runtime.eval(root);
+                count = allocations - count;
+            }
+            else
+            {
+                Compiler compiler;
+                Bytecode bytecode = compiler.compile(root);
+
+                count = allocations;
+                runtime.execute(bytecode);
+                count = allocations - count;
+            }
+        }
+
+        return count;
+    }
+}
+
+int main()
+{
+    static const char* engines[] = {"vm", "tree", "flat"};
+
+    std::string source = numeric_program(10000);
+    bool failed(false);
+
+    for(int engine(0) ; engine < 3 ; ++engine)
+    {
+        for(int optimize(0) ; optimize < 2 ; ++optimize)
+        {
+            std::size_t count = count_allocations(source, static_cast<Engine>(engine), optimize != 0);
+
+            std::cout << "allocations: " << engines[engine] << (optimize ? ", optimized" : "") << " : " << count << std::endl;
+            failed = failed || count != 0;
+        }
+    }
+
+    if(failed)
+        std::cerr << "allocations: the evaluation of numeric expressions allocated" << std::endl;
+
+    // The definition of the function and its first calls allocate, but not the evaluation of a literal.
+    bool repeated(false);
+
+    for(int engine(0) ; engine < 3 ; ++engine)
+    {
+        for(int optimize(0) ; optimize < 2 ; ++optimize)
+        {
+            std::size_t few = count_allocations(string_program(100), static_cast<Engine>(engine), optimize != 0);
+            std::size_t many = count_allocations(string_program(10000), static_cast<Engine>(engine), optimize != 0);
+
+            std::cout << "allocations: " << engines[engine] << (optimize ? ", optimized" : "") << " : " << few << " for 100 string literals, "
+                      << many << " for 10000" << std::endl;
+            repeated = repeated || many != few;
+        }
+    }
+
+    if(repeated)
+        std::cerr << "allocations: the evaluation of a string literal allocated" << std::endl;
+
+    return failed || repeated ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,273 @@
+// The incremental front end must build the same tree as a whole parse : random edits are made to random
+// sources, and after each one the tree is compared with the one parsed from scratch, parser errors included.
+// An edit in a large source must only cut and parse again the tokens of its statement, and the nodes it
+// replaces must not pile up.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../src/arena.hpp"
+#include "../src/errors.hpp"
+#include "../src/incremental_parser.hpp"
+#include "../src/lexer.hpp"
+#include "../src/parser.hpp"
+#include "../src/symbol_table.hpp"
+
+namespace
+{
+    // The tree with its identifiers by name, its strings as written and its numbers bit for bit.
+    std::string write(const Node* root, const SymbolTable& symbols)
+    {
+        std::ostringstream stream;
+        stream.precision(9);
+
+        std::vector<const Node*> nodes(1, root);
+
+        while(!nodes.empty())
+        {
+            const Node* node = nodes.back();
+            nodes.pop_back();
+
+            // Closing parenthesis of an expression.
+            if(!node)
+            {
+                stream << ")";
+                continue;
+            }
+
+            if(node->getType() == NodeType::NT_IDENTIFIER)
+                stream << " " << symbols.getName(node->getSlot());
+            else if(node->getType() == NodeType::NT_EXPRESSION)
+            {
+                stream << " (" << static_cast<int>(node->getOperator());
+
+                NodeList children = node->getChildren();
+                nodes.push_back(nullptr);
+
+                for(std::size_t i(children.size()) ; i > 0 ; --i)
+                    nodes.push_back(children[i - 1]);
+            }
+            else if(node->getValueType() == ValueType::VT_STRING)
+                stream << " \"" << std::string(node->getText(), node->getTextLength()) << "\"" << (node->hasEscapes() ? "e" : "");
+            else if(node->getValueType() == ValueType::VT_NUMERIC)
+                stream << " " << node->getValue().numeric;
+            else
+                stream << " null";
+        }
+
+        return stream.str();
+    }
+
+    std::string parse_whole(const std::string& source, SymbolTable& symbols)
+    {
+        Arena arena;
+
+        try
+        {
+            Lexer lexer(source.data(), source.size(), symbols);
+            lexer.lex();
+
+            Parser parser(lexer, arena);
+            return write(parser.parse(), symbols);
+        }
+        catch(errors::parser_exception& e)
+        {
+            return e.what();
+        }
+    }
+
+    std::string edit(IncrementalParser& parser, std::size_t offset, std::size_t removed, const std::string& text, SymbolTable& symbols)
+    {
+        try
+        {
+            return write(parser.edit(offset, removed, text), symbols);
+        }
+        catch(errors::parser_exception& e)
+        {
+            return e.what();
+        }
+    }
+
+    std::string expression(std::mt19937& random, int depth)
+    {
+        static const char* atoms[] = {"1", "2.5", "42", "\"text\"", "\"a\\\"b\"", "x", "y", "counter", "null"};
+        static const char* operators[] = {"+", "-", "*", "if", "assign", "print", "sin"};
+
+        if(depth == 0 || random() % 3 == 0)
+            return atoms[random() % (sizeof(atoms) / sizeof(atoms[0]))];
+
+        std::string text("(");
+
+        switch(random() % 4)
+        {
+            case 0:
+                text += "f";
+                break;
+            case 1:
+                text += "function f x";
+                break;
+            default:
+                text += operators[random() % (sizeof(operators) / sizeof(operators[0]))];
+                break;
+        }
+
+        for(std::size_t i(0), count(random() % 4) ; i < count ; ++i)
+        {
+            text += random() % 8 == 0 ? "\n  # note\n  " : " ";
+            text += expression(random, depth - 1);
+        }
+
+        return text + ")";
+    }
+
+    std::string program(std::mt19937& random, std::size_t statements)
+    {
+        std::string source("(program");
+
+        for(std::size_t i(0) ; i < statements ; ++i)
+            source += "\n    " + expression(random, 4);
+
+        return source + "\n)\n";
+    }
+
+    // Random edits of random programs, each tree compared with a whole parse.
+    bool check_random_edits()
+    {
+        static const char pieces[] = "()\" #x1.+\n\\";
+
+        SymbolTable symbols;
+        std::size_t edits(0), mismatches(0);
+
+        for(unsigned seed(0) ; seed < 200 ; ++seed)
+        {
+            std::mt19937 random(seed);
+
+            std::string source = program(random, 1 + random() % 12);
+            IncrementalParser parser(symbols);
+            parser.parse(source);
+
+            for(int i(0) ; i < 60 ; ++i)
+            {
+                std::size_t offset = random() % (source.size() + 1);
+                std::size_t removed(0);
+                std::string text;
+
+                switch(random() % 4)
+                {
+                    case 0:
+                        text = " " + expression(random, 2);
+                        break;
+                    case 1:
+                        for(std::size_t j(0), count(1 + random() % 3) ; j < count ; ++j)
+                            text += pieces[random() % (sizeof(pieces) - 1)];
+                        break;
+                    case 2:
+                        removed = std::min<std::size_t>(1 + random() % 12, source.size() - offset);
+                        break;
+                    default:
+                        removed = std::min<std::size_t>(random() % 6, source.size() - offset);
+                        text = expression(random, 1);
+                        break;
+                }
+
+                std::string incremental = edit(parser, offset, removed, text, symbols);
+                source.replace(offset, removed, text);
+                ++edits;
+
+                if(incremental != parse_whole(source, symbols))
+                {
+                    if(mismatches++ == 0)
+                    {
+                        std::cerr << "incremental: seed " << seed << ", edit " << i << " at " << offset << ", -" << removed
+                                  << " +\"" << text << "\" differs from a whole parse of :\n" << source << std::endl;
+                    }
+
+                    // The next edits start again from a whole parse.
+                    try
+                    {
+                        parser.parse(source);
+                    }
+                    catch(errors::parser_exception&)
+                    {}
+                }
+            }
+        }
+
+        std::cout << "incremental: " << edits << " random edits, " << mismatches << " mismatches" << std::endl;
+        return mismatches == 0;
+    }
+
+    // Digit edits in the statements of a large program : a few tokens each, and the nodes replaced copied away.
+    // As in an editor, the edits follow each other closely, with a jump elsewhere from time to time : the text
+    // and tokens between an edit and the previous one are moved (see Lexer::relex()).
+    bool check_large_source()
+    {
+        SymbolTable symbols;
+        std::string source("(program\n");
+        std::vector<std::size_t> digits;
+
+        for(std::size_t i(0) ; i < 50000 ; ++i)
+        {
+            std::string statement = "(assign x" + std::to_string(i % 16) + " (+ (* x" + std::to_string((i + 1) % 16) + " 0.5) 7))\n";
+
+            digits.push_back(source.size() + statement.find("7))"));
+            source += statement;
+        }
+
+        source += ")\n";
+
+        IncrementalParser parser(symbols);
+        parser.parse(source);
+
+        std::mt19937 random(0);
+        std::size_t relexed(0), reparsed(0), statement(0);
+        const std::size_t edits(200000);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for(std::size_t i(0) ; i < edits ; ++i)
+        {
+            if(i % 1000 == 0)
+                statement = random() % digits.size();
+            else
+                statement = (statement + digits.size() + random() % 7 - 3) % digits.size();
+
+            std::size_t offset = digits[statement];
+            std::string digit(1, static_cast<char>('0' + random() % 10));
+
+            parser.edit(offset, 1, digit);
+            source.replace(offset, 1, digit);
+
+            relexed = std::max(relexed, parser.getRelexedTokens());
+            reparsed = std::max(reparsed, parser.getReparsedTokens());
+        }
+
+        double time = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / static_cast<double>(edits);
+        bool same = write(parser.getRoot(), symbols) == parse_whole(source, symbols);
+
+        std::cout << "incremental: " << source.size() / 1024 << " KB source, " << edits << " edits of " << time << " us, up to "
+                  << relexed << " tokens cut and " << reparsed << " parsed again, " << parser.getCompactions() << " compactions" << std::endl;
+
+        // The digit and the blank before it, then the statement.
+        if(!same || relexed > 2 || reparsed > 12 || parser.getCompactions() == 0)
+        {
+            std::cerr << "incremental: the edits of the large source " << (same ? "did too much work" : "differ from a whole parse") << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+}
+
+int main()
+{
+    bool passed = check_random_edits();
+    passed = check_large_source() && passed;
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
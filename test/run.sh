@@ -0,0 +1,23 @@
+# Build and run the tests, each one a program linked with the interpreter sources but its main.
+# Usage : ./run.sh [test name...], all the tests by default.
+
+cd "$(dirname "$0")"
+
+BUILD=${TMPDIR:-/tmp}/e-lang-tests
+SOURCES=$(ls ./../src/*.cpp | grep -v '/main\.cpp$')
+TESTS=${@:-$(ls *.cpp | sed 's/\.cpp$//')}
+
+mkdir -p $BUILD
+
+failed=0
+for test in $TESTS
+do
+    echo "== $test"
+    if ! g++ -std=c++11 -O2 -pthread $test.cpp $SOURCES -o $BUILD/$test || ! $BUILD/$test
+    then
+        echo "== $test failed"
+        failed=1
+    fi
+done
+
+exit $failed